@@ -57,6 +57,11 @@ int rt_alarm_create(RT_ALARM *alarm,
 		    void (*handler)(void *arg),
 		    void *arg);
 
+int rt_alarm_create_prio(RT_ALARM *alarm,
+			 const char *name,
+			 void (*handler)(void *arg),
+			 void *arg, int prio);
+
 int rt_alarm_delete(RT_ALARM *alarm);
 
 int rt_alarm_start(RT_ALARM *alarm,
@@ -25,6 +25,7 @@
 /* Creation flags. */
 #define B_PRIO  0x1	/* Pend by task priority order. */
 #define B_FIFO  0x0	/* Pend by FIFO order. */
+#define B_SPIN  0x2	/* Spin briefly before sleeping. */
 
 struct RT_BUFFER {
 	uintptr_t handle;
@@ -66,6 +67,38 @@ struct RT_BUFFER_INFO {
 
 typedef struct RT_BUFFER_INFO RT_BUFFER_INFO;
 
+/**
+ * @brief Buffer span descriptor
+ * @anchor RT_BUFFER_SPAN
+ *
+ * This structure describes an area of the buffer memory handed out
+ * by rt_buffer_reserve_timed() or rt_buffer_acquire_timed(). When the
+ * area wraps around the end of the buffer, it is split into two
+ * segments.
+ */
+struct RT_BUFFER_SPAN {
+	/**
+	 * Address of the first segment.
+	 */
+	void *ptr1;
+	/**
+	 * Length of the first segment (in bytes).
+	 */
+	size_t len1;
+	/**
+	 * Address of the second segment, NULL if the area does not
+	 * wrap.
+	 */
+	void *ptr2;
+	/**
+	 * Length of the second segment (in bytes), zero if the area
+	 * does not wrap.
+	 */
+	size_t len2;
+};
+
+typedef struct RT_BUFFER_SPAN RT_BUFFER_SPAN;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -125,6 +158,58 @@ ssize_t rt_buffer_read(RT_BUFFER *bf,
 				    alchemy_rel_timeout(timeout, &ts));
 }
 
+ssize_t rt_buffer_reserve_timed(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				const struct timespec *abs_timeout);
+
+static inline
+ssize_t rt_buffer_reserve_until(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_reserve_timed(bf, size, span,
+				       alchemy_abs_timeout(timeout, &ts));
+}
+
+static inline
+ssize_t rt_buffer_reserve(RT_BUFFER *bf,
+			  size_t size, RT_BUFFER_SPAN *span,
+			  RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_reserve_timed(bf, size, span,
+				       alchemy_rel_timeout(timeout, &ts));
+}
+
+int rt_buffer_commit(RT_BUFFER *bf, size_t size);
+
+ssize_t rt_buffer_acquire_timed(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				const struct timespec *abs_timeout);
+
+static inline
+ssize_t rt_buffer_acquire_until(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_acquire_timed(bf, size, span,
+				       alchemy_abs_timeout(timeout, &ts));
+}
+
+static inline
+ssize_t rt_buffer_acquire(RT_BUFFER *bf,
+			  size_t size, RT_BUFFER_SPAN *span,
+			  RTIME timeout)
+{
+	struct timespec ts;
+	return rt_buffer_acquire_timed(bf, size, span,
+				       alchemy_rel_timeout(timeout, &ts));
+}
+
+int rt_buffer_release(RT_BUFFER *bf, size_t size);
+
 int rt_buffer_clear(RT_BUFFER *bf);
 
 int rt_buffer_inquire(RT_BUFFER *bf,
@@ -27,6 +27,8 @@
  */
 #define Q_PRIO  0x1	/* Pend by task priority order. */
 #define Q_FIFO  0x0	/* Pend by FIFO order. */
+#define Q_SPSC  0x2	/* Single producer, single consumer. */
+#define Q_SPIN  0x4	/* Spin briefly before sleeping. */
 /* Deprecated, compat only. */
 #define Q_SHARED 0x0
 
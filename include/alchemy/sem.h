@@ -26,6 +26,7 @@
 #define S_PRIO  0x1	/* Pend by task priority order. */
 #define S_FIFO  0x0	/* Pend by FIFO order. */
 #define S_PULSE 0x2	/* Enable pulse mode. */
+#define S_SPIN  0x4	/* Spin briefly before sleeping. */
 
 struct RT_SEM {
 	uintptr_t handle;
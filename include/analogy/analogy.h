@@ -110,6 +110,11 @@ int a4l_set_wakesize(a4l_desc_t *dsc, unsigned long size);
 
 int a4l_get_wakesize(a4l_desc_t *dsc, unsigned long *size);
 
+int a4l_set_bufflags(a4l_desc_t *dsc, unsigned long flags);
+
+int a4l_get_bufflags(a4l_desc_t *dsc,
+		     unsigned long *flags, unsigned long *chunks);
+
 int a4l_mark_bufrw(a4l_desc_t *dsc,
 		   unsigned int idx_subd,
 		   unsigned long cur, unsigned long *newp);
@@ -120,6 +125,16 @@ int a4l_poll(a4l_desc_t *dsc,
 int a4l_mmap(a4l_desc_t *dsc,
 	     unsigned int idx_subd, unsigned long size, void **ptr);
 
+int a4l_mmap_status(a4l_desc_t *dsc,
+		    unsigned int idx_subd, a4l_bufstat_t **ptr);
+
+long a4l_bufstat_avail(a4l_bufstat_t *st);
+
+void a4l_bufstat_consume(a4l_bufstat_t *st, unsigned long count);
+
+long a4l_bufstat_wait(a4l_desc_t *dsc, unsigned int idx_subd,
+		      a4l_bufstat_t *st, unsigned long ms_timeout);
+
 int a4l_async_read(a4l_desc_t *dsc,
 		   void *buf, size_t nbyte, unsigned long ms_timeout);
 
@@ -166,6 +181,12 @@ int a4l_rawtof(a4l_chinfo_t *chan,
 int a4l_rawtod(a4l_chinfo_t *chan,
 	       a4l_rnginfo_t *rng, double *dst, void *src, int cnt);
 
+int a4l_rawtof_scan(a4l_chinfo_t **chans, a4l_rnginfo_t **rngs,
+		    int nb_chan, float *dst, void *src, int nb_scan);
+
+int a4l_rawtod_scan(a4l_chinfo_t **chans, a4l_rnginfo_t **rngs,
+		    int nb_chan, double *dst, void *src, int nb_scan);
+
 int a4l_ultoraw(a4l_chinfo_t *chan, void *dst, unsigned long *src, int cnt);
 
 int a4l_ftoraw(a4l_chinfo_t *chan,
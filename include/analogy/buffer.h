@@ -55,6 +55,14 @@
 #define A4L_BUF_MAP (1 << A4L_BUF_MAP_NR)
 
 struct a4l_subdevice;
+struct a4l_buffer_status;
+
+/* Physically contiguous part of the buffer */
+struct a4l_buffer_chunk {
+	unsigned long addr;
+	unsigned long size;
+};
+typedef struct a4l_buffer_chunk a4l_bufchk_t;
 
 /* Buffer descriptor structure */
 struct a4l_buffer {
@@ -70,6 +78,17 @@ struct a4l_buffer {
 	/* Tab containing buffer's pages pointers */
 	unsigned long *pg_list;
 
+	/* Physically contiguous runs of pages, in buffer order; a
+	   scatter-gather DMA engine needs one descriptor per chunk */
+	a4l_bufchk_t *chk_list;
+	unsigned int chk_count;
+
+	/* Allocation flags (A4L_BUFCFG_xxx) applied at the next
+	   allocation */
+	unsigned long cfg_flags;
+	/* Pages backing a buffer built with A4L_BUFCFG_CONTIG */
+	struct page **pages;
+
 	/* RT/NRT synchronization element */
 	a4l_sync_t sync;
 
@@ -91,6 +110,10 @@ struct a4l_buffer {
 	/* Theshold below which the user process should not be
 	   awakened */
 	unsigned long wake_count;
+
+	/* Counters shared with user space (A4L_MMAPSTAT), NULL
+	   until the status page is mapped */
+	struct a4l_buffer_status *status;
 };
 typedef struct a4l_buffer a4l_buf_t;
 
@@ -447,6 +470,7 @@ int a4l_get_chan(struct a4l_subdevice *subd);
 /* --- IOCTL / FOPS functions --- */
 
 int a4l_ioctl_mmap(a4l_cxt_t * cxt, void *arg);
+int a4l_ioctl_mmapstat(a4l_cxt_t * cxt, void *arg);
 int a4l_ioctl_bufcfg(a4l_cxt_t * cxt, void *arg);
 int a4l_ioctl_bufcfg2(a4l_cxt_t * cxt, void *arg);
 int a4l_ioctl_bufinfo(a4l_cxt_t * cxt, void *arg);
@@ -468,9 +492,31 @@ struct a4l_mmap_arg {
 };
 typedef struct a4l_mmap_arg a4l_mmap_t;
 
+/* Status page events */
+#define A4L_BUFSTAT_ACTIVE 0x1
+#define A4L_BUFSTAT_EOA 0x2
+#define A4L_BUFSTAT_ERROR 0x4
+
+/* Buffer status page, shared between the kernel and an mmap'ed
+   consumer so that the latter can run the ring without issuing
+   syscalls (A4L_MMAPSTAT ioctl). For an input subdevice, the kernel
+   publishes prd_count, the user process advances cns_count. */
+struct a4l_buffer_status {
+	unsigned long prd_count;
+	unsigned long cns_count;
+	/* Count after which the acquisition is over (0: unlimited) */
+	unsigned long end_count;
+	unsigned long wake_count;
+	unsigned long size;
+	/* A4L_BUFSTAT_xxx */
+	unsigned long events;
+};
+typedef struct a4l_buffer_status a4l_bufstat_t;
+
 /* Constants related with buffer size
    (might be used with BUFCFG ioctl) */
 #define A4L_BUF_MAXSIZE 0x1000000
+#define A4L_BUF_CONTIG_MAXSIZE 0x40000000
 #define A4L_BUF_DEFSIZE 0x10000
 #define A4L_BUF_DEFMAGIC 0xffaaff55
 
@@ -496,10 +542,25 @@ struct a4l_buffer_info {
 };
 typedef struct a4l_buffer_info a4l_bufinfo_t;
 
+/* Buffer allocation flags (BUFCFG2 / BUFINFO2); they are taken
+   into account at the next buffer (re)allocation (BUFCFG) */
+
+/* Build the buffer out of physically contiguous blocks, as large as
+   the page allocator can provide. The DMA descriptor rings then
+   describe the buffer with one entry per block instead of one entry
+   per page and the size limit is raised to
+   A4L_BUF_CONTIG_MAXSIZE. */
+#define A4L_BUFCFG_CONTIG 0x1
+
 /* BUFCFG2 / BUFINFO2 ioctl argument structure */
 struct a4l_buffer_config2 {
 	unsigned long wake_count;
-	unsigned long reserved[3];
+	/* A4L_BUFCFG_xxx */
+	unsigned long flags;
+	/* Filled by BUFINFO2: count of physically contiguous chunks
+	   building the current buffer */
+	unsigned long chunks;
+	unsigned long reserved;
 };
 typedef struct a4l_buffer_config2 a4l_bufcfg2_t;
 
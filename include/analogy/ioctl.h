@@ -29,7 +29,7 @@
 
 #include <rtdm/driver.h>
 
-#define NB_IOCTL_FUNCTIONS 17
+#define NB_IOCTL_FUNCTIONS 18
 
 #endif /* __KERNEL__ */
 
@@ -57,6 +57,8 @@
 #define A4L_BUFCFG2 _IOR(CIO,15,a4l_bufcfg_t)
 #define A4L_BUFINFO2 _IOWR(CIO,16,a4l_bufcfg_t)
 
+#define A4L_MMAPSTAT _IOWR(CIO,17,unsigned int)
+
 #endif /* !DOXYGEN_CPP */
 
 #endif /* __ANALOGY_IOCTL__ */
@@ -38,11 +38,28 @@ struct xnsys_ppd {
 	char *exe_path;
 };
 
+/*
+ * Per-process syscall accounting, indexed by CPU then service
+ * number. Slot 0 collects calls served in primary mode, slot 1 those
+ * served in secondary mode. Each CPU only updates its own entries.
+ */
+struct xnsyscall_stat {
+	unsigned long calls[2];
+	xnticks_t exectime[2];
+#if BITS_PER_LONG < 64
+	unsigned int seq;	/* Odd while an update is in progress. */
+#endif
+};
+
 struct xnshadow_process {
 	struct mm_struct *mm;
 	void *priv[NR_PERSONALITIES];
 	struct hlist_node hlink;
 	struct xnsys_ppd sys_ppd;
+#ifdef CONFIG_XENO_OPT_STATS
+	pid_t pid;
+	struct xnsyscall_stat *syscall_stats[NR_PERSONALITIES];
+#endif
 };
 
 extern struct xnsys_ppd __xnsys_global_ppd;
@@ -44,6 +44,8 @@ struct xnselector {
 	} fds [XNSELECT_MAX_TYPES];
 	struct list_head destroy_link;
 	struct list_head bindings; /* only used by xnselector_destroy */
+	struct list_head ready;	/* bindings with a pending state */
+	unsigned int deletions; /* bindings dropped by xnselect_destroy */
 };
 
 #define __NFDBITS__	(8 * sizeof(unsigned long))
@@ -98,6 +100,7 @@ struct xnselect_binding {
 	unsigned int bit_index;
 	struct list_head link;  /* link in selected fds list. */
 	struct list_head slink; /* link in selector list */
+	struct list_head rlink; /* link in selector ready list */
 };
 
 void xnselect_init(struct xnselect *select_block);
@@ -130,6 +133,25 @@ xnselect_signal(struct xnselect *select_block, unsigned int state)
 	return 0;
 }
 
+/**
+ * Drop a stale pending state.
+ *
+ * Clears the pending bit of a binding found on the ready list of its
+ * selector, and unlinks it from that list. The next call to
+ * xnselect_signal() raising the state will queue the binding and
+ * wake up the selector again. Must be called with nklock locked, irqs
+ * off.
+ *
+ * @param binding the binding to clear.
+ */
+static inline void __xnselect_clear(struct xnselect_binding *binding)
+{
+	struct xnselector *selector = binding->selector;
+
+	__FD_CLR__(binding->bit_index, &selector->fds[binding->type].pending);
+	list_del_init(&binding->rlink);
+}
+
 void xnselect_destroy(struct xnselect *select_block);
 
 int xnselector_init(struct xnselector *selector);
@@ -30,6 +30,7 @@
 #include <cobalt/kernel/shadow.h>
 #include <cobalt/kernel/synch.h>
 #include <cobalt/uapi/kernel/thread.h>
+#include <cobalt/uapi/signal.h>
 #include <asm/xenomai/machine.h>
 #include <asm/xenomai/thread.h>
 
@@ -60,6 +61,17 @@ struct xnthread_wait_context {
 	int posted;
 };
 
+/* Depth of the per-thread relax event ring, must be a power of 2. */
+#define XNTHREAD_RELAX_RING	8
+/* Relax causes are SIGDEBUG_* reason codes. */
+#define XNTHREAD_RELAX_REASONS	(SIGDEBUG_RESCNT_IMBALANCE + 1)
+
+struct xnthread_relax_event {
+	xnticks_t date;		/* Monotonic date of the switch (ns) */
+	unsigned long pc;	/* User-space return address */
+	int reason;		/* Cause of the switch */
+};
+
 typedef struct xnthread {
 
 	struct xnarchtcb tcb;		/* Architecture-dependent block */
@@ -126,7 +138,7 @@ typedef struct xnthread {
 
 	struct xnsynch *wwake;		/* Wait channel the thread was resumed from */
 
-	int hrescnt;			/* Held resources count */
+	int hrescnt;			/* Held resources count (unmapped threads) */
 
 	struct xntimer rtimer;		/* Resource timer */
 
@@ -143,6 +155,11 @@ typedef struct xnthread {
 		xnstat_counter_t pf;	/* Number of page faults */
 		xnstat_exectime_t account; /* Execution time accounting entity */
 		xnstat_exectime_t lastperiod; /* Interval marker for execution time reports */
+		struct {
+			unsigned long count; /* Overall relax count, ring index */
+			unsigned long hits[XNTHREAD_RELAX_REASONS]; /* Relax causes */
+			struct xnthread_relax_event ring[XNTHREAD_RELAX_RING]; /* Recent relaxes */
+		} relax;	/* Always kept, regardless of CONFIG_XENO_OPT_STATS */
 	} stat;
 
 	struct xnselector *selector;    /* For select. */
@@ -235,9 +252,12 @@ static inline struct xnarchtcb *xnthread_archtcb(struct xnthread *thread)
 #define xnthread_affine_p(thread, cpu)     cpu_isset(cpu, (thread)->affinity)
 #define xnthread_get_exectime(thread)      xnstat_exectime_get_total(&(thread)->stat.account)
 #define xnthread_get_lastswitch(thread)    xnstat_exectime_get_last_switch((thread)->sched)
-#define xnthread_inc_rescnt(thread)        ({ (thread)->hrescnt++; })
-#define xnthread_dec_rescnt(thread)        ({ --(thread)->hrescnt; })
-#define xnthread_get_rescnt(thread)        ((thread)->hrescnt)
+#define xnthread_rescnt_ref(thread)        ((thread)->u_window ?		\
+					    &(thread)->u_window->hrescnt :	\
+					    &(thread)->hrescnt)
+#define xnthread_inc_rescnt(thread)        ({ (*xnthread_rescnt_ref(thread))++; })
+#define xnthread_dec_rescnt(thread)        ({ --(*xnthread_rescnt_ref(thread)); })
+#define xnthread_get_rescnt(thread)        (*xnthread_rescnt_ref(thread))
 #define xnthread_personality(thread)       ((thread)->personality)
 
 #define xnthread_for_each_claimed(__pos, __thread)		\
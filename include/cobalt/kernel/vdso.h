@@ -29,15 +29,23 @@
 #include <cobalt/uapi/kernel/vdso.h>
 
 /*
- * Define the available feature set here. We have a single feature
- * defined for now.
+ * Define the available feature set here.
  */
 #ifdef CONFIG_XENO_OPT_HOSTRT
-#define XNVDSO_FEATURES XNVDSO_FEAT_HOST_REALTIME
+#define __XNVDSO_FEAT_HOSTRT XNVDSO_FEAT_HOST_REALTIME
 #else
-#define XNVDSO_FEATURES 0
+#define __XNVDSO_FEAT_HOSTRT 0
 #endif /* CONFIG_XENO_OPT_HOSTRT */
 
+#ifdef CONFIG_XENO_OPT_EXTCLOCK
+#define __XNVDSO_FEAT_EXTCLOCK XNVDSO_FEAT_EXT_CLOCKS
+#else
+#define __XNVDSO_FEAT_EXTCLOCK 0
+#endif /* CONFIG_XENO_OPT_EXTCLOCK */
+
+#define XNVDSO_FEATURES \
+	(__XNVDSO_FEAT_HOSTRT|__XNVDSO_FEAT_EXTCLOCK|XNVDSO_FEAT_COARSE_CLOCK)
+
 extern struct xnvdso *nkvdso;
 
 static inline struct xnvdso_hostrt_data *get_hostrt_data(void)
@@ -45,4 +53,9 @@ static inline struct xnvdso_hostrt_data *get_hostrt_data(void)
 	return &nkvdso->hostrt_data;
 }
 
+static inline struct xnvdso_extclock_data *get_extclock_data(int nr)
+{
+	return &nkvdso->extclock_data[nr];
+}
+
 #endif /* _COBALT_KERNEL_VDSO_H */
@@ -156,6 +156,12 @@ COBALT_DECL(int, pthread_setname_np(pthread_t thread, const char *name));
 
 int pthread_probe_np(pid_t tid);
 
+int pthread_prefault_np(void *addr, size_t len);
+
+int pthread_prefault_stack_np(void);
+
+unsigned long pthread_pagefaults_np(void);
+
 int pthread_create_ex(pthread_t *tid,
 		      const pthread_attr_ex_t *attr_ex,
 		      void *(*start)(void *),
@@ -22,6 +22,7 @@ struct cobalt_event_data {
 	unsigned long value;
 	unsigned long flags;
 #define COBALT_EVENT_PENDED  0x1
+#define COBALT_EVENT_WATCHED 0x2
 	int nwaiters;
 };
 
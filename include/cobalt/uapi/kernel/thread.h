@@ -127,6 +127,18 @@ struct xnthread_info {
 struct xnthread_user_window {
 	unsigned long state;
 	unsigned long grant_value;
+	/*
+	 * Count of resources held by a weak thread. Userland updates
+	 * it when grabbing/releasing a mutex locally, the kernel
+	 * reads it to decide about auto-relax.
+	 */
+	int hrescnt;
+	/*
+	 * Count of page faults taken in primary mode, each of which
+	 * forced a switch to secondary mode. Updated by the kernel,
+	 * read by userland.
+	 */
+	unsigned long pagefaults;
 };
 
 #endif /* !_COBALT_UAPI_KERNEL_THREAD_H */
@@ -32,6 +32,24 @@ struct xnvdso_hostrt_data {
 	unsigned int shift;
 };
 
+struct xnvdso_coarse_data {
+	urw_t lock;
+	/* Core monotonic date of the latest clock tick (ns). */
+	unsigned long long date;
+};
+
+#define XNVDSO_MAX_EXTCLOCKS  32
+
+struct xnvdso_extclock_data {
+	urw_t lock;
+	int live;
+	/*
+	 * Clock time minus core monotonic time (ns), sampled on the
+	 * latest tick of the external clock.
+	 */
+	unsigned long long offset;
+};
+
 /*
  * Data shared between Xenomai kernel/userland and the Linux
  * kernel/userland on the global semaphore heap. The features element
@@ -45,12 +63,18 @@ struct xnvdso {
 	struct xnvdso_hostrt_data hostrt_data;
 	/* XNVDSO_FEAT_WALLCLOCK_OFFSET */
 	unsigned long long wallclock_offset;
+	/* XNVDSO_FEAT_COARSE_CLOCK */
+	struct xnvdso_coarse_data coarse_data;
+	/* XNVDSO_FEAT_EXT_CLOCKS */
+	struct xnvdso_extclock_data extclock_data[XNVDSO_MAX_EXTCLOCKS];
 };
 
 /* For each shared feature, add a flag below. */
 
 #define XNVDSO_FEAT_HOST_REALTIME	0x0000000000000001ULL
 #define XNVDSO_FEAT_WALLCLOCK_OFFSET	0x0000000000000002ULL
+#define XNVDSO_FEAT_COARSE_CLOCK	0x0000000000000004ULL
+#define XNVDSO_FEAT_EXT_CLOCKS		0x0000000000000008ULL
 
 static inline int xnvdso_test_feature(struct xnvdso *vdso,
 				      unsigned long long feature)
@@ -26,6 +26,13 @@ struct cobalt_monitor_data {
 #define COBALT_MONITOR_SIGNALED   0x03 /* i.e. GRANTED or DRAINED */
 #define COBALT_MONITOR_BROADCAST  0x04
 #define COBALT_MONITOR_PENDED     0x08
+	/*
+	 * Threads sleeping for a grant/drain signal, maintained by
+	 * the core. The monitor owner may exit without a syscall
+	 * when no pending signal can wake up any of them.
+	 */
+	int grant_waiters;
+	int drain_waiters;
 };
 
 struct cobalt_monitor;
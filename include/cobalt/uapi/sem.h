@@ -48,4 +48,7 @@ union cobalt_sem_union {
 #define SEM_RAWCLOCK   0x20
 #define SEM_NOBUSYDEL  0x40
 
+/* Set by the core, sem_post() must trap to notify waitsets. */
+#define SEM_WATCHED    0x80
+
 #endif /* !_COBALT_UAPI_SEM_H */
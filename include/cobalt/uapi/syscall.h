@@ -113,5 +113,11 @@
 #define sc_cobalt_event_destroy         92
 #define sc_cobalt_sched_setconfig_np	93
 #define sc_cobalt_sched_getconfig_np	94
+#define sc_cobalt_waitset_init          95
+#define sc_cobalt_waitset_destroy       96
+#define sc_cobalt_waitset_add           97
+#define sc_cobalt_waitset_wait          98
+#define sc_cobalt_waitset_modify        99
+#define sc_cobalt_waitset_remove        100
 
 #endif /* !_COBALT_UAPI_SYSCALL_H */
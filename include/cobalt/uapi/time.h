@@ -22,6 +22,14 @@
 #define CLOCK_MONOTONIC_RAW  4
 #endif
 
+#ifndef CLOCK_REALTIME_COARSE
+#define CLOCK_REALTIME_COARSE  5
+#endif
+
+#ifndef CLOCK_MONOTONIC_COARSE
+#define CLOCK_MONOTONIC_COARSE  6
+#endif
+
 /*
  * Additional clock ids we manage are supposed not to collide with any
  * of the POSIX and Linux kernel definitions so that no ambiguities
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_TIMER_H
+#define _COBALT_UAPI_TIMER_H
+
+#include <cobalt/uapi/kernel/types.h>
+#include <cobalt/uapi/kernel/urw.h>
+
+/*
+ * Per-timer state published by the core into the private heap of
+ * the owner process, so that timer_gettime() and timer_getoverrun()
+ * can be served without trapping. Dates are absolute monotonic
+ * nanoseconds, zero meaning that the timer is not armed.
+ */
+#define COBALT_TIMER_USED   0x1	/* Core timer, overruns are valid. */
+#define COBALT_TIMER_DATED  0x2	/* Date/interval are valid. */
+#define COBALT_TIMER_MONO   0x4	/* Based on a monotonic clock. */
+
+/*
+ * The generation word is bumped by the core each time the timer
+ * state changes. The low bits carry the lazy rearming protocol:
+ * userland may post a later one-shot date in ->defer without
+ * trapping; the core picks it up when the current date elapses
+ * instead of notifying the owner.
+ */
+#define COBALT_TIMER_DEFER  0x1	/* ->defer holds a pending date. */
+#define COBALT_TIMER_BUSY   0x2	/* ->defer is being updated. */
+#define COBALT_TIMER_GEN    0x4
+
+struct cobalt_timer_data {
+	urw_t lock;
+	unsigned int flags;
+	atomic_long_t gen;
+	int overruns;
+	unsigned long long date;
+	unsigned long long interval;
+	unsigned long long defer;
+};
+
+/*
+ * Slots are allocated on demand by chunks, timer ids being handed
+ * out lowest first. The table only gives the heap offset of every
+ * chunk, COBALT_TIMER_NOCHUNK until it is allocated.
+ */
+#define COBALT_TIMER_CHUNK    16
+#define COBALT_TIMER_NOCHUNK  (~0UL)
+
+struct cobalt_timer_table {
+	unsigned int nr;
+	unsigned long chunks[0];
+};
+
+#endif /* !_COBALT_UAPI_TIMER_H */
@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+#ifndef _COBALT_UAPI_WAITSET_H
+#define _COBALT_UAPI_WAITSET_H
+
+struct cobalt_waitset;
+
+/* Member types. */
+#define COBALT_WAITSET_SEM     0	/* sem_t, readable when count > 0. */
+#define COBALT_WAITSET_EVENT   1	/* cobalt_event_t, readable when mask bits set. */
+#define COBALT_WAITSET_FDREAD  2	/* mqd_t or RTDM fd, ready for reading. */
+#define COBALT_WAITSET_FDWRITE 3	/* mqd_t or RTDM fd, ready for writing. */
+
+struct cobalt_waitset_shadow {
+	struct cobalt_waitset *waitset;
+};
+
+typedef struct cobalt_waitset_shadow cobalt_waitset_t;
+
+#endif /* !_COBALT_UAPI_WAITSET_H */
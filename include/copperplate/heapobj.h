@@ -74,6 +74,7 @@ void free_ex(void *pool, void *ptr);
 void *tlsf_malloc(size_t size);
 void tlsf_free(void *ptr);
 size_t malloc_usable_size_ex(void *ptr, void *pool);
+size_t get_free_stats(void *pool, size_t *largest, size_t *nfrags);
 
 static inline
 void pvheapobj_destroy(struct heapobj *hobj)
@@ -115,6 +116,13 @@ size_t pvheapobj_inquire(struct heapobj *hobj)
 	return get_used_size(hobj->pool);
 }
 
+static inline
+size_t pvheapobj_inquire_free(struct heapobj *hobj,
+			      size_t *largest_r, size_t *nfrags_r)
+{
+	return get_free_stats(hobj->pool, largest_r, nfrags_r);
+}
+
 static inline void *pvmalloc(size_t size)
 {
 	return tlsf_malloc(size);
@@ -171,6 +179,9 @@ void pvheapobj_free(struct heapobj *hobj, void *ptr);
 
 size_t pvheapobj_inquire(struct heapobj *hobj);
 
+size_t pvheapobj_inquire_free(struct heapobj *hobj,
+			      size_t *largest_r, size_t *nfrags_r);
+
 size_t pvheapobj_validate(struct heapobj *hobj, void *ptr);
 
 #endif /* !CONFIG_XENO_TLSF */
@@ -29,6 +29,7 @@
 #define SYNCOBJ_FIFO	0x0
 #define SYNCOBJ_PRIO	0x1
 #define SYNCOBJ_LOCKED	0x2
+#define SYNCOBJ_ADAPTIVE 0x4
 
 /* threadobj->wait_status */
 #define SYNCOBJ_FLUSHED		0x1
@@ -69,6 +70,7 @@ struct syncobj {
 	int grant_count;
 	struct list drain_list;
 	int drain_count;
+	int spin_avg;
 	struct syncobj_corespec core;
 	fnref_type(void (*)(struct syncobj *sobj)) finalizer;
 };
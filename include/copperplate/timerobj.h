@@ -24,15 +24,25 @@
 #include <boilerplate/list.h>
 #include <boilerplate/lock.h>
 
+struct timerserver;
+
 struct timerobj {
 	struct itimerspec itspec;
 	void (*handler)(struct timerobj *tmobj);
 	timer_t timer;
 	pthread_mutex_t lock;
 	int cancel_state;
+	struct timerserver *server;
 	struct pvholder next;
 };
 
+/* Serve the timer on the CPU its creator is bound to, if any. */
+#define TIMEROBJ_CPU_AUTO	-1
+/* Serve the timer from a server not bound to any CPU. */
+#define TIMEROBJ_CPU_SHARED	-2
+/* Serve the timer above all threads. */
+#define TIMEROBJ_PRIO_DEFAULT	-1
+
 static inline int timerobj_lock(struct timerobj *tmobj)
 {
 	return write_lock_safe(&tmobj->lock, tmobj->cancel_state);
@@ -54,6 +64,8 @@ extern "C" {
 
 int timerobj_init(struct timerobj *tmobj);
 
+int timerobj_init_server(struct timerobj *tmobj, int cpu, int prio);
+
 void timerobj_destroy(struct timerobj *tmobj);
 
 int timerobj_start(struct timerobj *tmobj,
@@ -64,6 +64,7 @@
 #define SM_LOCAL      0x0000
 #define SM_PRIOR      0x0002
 #define SM_FIFO       0x0000
+#define SM_SPIN       0x0004
 #define SM_NOWAIT     0x0001
 #define SM_WAIT       0x0000
 
@@ -88,6 +89,7 @@
 #define Q_NOLIMIT     0x0000
 #define Q_PRIBUF      0x0008
 #define Q_SYSBUF      0x0000
+#define Q_SPIN        0x0010
 #define Q_NOWAIT      0x0001
 #define Q_WAIT        0x0000
 
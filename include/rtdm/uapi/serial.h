@@ -90,6 +90,9 @@
 #define RTSER_FIFO_DEPTH_4		0x40
 #define RTSER_FIFO_DEPTH_8		0x80
 #define RTSER_FIFO_DEPTH_14		0xC0
+/** let the driver adapt the threshold to the observed inter-byte gap,
+ *  starting from the depth OR-ed to this flag (16550A only) */
+#define RTSER_FIFO_DEPTH_ADAPTIVE	0x100
 #define RTSER_DEF_FIFO_DEPTH		RTSER_FIFO_DEPTH_1
 /** @} */
 
@@ -270,6 +273,38 @@ typedef struct rtser_event {
 	nanosecs_abs_t	rxpend_timestamp;
 } rtser_event_t;
 
+/**
+ * Serial device statistics, accumulated since the device was opened
+ */
+typedef struct rtser_stats {
+	/** number of interrupts handled */
+	unsigned long long	irqs;
+
+	/** number of interrupts which received data */
+	unsigned long long	rx_irqs;
+
+	/** number of characters received */
+	unsigned long long	rx_bytes;
+
+	/** number of characters transmitted */
+	unsigned long long	tx_bytes;
+
+	/** number of characters lost due to RX ring overflow */
+	unsigned long long	rx_overruns;
+
+	/** number of RX FIFO threshold changes, see
+	 *  @ref RTSER_FIFO_DEPTH_ADAPTIVE */
+	unsigned long long	trigger_changes;
+
+	/** current reception FIFO threshold, see @ref RTSER_FIFO_xxx */
+	int			fifo_depth;
+
+	int			reserved;
+
+	/** smoothed inter-byte reception gap */
+	nanosecs_rel_t		rx_gap;
+} rtser_stats_t;
+
 
 #define RTIOC_TYPE_SERIAL		RTDM_CLASS_SERIAL
 
@@ -451,6 +486,32 @@ typedef struct rtser_event {
  */
 #define RTSER_RTIOC_BREAK_CTL	\
 	_IOR(RTIOC_TYPE_SERIAL, 0x06, int)
+
+/**
+ * Get serial device statistics
+ *
+ * @param[out] arg Pointer to statistics buffer (struct rtser_stats)
+ *
+ * @return 0 on success, otherwise:
+ *
+ * - -ENOTTY is returned if the driver does not collect statistics.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel module initialization/cleanup code
+ * - Kernel-based task
+ * - User-space task (RT, non-RT)
+ *
+ * @note Dividing @c irqs by @c rx_bytes gives the interrupt cost per
+ * received character, which @ref RTSER_FIFO_DEPTH_ADAPTIVE tries to
+ * keep low under sustained traffic.
+ *
+ * Rescheduling: never.
+ */
+#define RTSER_RTIOC_GET_STATS	\
+	_IOR(RTIOC_TYPE_SERIAL, 0x07, struct rtser_stats)
 /** @} */
 
 /*!
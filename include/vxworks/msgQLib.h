@@ -33,6 +33,7 @@ typedef uintptr_t MSG_Q_ID;
 
 #define MSG_Q_FIFO       0x0
 #define MSG_Q_PRIORITY   0x1
+#define MSG_Q_SPIN       0x1000
 
 #ifdef __cplusplus
 extern "C" {
@@ -30,6 +30,7 @@
 #define SEM_Q_PRIORITY       0x1
 #define SEM_DELETE_SAFE      0x4
 #define SEM_INVERSION_SAFE   0x8
+#define SEM_SPIN             0x1000
 
 typedef uintptr_t SEM_ID;
 
@@ -34,6 +34,8 @@ extern "C" {
 
 WDOG_ID wdCreate(void);
 
+WDOG_ID wdCreatePrio(int prio);
+
 STATUS wdDelete(WDOG_ID wdog_id);
 
 STATUS wdStart(WDOG_ID wdog_id,
@@ -539,6 +539,38 @@ void xnclock_deregister(struct xnclock *clock)
 }
 EXPORT_SYMBOL_GPL(xnclock_deregister);
 
+static inline void publish_clock(struct xnclock *clock, xnticks_t now)
+{				/* nklocked, IRQs off. */
+	struct xnvdso_extclock_data *ext;
+	struct xnvdso_coarse_data *coarse;
+	xnticks_t date;
+	urwstate_t tmp;
+
+	if (likely(clock == &nkclock)) {
+		date = xnclock_ticks_to_ns(clock, now);
+		/*
+		 * Ticks may be processed on different CPUs, make sure
+		 * the coarse clock never goes backward.
+		 */
+		coarse = &nkvdso->coarse_data;
+		if (date > coarse->date) {
+			unsynced_write_block(&tmp, &coarse->lock)
+				coarse->date = date;
+		}
+		return;
+	}
+
+	if ((unsigned int)clock->id >= XNVDSO_MAX_EXTCLOCKS)
+		return;
+
+	ext = get_extclock_data(clock->id);
+	if (ext->live) {
+		unsynced_write_block(&tmp, &ext->lock)
+			ext->offset = xnclock_read_monotonic(clock) -
+				xnclock_core_read_monotonic();
+	}
+}
+
 /**
  * @fn void xnclock_tick(struct xnclock *clock)
  * @brief Process a clock tick.
@@ -570,6 +602,8 @@ void xnclock_tick(struct xnclock *clock)
 	sched->status |= XNINTCK;
 
 	now = xnclock_read_raw(clock);
+	publish_clock(clock, now);
+
 	while ((h = xntimerq_head(timerq)) != NULL) {
 		timer = container_of(h, struct xntimer, aplink);
 		/*
@@ -1384,6 +1384,7 @@ static inline void init_vdso(void)
 	if (nkvdso == NULL)
 		xnsys_fatal("cannot allocate memory for VDSO!\n");
 
+	memset(nkvdso, 0, sizeof(*nkvdso));
 	nkvdso->features = XNVDSO_FEATURES;
 }
 
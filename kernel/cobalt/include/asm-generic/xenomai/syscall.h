@@ -76,13 +76,15 @@ struct xnsyscall {
 #define __xn_exec_oneway    (__xn_exec_any|__xn_exec_norestart)
 
 	unsigned long flags;
+	/* Service name, for statistics. */
+	const char *name;
 };
 
 #define __syscast__(fn)	((int (*)(unsigned long, unsigned long,	\
 				  unsigned long, unsigned long, unsigned long))(fn))
 
 #define SKINCALL_DEF(nr, fn, fl)	\
-	[nr] = { .svc = __syscast__(fn), .flags = __xn_exec_##fl }
+	[nr] = { .svc = __syscast__(fn), .flags = __xn_exec_##fl, .name = #fn }
 
 #define access_rok(addr, size)	access_ok(VERIFY_READ, (addr), (size))
 #define access_wok(addr, size)	access_ok(VERIFY_WRITE, (addr), (size))
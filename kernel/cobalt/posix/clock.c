@@ -38,11 +38,18 @@
  * strictly equivalent to CLOCK_MONOTONIC with Xenomai, which is not
  * NTP adjusted either.
  *
+ * CLOCK_MONOTONIC_COARSE and CLOCK_REALTIME_COARSE are Linux-specific
+ * too, and return the date of the latest tick of the core clock,
+ * which happens at least as often as the host tick. They can be read
+ * from user-space without issuing any system call.
+ *
  * In addition, external clocks can be dynamically registered using
  * the cobalt_clock_register() service. These clocks are fully managed
  * by Cobalt extension code, which should advertise each incoming tick
  * by calling xnclock_tick() for the relevant clock, from an interrupt
- * context.
+ * context. User-space reads these clocks without issuing any system
+ * call, by extrapolating at the core clock rate from their latest
+ * tick.
  *
  * Timer objects may be created with the timer_create() service using
  * any of the built-in or external clocks. The resolution of these
@@ -132,6 +139,18 @@ static int do_clock_host_realtime(struct timespec *tp)
 #endif
 }
 
+static xnticks_t read_coarse_clock(void)
+{
+	struct xnvdso_coarse_data *coarse = &nkvdso->coarse_data;
+	xnticks_t date;
+	urwstate_t tmp;
+
+	unsynced_read_block(&tmp, &coarse->lock)
+		date = coarse->date;
+
+	return date;
+}
+
 #define do_ext_clock(__clock_id, __handler, __ret, __args...)	\
 ({								\
 	struct xnclock *__clock;				\
@@ -167,6 +186,11 @@ int cobalt_clock_getres(clockid_t clock_id, struct timespec __user *u_ts)
 	case CLOCK_MONOTONIC_RAW:
 		ns2ts(&ts, 1);
 		break;
+	case CLOCK_REALTIME_COARSE:
+	case CLOCK_MONOTONIC_COARSE:
+		/* The host tick is relayed by the core clock. */
+		ns2ts(&ts, TICK_NSEC);
+		break;
 	default:
 		ret = do_ext_clock(clock_id, get_resolution, ns);
 		if (ret)
@@ -194,6 +218,12 @@ int cobalt_clock_gettime(clockid_t clock_id, struct timespec __user *u_ts)
 	case CLOCK_MONOTONIC_RAW:
 		ns2ts(&ts, xnclock_read_monotonic(&nkclock));
 		break;
+	case CLOCK_REALTIME_COARSE:
+		ns2ts(&ts, read_coarse_clock() + nkclock.wallclock_offset);
+		break;
+	case CLOCK_MONOTONIC_COARSE:
+		ns2ts(&ts, read_coarse_clock());
+		break;
 	case CLOCK_HOST_REALTIME:
 		if (do_clock_host_realtime(&ts) != 0)
 			return -EINVAL;
@@ -294,9 +324,13 @@ int cobalt_clock_nanosleep(clockid_t clock_id, int flags,
 
 int cobalt_clock_register(struct xnclock *clock, clockid_t *clk_id)
 {
+	struct xnvdso_extclock_data *ext;
+	urwstate_t tmp;
 	int ret, nr;
 	spl_t s;
 
+	BUILD_BUG_ON(COBALT_MAX_EXTCLOCKS > XNVDSO_MAX_EXTCLOCKS);
+
 	xnlock_get_irqsave(&nklock, s);
 
 	nr = find_first_zero_bit(cobalt_clock_extids, COBALT_MAX_EXTCLOCKS);
@@ -315,11 +349,29 @@ int cobalt_clock_register(struct xnclock *clock, clockid_t *clk_id)
 
 	xnlock_put_irqrestore(&nklock, s);
 
+	/*
+	 * Set the clock id early, xnclock_tick() uses it to publish
+	 * the clock state to userland.
+	 */
+	clock->id = nr;
 	ret = xnclock_register(clock);
 	if (ret)
 		return ret;
 
-	clock->id = nr;
+	/*
+	 * Let userland read this clock without trapping, by
+	 * extrapolating from the offset to the core clock sampled on
+	 * each tick.
+	 */
+	ext = get_extclock_data(nr);
+	xnlock_get_irqsave(&nklock, s);
+	unsynced_write_block(&tmp, &ext->lock) {
+		ext->offset = xnclock_read_monotonic(clock) -
+			xnclock_core_read_monotonic();
+		ext->live = 1;
+	}
+	xnlock_put_irqrestore(&nklock, s);
+
 	*clk_id = __COBALT_CLOCK_CODE(clock->id);
 
 	return 0;
@@ -328,6 +380,15 @@ EXPORT_SYMBOL_GPL(cobalt_clock_register);
 
 void cobalt_clock_deregister(struct xnclock *clock)
 {
+	struct xnvdso_extclock_data *ext = get_extclock_data(clock->id);
+	urwstate_t tmp;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	unsynced_write_block(&tmp, &ext->lock)
+		ext->live = 0;
+	xnlock_put_irqrestore(&nklock, s);
+
 	clear_bit(clock->id, cobalt_clock_extids);
 	smp_mb__after_clear_bit();
 	external_clocks[clock->id] = NULL;
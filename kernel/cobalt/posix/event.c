@@ -81,6 +81,7 @@ int cobalt_event_init(struct cobalt_event_shadow __user *u_evtsh,
 	event->flags = flags;
 	synflags = (flags & COBALT_EVENT_PRIO) ? XNSYNCH_PRIO : XNSYNCH_FIFO;
 	xnsynch_init(&event->synch, synflags, NULL);
+	xnselect_init(&event->select_block);
 	event->magic = COBALT_EVENT_MAGIC;
 	kq = cobalt_kqueues(pshared);
 	event->owningq = kq;
@@ -148,9 +149,14 @@ int cobalt_event_wait(struct cobalt_event_shadow __user *u_evtsh,
 		goto out;
 	}
 
+	/*
+	 * Userland posts the value first, then checks the pended
+	 * flag, we do the converse.
+	 */
 	datp->flags |= COBALT_EVENT_PENDED;
+	smp_mb();
 	rbits = datp->value & bits;
-	testval = mode & COBALT_EVENT_ANY ? rbits : datp->value;
+	testval = mode & COBALT_EVENT_ANY ? rbits : bits;
 	if (rbits && rbits == testval)
 		goto done;
 
@@ -227,6 +233,11 @@ int cobalt_event_sync(struct cobalt_event_shadow __user *u_evtsh)
 		}
 	}
 
+	if (!list_empty(&event->select_block.bindings))
+		__xnselect_signal(&event->select_block, bits != 0);
+	else
+		datp->flags &= ~COBALT_EVENT_WATCHED;
+
 	xnsched_run();
 out:
 	xnlock_put_irqrestore(&nklock, s);
@@ -247,6 +258,7 @@ static void cobalt_event_destroy_inner(struct cobalt_event *event,
 	pshared = (event->flags & COBALT_EVENT_SHARED) != 0;
 
 	xnlock_put_irqrestore(&nklock, s);
+	xnselect_destroy(&event->select_block);
 	heap = &xnsys_ppd_get(pshared)->sem_heap;
 	xnheap_free(heap, event->data);
 	xnfree(event);
@@ -278,6 +290,53 @@ out:
 	return ret;
 }
 
+int cobalt_event_select_bind(struct cobalt_event_shadow __user *u_evtsh,
+			     struct xnselector *selector, unsigned int index,
+			     struct cobalt_event **eventp)
+{
+	struct xnselect_binding *binding;
+	struct cobalt_event *event = NULL;
+	struct cobalt_event_data *datp;
+	int ret;
+	spl_t s;
+
+	__xn_get_user(event, &u_evtsh->event);
+
+	binding = xnmalloc(sizeof(*binding));
+	if (binding == NULL)
+		return -ENOMEM;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!cobalt_obj_active(event, COBALT_EVENT_MAGIC,
+			       struct cobalt_event)) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	/*
+	 * Have cobalt_event_post() call us back on every update, then
+	 * sample the current state.
+	 */
+	datp = event->data;
+	datp->flags |= COBALT_EVENT_WATCHED;
+	smp_mb();
+	ret = xnselect_bind(&event->select_block, binding, selector,
+			    XNSELECT_READ, index, datp->value != 0);
+	if (ret)
+		goto fail;
+
+	*eventp = event;
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+fail:
+	xnlock_put_irqrestore(&nklock, s);
+	xnfree(binding);
+
+	return ret;
+}
+
 void cobalt_eventq_cleanup(struct cobalt_kqueues *q)
 {
 	struct cobalt_event *event, *tmp;
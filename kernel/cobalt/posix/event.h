@@ -20,6 +20,7 @@
 #define _COBALT_POSIX_EVENT_H
 
 #include <cobalt/kernel/synch.h>
+#include <cobalt/kernel/select.h>
 #include <cobalt/uapi/event.h>
 
 struct cobalt_kqueues;
@@ -31,6 +32,7 @@ struct cobalt_event {
 	struct cobalt_event_data *data;
 	struct cobalt_kqueues *owningq;
 	struct list_head link;
+	struct xnselect select_block;
 	int flags;
 };
 
@@ -48,6 +50,10 @@ int cobalt_event_sync(struct cobalt_event_shadow __user *u_evtsh);
 
 int cobalt_event_destroy(struct cobalt_event_shadow __user *u_evtsh);
 
+int cobalt_event_select_bind(struct cobalt_event_shadow __user *u_evtsh,
+			     struct xnselector *selector, unsigned int index,
+			     struct cobalt_event **eventp);
+
 void cobalt_eventq_cleanup(struct cobalt_kqueues *q);
 
 void cobalt_event_pkg_init(void);
@@ -56,6 +56,7 @@
 #include "timer.h"
 #include "monitor.h"
 #include "event.h"
+#include "waitset.h"
 
 MODULE_DESCRIPTION("Xenomai/cobalt POSIX interface");
 MODULE_AUTHOR("gilles.chanteperdrix@xenomai.org");
@@ -64,6 +65,7 @@ MODULE_LICENSE("GPL");
 void cobalt_cleanup(void)
 {
 	cobalt_syscall_cleanup();
+	cobalt_waitset_pkg_cleanup();
 	cobalt_monitor_pkg_cleanup();
 	cobalt_event_pkg_cleanup();
 	cobalt_signal_pkg_cleanup();
@@ -90,6 +92,7 @@ int __init cobalt_init(void)
 	cobalt_mq_pkg_init();
 	cobalt_event_pkg_init();
 	cobalt_monitor_pkg_init();
+	cobalt_waitset_pkg_init();
 
 	INIT_LIST_HEAD(&cobalt_global_kqueues.threadq);
 	cobalt_time_slice = CONFIG_XENO_OPT_RR_QUANTUM * 1000;
@@ -100,6 +100,8 @@ int cobalt_monitor_init(struct cobalt_monitor_shadow __user *u_monsh,
 	xnlock_put_irqrestore(&nklock, s);
 
 	datp->flags = 0;
+	datp->grant_waiters = 0;
+	datp->drain_waiters = 0;
 	datoff = xnheap_mapped_offset(heap, datp);
 	monsh.flags = flags;
 	monsh.monitor = mon;
@@ -202,6 +204,7 @@ static void cobalt_monitor_wakeup(struct cobalt_monitor *mon)
 			xnsynch_wakeup_this_sleeper(&thread->monitor_synch, p);
 			list_del(&thread->monitor_link);
 			thread->monitor_queued = 0;
+			datp->grant_waiters--;
 		}
 	}
 drain:
@@ -265,17 +268,27 @@ int cobalt_monitor_wait(struct cobalt_monitor_shadow __user *u_monsh,
 	xnsynch_release(&mon->gate, &curr->threadbase);
 
 	synch = &curr->monitor_synch;
-	if (event & COBALT_MONITOR_WAITDRAIN)
+	if (event & COBALT_MONITOR_WAITDRAIN) {
 		synch = &mon->drain;
-	else {
+		datp->drain_waiters++;
+	} else {
 		curr->threadbase.u_window->grant_value = 0;
 		list_add_tail(&curr->monitor_link, &mon->waiters);
 		curr->monitor_queued = 1;
+		datp->grant_waiters++;
 	}
 	datp->flags |= COBALT_MONITOR_PENDED;
 
 	tmode = u_ts ? mon->tmode : XN_RELATIVE;
 	info = xnsynch_sleep_on(synch, timeout, tmode);
+	/*
+	 * Drain sleepers are not tracked individually, so we may
+	 * overstate their count until they resume; userland only
+	 * issues a useless syscall in the meantime.
+	 */
+	if ((event & COBALT_MONITOR_WAITDRAIN) &&
+	    (info & XNRMID) == 0)
+		datp->drain_waiters--;
 	if (info) {
 		if ((info & XNRMID) != 0 ||
 		    !cobalt_obj_active(mon, COBALT_MONITOR_MAGIC,
@@ -288,6 +301,7 @@ int cobalt_monitor_wait(struct cobalt_monitor_shadow __user *u_monsh,
 		    curr->monitor_queued) {
 			list_del(&curr->monitor_link);
 			curr->monitor_queued = 0;
+			datp->grant_waiters--;
 		}
 
 		if (list_empty(&mon->waiters) && !xnsynch_pended_p(&mon->drain))
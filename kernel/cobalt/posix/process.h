@@ -21,6 +21,7 @@
 #include <linux/list.h>
 #include <linux/bitmap.h>
 #include <cobalt/kernel/ppd.h>
+#include <cobalt/uapi/timer.h>
 
 struct cobalt_kqueues {
 	struct list_head condq;
@@ -29,8 +30,12 @@ struct cobalt_kqueues {
 	struct list_head threadq;
 	struct list_head monitorq;
 	struct list_head eventq;
+	struct list_head waitsetq;
 };
 
+#define COBALT_TIMER_NRCHUNKS \
+	DIV_ROUND_UP(CONFIG_XENO_OPT_NRTIMERS, COBALT_TIMER_CHUNK)
+
 struct cobalt_timer;
 struct cobalt_process {
 	struct cobalt_kqueues kqueues;
@@ -39,6 +44,8 @@ struct cobalt_process {
 	struct list_head sigwaiters;
 	DECLARE_BITMAP(timers_map, CONFIG_XENO_OPT_NRTIMERS);
 	struct cobalt_timer *timers[CONFIG_XENO_OPT_NRTIMERS];
+	struct cobalt_timer_table *timer_table;
+	struct cobalt_timer_data *timer_chunks[COBALT_TIMER_NRCHUNKS];
 };
 
 extern struct cobalt_kqueues cobalt_global_kqueues;
@@ -64,7 +64,8 @@ static int first_fd_valid_p(fd_set *fds[XNSELECT_MAX_TYPES], int nfds)
 	return 1;
 }
 
-static int select_bind_one(struct xnselector *selector, unsigned type, int fd)
+int cobalt_select_bind(struct xnselector *selector, unsigned type,
+		       int fd, unsigned index)
 {
 	const int rtdm_fd_start = __FD_SETSIZE - RTDM_FD_MAX;
 	struct cobalt_process *cc;
@@ -72,7 +73,7 @@ static int select_bind_one(struct xnselector *selector, unsigned type, int fd)
 
 	if (fd >= rtdm_fd_start)
 		return rtdm_select_bind(fd - rtdm_fd_start,
-					selector, type, fd);
+					selector, type, index);
 
 	cc = cobalt_process_context();
 	if (cc == NULL)
@@ -82,7 +83,13 @@ static int select_bind_one(struct xnselector *selector, unsigned type, int fd)
 	if (assoc == NULL)
 		return -EBADF;
 
-	return cobalt_mq_select_bind(assoc2ufd(assoc)->kfd, selector, type, fd);
+	return cobalt_mq_select_bind(assoc2ufd(assoc)->kfd, selector, type, index);
+}
+
+static inline int select_bind_one(struct xnselector *selector,
+				  unsigned type, int fd)
+{
+	return cobalt_select_bind(selector, type, fd, fd);
 }
 
 static int select_bind_all(struct xnselector *selector,
@@ -22,6 +22,11 @@
 #include <linux/types.h>
 #include <linux/time.h>
 
+struct xnselector;
+
+int cobalt_select_bind(struct xnselector *selector, unsigned type,
+		       int fd, unsigned index);
+
 int cobalt_select(int nfds,
 		  fd_set __user *u_rfds,
 		  fd_set __user *u_wfds,
@@ -74,6 +74,7 @@ int cobalt_sem_destroy_inner(xnhandle_t handle)
 	
 	xnlock_put_irqrestore(&nklock, s);
 
+	xnselect_destroy(&sem->select_block);
 	xnheap_free(&xnsys_ppd_get(!!(sem->flags & SEM_PSHARED))->sem_heap,
 		sem->datp);
 	xnregistry_remove(sem->handle);
@@ -153,6 +154,7 @@ cobalt_sem_init_inner(const char *name, struct __shadow_sem *sm,
 	list_add_tail(&sem->link, &kq->semq);
 	sflags = flags & SEM_FIFO ? 0 : XNSYNCH_PRIO;
 	xnsynch_init(&sem->synchbase, sflags, NULL);
+	xnselect_init(&sem->select_block);
 
 	sem->datp = datp;
 	atomic_long_set(&datp->value, value);
@@ -550,6 +552,8 @@ int sem_post_inner(struct cobalt_sem *sem, struct cobalt_kqueues *ownq, int bcas
 				xnsched_run();
 		} else if (sem->flags & SEM_PULSE)
 			atomic_long_set(&sem->datp->value, 0);
+		else if (xnselect_signal(&sem->select_block, 1))
+			xnsched_run();
 	} else {
 		if (atomic_long_read(&sem->datp->value) < 0) {
 			atomic_long_set(&sem->datp->value, 0);
@@ -559,6 +563,14 @@ int sem_post_inner(struct cobalt_sem *sem, struct cobalt_kqueues *ownq, int bcas
 		}
 	}
 
+	/*
+	 * Once the last waitset let go of us, allow sem_post() to
+	 * take the userland fast path again.
+	 */
+	if ((sem->datp->flags & SEM_WATCHED) &&
+	    list_empty(&sem->select_block.bindings))
+		sem->datp->flags &= ~SEM_WATCHED;
+
 	return 0;
 }
 
@@ -774,6 +786,54 @@ int cobalt_sem_broadcast_np(struct __shadow_sem __user *u_sem)
 	return err;
 }
 
+int cobalt_sem_select_bind(struct __shadow_sem __user *u_sem,
+			   struct xnselector *selector, unsigned int index,
+			   struct cobalt_sem **semp)
+{
+	struct xnselect_binding *binding;
+	struct cobalt_sem *sem;
+	xnhandle_t handle;
+	int ret;
+	spl_t s;
+
+	__xn_get_user(handle, &u_sem->handle);
+
+	binding = xnmalloc(sizeof(*binding));
+	if (binding == NULL)
+		return -ENOMEM;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	sem = xnregistry_fetch(handle);
+	if (!cobalt_obj_active(sem, COBALT_SEM_MAGIC, typeof(*sem))) {
+		ret = -EINVAL;
+		goto fail;
+	}
+
+	/*
+	 * Force sem_post() through the kernel so that the selector
+	 * hears about every count increase from now on, then sample
+	 * the current state.
+	 */
+	sem->datp->flags |= SEM_WATCHED;
+	smp_mb();
+	ret = xnselect_bind(&sem->select_block, binding, selector,
+			    XNSELECT_READ, index,
+			    atomic_long_read(&sem->datp->value) > 0);
+	if (ret)
+		goto fail;
+
+	*semp = sem;
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+fail:
+	xnlock_put_irqrestore(&nklock, s);
+	xnfree(binding);
+
+	return ret;
+}
+
 void cobalt_semq_cleanup(struct cobalt_kqueues *q)
 {
 	struct cobalt_sem *sem, *tmp;
@@ -22,6 +22,7 @@
 #include <linux/fcntl.h>
 #include <cobalt/kernel/thread.h>
 #include <cobalt/kernel/registry.h>
+#include <cobalt/kernel/select.h>
 
 struct cobalt_process;
 
@@ -33,6 +34,7 @@ struct cobalt_sem {
 	struct sem_dat *datp;
 	int flags;
 	struct cobalt_kqueues *owningq;
+	struct xnselect select_block;
 	xnhandle_t handle;
 	unsigned refs;
 	char name[COBALT_MAXNAME];
@@ -97,6 +99,10 @@ int cobalt_sem_init_np(struct __shadow_sem __user *u_sem,
 
 int cobalt_sem_broadcast_np(struct __shadow_sem __user *u_sem);
 
+int cobalt_sem_select_bind(struct __shadow_sem __user *u_sem,
+			   struct xnselector *selector, unsigned int index,
+			   struct cobalt_sem **semp);
+
 void cobalt_semq_cleanup(struct cobalt_kqueues *q);
 
 void cobalt_sem_pkg_init(void);
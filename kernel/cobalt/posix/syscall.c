@@ -39,6 +39,7 @@
 #include "clock.h"
 #include "event.h"
 #include "select.h"
+#include "waitset.h"
 
 int cobalt_muxid;
 
@@ -56,10 +57,13 @@ static void *cobalt_process_attach(void)
 	INIT_LIST_HEAD(&cc->kqueues.threadq);
 	INIT_LIST_HEAD(&cc->kqueues.monitorq);
 	INIT_LIST_HEAD(&cc->kqueues.eventq);
+	INIT_LIST_HEAD(&cc->kqueues.waitsetq);
 	INIT_LIST_HEAD(&cc->uqds);
 	INIT_LIST_HEAD(&cc->sigwaiters);
 	xntree_init(&cc->usems);
 	bitmap_fill(cc->timers_map, CONFIG_XENO_OPT_NRTIMERS);
+	cc->timer_table = NULL;
+	memset(cc->timer_chunks, 0, sizeof(cc->timer_chunks));
 
 	return cc;
 }
@@ -71,6 +75,7 @@ static void cobalt_process_detach(void *arg)
 	cobalt_sem_usems_cleanup(cc);
 	cobalt_mq_uqds_cleanup(cc);
 	cobalt_timers_cleanup(cc);
+	cobalt_waitsetq_cleanup(&cc->kqueues);
 	cobalt_monitorq_cleanup(&cc->kqueues);
 	cobalt_semq_cleanup(&cc->kqueues);
 	cobalt_mutexq_cleanup(&cc->kqueues);
@@ -167,6 +172,12 @@ static struct xnsyscall cobalt_syscalls[] = {
 	SKINCALL_DEF(sc_cobalt_event_destroy, cobalt_event_destroy, any),
 	SKINCALL_DEF(sc_cobalt_event_wait, cobalt_event_wait, primary),
 	SKINCALL_DEF(sc_cobalt_event_sync, cobalt_event_sync, any),
+	SKINCALL_DEF(sc_cobalt_waitset_init, cobalt_waitset_init, any),
+	SKINCALL_DEF(sc_cobalt_waitset_destroy, cobalt_waitset_destroy, any),
+	SKINCALL_DEF(sc_cobalt_waitset_add, cobalt_waitset_add, any),
+	SKINCALL_DEF(sc_cobalt_waitset_wait, cobalt_waitset_wait, primary),
+	SKINCALL_DEF(sc_cobalt_waitset_modify, cobalt_waitset_modify, any),
+	SKINCALL_DEF(sc_cobalt_waitset_remove, cobalt_waitset_remove, any),
 	SKINCALL_DEF(sc_cobalt_sched_setconfig_np, cobalt_sched_setconfig_np, any),
 	SKINCALL_DEF(sc_cobalt_sched_getconfig_np, cobalt_sched_getconfig_np, any),
 };
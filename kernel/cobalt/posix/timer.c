@@ -30,9 +30,83 @@
 #include "timer.h"
 #include "clock.h"
 
+static long timer_bump(struct cobalt_timer_data *data)
+{				/* nklocked, IRQs off. */
+	long old, new;
+
+	/*
+	 * Move to the next generation, which also revokes any lazy
+	 * rearming request userland may have posted.
+	 */
+	do {
+		old = atomic_long_read(&data->gen);
+		new = (old + COBALT_TIMER_GEN) &
+			~(long)(COBALT_TIMER_DEFER|COBALT_TIMER_BUSY);
+	} while (atomic_long_cmpxchg(&data->gen, old, new) != old);
+
+	return old;
+}
+
+static void timer_publish(struct cobalt_timer *timer)
+{				/* nklocked, IRQs off. */
+	struct cobalt_timer_data *data = timer->data;
+	struct xntimer *xntimer = &timer->timerbase;
+	unsigned long long date = 0, interval = 0;
+	urwstate_t tmp;
+
+	if (data == NULL)
+		return;
+
+	/*
+	 * A periodic timer is dequeued while its handler runs, but
+	 * still counts as armed. Userland extrapolates the next shot
+	 * from the date and interval we publish.
+	 */
+	if (xntimer_running_p(xntimer) || xntimer_reload_p(xntimer)) {
+		date = xnclock_ticks_to_ns(xntimer_clock(xntimer),
+					   xntimer_get_expiry(xntimer));
+		if (xntimer_interval(xntimer) != XN_INFINITE)
+			interval = xnclock_ticks_to_ns(xntimer_clock(xntimer),
+						       xntimer_interval(xntimer));
+	}
+
+	unsynced_write_block(&tmp, &data->lock) {
+		/*
+		 * Dates of timers armed on the real-time clock move
+		 * when the clock is set, make userland ask us.
+		 */
+		if (xntimer->status & XNTIMER_REALTIME)
+			data->flags &= ~COBALT_TIMER_DATED;
+		else
+			data->flags |= COBALT_TIMER_DATED;
+		data->date = date;
+		data->interval = interval;
+		data->overruns = timer->overruns;
+	}
+}
+
 void cobalt_timer_handler(struct xntimer *xntimer)
 {
+	struct cobalt_timer_data *data;
 	struct cobalt_timer *timer;
+	long gen;
+
+	timer = container_of(xntimer, struct cobalt_timer, timerbase);
+	data = timer->data;
+	/*
+	 * If userland posted a later date for this one-shot timer
+	 * without trapping, reprogram the timer for it silently.
+	 */
+	if (data && !xntimer_reload_p(xntimer)) {
+		gen = timer_bump(data);
+		if ((gen & (COBALT_TIMER_DEFER|COBALT_TIMER_BUSY)) ==
+		    COBALT_TIMER_DEFER &&
+		    xntimer_start(xntimer, data->defer,
+				  XN_INFINITE, XN_ABSOLUTE) == 0) {
+			timer_publish(timer);
+			return;
+		}
+	}
 	/*
 	 * Deliver the timer notification via a signal (unless
 	 * SIGEV_NONE was given). If we can't do this because the
@@ -40,10 +114,12 @@ void cobalt_timer_handler(struct xntimer *xntimer)
 	 * away when timer_delete() is called, or the owner's process
 	 * exits, whichever comes first.
 	 */
-	timer = container_of(xntimer, struct cobalt_timer, timerbase);
 	if (timer->sigp.si.si_signo &&
 	    cobalt_signal_send_pid(timer->target, &timer->sigp) == -ESRCH)
 		xntimer_stop(&timer->timerbase);
+
+	if (data && !xntimer_reload_p(xntimer))
+		timer_publish(timer);
 }
 EXPORT_SYMBOL_GPL(cobalt_timer_handler);
 
@@ -114,6 +190,119 @@ static inline void timer_free_id(struct cobalt_process *cc, int id)
 	__set_bit(id, cc->timers_map);
 }
 
+static inline int timer_core_p(struct cobalt_timer *timer)
+{
+#ifdef CONFIG_XENO_OPT_COBALT_EXTENSION
+	return timer->extref.extension == NULL;
+#else
+	return 1;
+#endif
+}
+
+static struct cobalt_timer_table *timer_alloc_table(struct cobalt_process *cc)
+{
+	struct cobalt_timer_table *tab, *dup = NULL;
+	struct xnheap *heap;
+	size_t size;
+	spl_t s;
+	int n;
+
+	if (cc->timer_table)
+		return cc->timer_table;
+
+	/*
+	 * The timer table lives in the private heap of the current
+	 * process, which userland has mapped already. This heap is
+	 * small and shared with the synchronization objects, so we
+	 * only reserve the chunk directory upfront.
+	 */
+	heap = &xnsys_ppd_get(0)->sem_heap;
+	size = sizeof(*tab) + COBALT_TIMER_NRCHUNKS * sizeof(tab->chunks[0]);
+	tab = xnheap_alloc(heap, size);
+	if (tab == NULL)
+		return NULL;
+
+	tab->nr = CONFIG_XENO_OPT_NRTIMERS;
+	for (n = 0; n < COBALT_TIMER_NRCHUNKS; n++)
+		tab->chunks[n] = COBALT_TIMER_NOCHUNK;
+
+	xnlock_get_irqsave(&nklock, s);
+	if (cc->timer_table) {
+		dup = tab;
+		tab = cc->timer_table;
+	} else
+		cc->timer_table = tab;
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (dup)
+		xnheap_free(heap, dup);
+
+	return tab;
+}
+
+static int timer_alloc_chunk(struct cobalt_process *cc, int id)
+{				/* nklocked, IRQs off. */
+	struct cobalt_timer_data *chunk;
+	int n = id / COBALT_TIMER_CHUNK;
+	struct xnheap *heap;
+	size_t size;
+
+	if (cc->timer_chunks[n])
+		return 0;
+
+	heap = &xnsys_ppd_get(0)->sem_heap;
+	size = COBALT_TIMER_CHUNK * sizeof(*chunk);
+	chunk = xnheap_alloc(heap, size);
+	if (chunk == NULL)
+		return -EAGAIN;
+
+	memset(chunk, 0, size);
+	cc->timer_chunks[n] = chunk;
+	cc->timer_table->chunks[n] = xnheap_mapped_offset(heap, chunk);
+
+	return 0;
+}
+
+static void timer_init_data(struct cobalt_process *cc,
+			    struct cobalt_timer *timer)
+{				/* nklocked, IRQs off. */
+	struct cobalt_timer_data *data;
+	urwstate_t tmp;
+
+	if (!timer_core_p(timer)) {
+		timer->data = NULL;
+		return;
+	}
+
+	data = cc->timer_chunks[timer->id / COBALT_TIMER_CHUNK] +
+		timer->id % COBALT_TIMER_CHUNK;
+	timer_bump(data);
+	unsynced_write_block(&tmp, &data->lock) {
+		data->flags = COBALT_TIMER_USED|COBALT_TIMER_DATED;
+		if (timer->clockid == CLOCK_MONOTONIC ||
+		    timer->clockid == CLOCK_MONOTONIC_RAW)
+			data->flags |= COBALT_TIMER_MONO;
+		data->date = 0;
+		data->interval = 0;
+		data->overruns = 0;
+	}
+	timer->data = data;
+}
+
+static void timer_clear_data(struct cobalt_timer *timer)
+{				/* nklocked, IRQs off. */
+	struct cobalt_timer_data *data = timer->data;
+	urwstate_t tmp;
+
+	if (data == NULL)
+		return;
+
+	timer_bump(data);
+	unsynced_write_block(&tmp, &data->lock)
+		data->flags = 0;
+	timer->data = NULL;
+}
+
 struct cobalt_timer *
 cobalt_timer_by_id(struct cobalt_process *cc, timer_t timer_id)
 {
@@ -180,6 +369,9 @@ static inline int timer_create(clockid_t clockid,
 	if (cc == NULL)
 		return -EPERM;
 
+	if (timer_alloc_table(cc) == NULL)
+		return -EAGAIN;
+
 	timer = kmalloc(sizeof(*timer), GFP_KERNEL);
 	if (timer == NULL)
 		return -ENOMEM;
@@ -190,6 +382,7 @@ static inline int timer_create(clockid_t clockid,
 	INIT_LIST_HEAD(&timer->sigp.next);
 	timer->clockid = clockid;
 	timer->overruns = 0;
+	timer->data = NULL;
 
 	xnlock_get_irqsave(&nklock, s);
 
@@ -199,6 +392,10 @@ static inline int timer_create(clockid_t clockid,
 
 	timer_id = ret;
 
+	ret = timer_alloc_chunk(cc, timer_id);
+	if (ret)
+		goto fail;
+
 	if (evp == NULL) {
 		timer->sigp.si.si_int = timer_id;
 		signo = SIGALRM;
@@ -227,6 +424,7 @@ static inline int timer_create(clockid_t clockid,
 	}
 
 	timer->target = xnthread_host_pid(&target->threadbase);
+	timer_init_data(cc, timer);
 	cc->timers[timer_id] = timer;
 
 	xnlock_put_irqrestore(&nklock, s);
@@ -247,6 +445,7 @@ out:
 static void timer_cleanup(struct cobalt_process *p, struct cobalt_timer *timer)
 {
 	xntimer_destroy(&timer->timerbase);
+	timer_clear_data(timer);
 
 	if (!list_empty(&timer->sigp.next))
 		list_del(&timer->sigp.next);
@@ -307,6 +506,7 @@ static inline void
 timer_gettimeout(struct cobalt_timer *__restrict__ timer,
 		 struct itimerspec *__restrict__ value)
 {
+	xnticks_t now;
 	int ret;
 
 	if (!xntimer_running_p(&timer->timerbase)) {
@@ -317,6 +517,18 @@ timer_gettimeout(struct cobalt_timer *__restrict__ timer,
 		return;
 	}
 
+	if (timer->data &&
+	    (atomic_long_read(&timer->data->gen) &
+	     (COBALT_TIMER_DEFER|COBALT_TIMER_BUSY)) == COBALT_TIMER_DEFER) {
+		/* Userland moved the date lazily, report it. */
+		now = xnclock_read_monotonic(xntimer_clock(&timer->timerbase));
+		ns2ts(&value->it_value, timer->data->defer > now ?
+		      timer->data->defer - now : 1);
+		value->it_interval.tv_sec = 0;
+		value->it_interval.tv_nsec = 0;
+		return;
+	}
+
 	if (!cobalt_call_extension(timer_gettime, &timer->extref,
 				   ret, value) || ret == 0) {
 		ns2ts(&value->it_value,
@@ -470,6 +682,10 @@ timer_settime(timer_t timerid, int flags,
 		timer_gettimeout(timer, ovalue);
 
 	ret = timer_set(timer, flags, value);
+	if (timer->data && ret != -EINVAL) {
+		timer_bump(timer->data);
+		timer_publish(timer);
+	}
 	if (ret == -ETIMEDOUT) {
 		/*
 		 * Time has already passed, deliver a notification
@@ -548,10 +764,13 @@ int cobalt_timer_delete(timer_t timerid)
 
 int cobalt_timer_create(clockid_t clock,
 			const struct sigevent __user *u_sev,
-			timer_t __user *u_tm)
+			timer_t __user *u_tm,
+			unsigned long __user *u_taboff)
 {
 	struct sigevent sev, *evp = NULL;
+	struct cobalt_process *cc;
 	timer_t timerid = 0;
+	unsigned long taboff;
 	int ret;
 
 	if (u_sev) {
@@ -564,7 +783,16 @@ int cobalt_timer_create(clockid_t clock,
 	if (ret)
 		return ret;
 
-	if (__xn_safe_copy_to_user(u_tm, &timerid, sizeof(timerid))) {
+	/*
+	 * Tell userland where the timer table lives in its private
+	 * heap, so that it may read the timer state directly.
+	 */
+	cc = cobalt_process_context();
+	taboff = xnheap_mapped_offset(&xnsys_ppd_get(0)->sem_heap,
+				      cc->timer_table);
+
+	if (__xn_safe_copy_to_user(u_tm, &timerid, sizeof(timerid)) ||
+	    __xn_safe_copy_to_user(u_taboff, &taboff, sizeof(taboff))) {
 		timer_delete(timerid);
 		return -EFAULT;
 	}
@@ -655,15 +883,18 @@ int cobalt_timer_deliver(timer_t timerid) /* nklocked, IRQs off. */
 			timer->overruns = COBALT_DELAYMAX;
 	}
 
+	timer_publish(timer);
+
 	return timer->overruns;
 }
 
 void cobalt_timers_cleanup(struct cobalt_process *p)
 {
 	struct cobalt_timer *timer;
+	struct xnheap *heap;
 	unsigned id;
 	spl_t s;
-	int ret;
+	int ret, n;
 
 	xnlock_get_irqsave(&nklock, s);
 
@@ -687,5 +918,17 @@ void cobalt_timers_cleanup(struct cobalt_process *p)
 	}
 out:
 	xnlock_put_irqrestore(&nklock, s);
+
+	if (p->timer_table) {
+		heap = &xnsys_ppd_get(0)->sem_heap;
+		for (n = 0; n < COBALT_TIMER_NRCHUNKS; n++) {
+			if (p->timer_chunks[n]) {
+				xnheap_free(heap, p->timer_chunks[n]);
+				p->timer_chunks[n] = NULL;
+			}
+		}
+		xnheap_free(heap, p->timer_table);
+		p->timer_table = NULL;
+	}
 }
 /*@}*/
@@ -22,6 +22,7 @@
 #include <linux/time.h>
 #include <linux/list.h>
 #include <cobalt/kernel/timer.h>
+#include <cobalt/uapi/timer.h>
 
 struct cobalt_thread;
 struct cobalt_kqueues;
@@ -34,11 +35,13 @@ struct cobalt_timer {
 	pid_t target;
 	struct cobalt_sigpending sigp;
 	struct cobalt_extref extref;
+	struct cobalt_timer_data *data;
 };
 
 int cobalt_timer_create(clockid_t clock,
 			const struct sigevent __user *u_sev,
-			timer_t __user *u_tm);
+			timer_t __user *u_tm,
+			unsigned long __user *u_taboff);
 
 int cobalt_timer_delete(timer_t tm);
 
@@ -0,0 +1,618 @@
+/*
+ * @file
+ * This file is part of the Xenomai project.
+ *
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * \ingroup cobalt
+ * \defgroup cobalt_waitset Wait sets
+ *
+ * Multiple object wait services.
+ *
+ * A wait set gathers semaphores, event flag groups and file
+ * descriptors (message queues, RTDM devices) under a single
+ * persistent selector, so that a thread may wait for any of them to
+ * become ready. Members are registered once, then each wait only
+ * reports the members which became ready, without scanning or
+ * rebinding the whole set. Removing a member recycles its slot.
+ *
+ * Readiness is tracked by the select infrastructure, which queues
+ * the bindings having a pending state to the ready list of the
+ * selector. A wait therefore costs O(ready), regardless of the
+ * number of members. Since
+ * semaphores and event groups may be consumed by userland fast paths
+ * without notifying the core, the members reported by the selector
+ * are revalidated against the current object state upon wait, and
+ * stale indications are dropped.
+ *
+ * We expose this non-POSIX feature through the internal API of
+ * libcobalt only.
+ */
+#include <linux/err.h>
+#include "internal.h"
+#include "thread.h"
+#include "clock.h"
+#include "sem.h"
+#include "event.h"
+#include "select.h"
+#include "waitset.h"
+
+/* Max. number of ready members reported by a single wait. */
+#define WAITSET_MAXREADY  32
+
+/* Member states. */
+#define WAITSET_MEMBER_FREE   0
+#define WAITSET_MEMBER_BUSY   1	/* Being added. */
+#define WAITSET_MEMBER_LIVE   2	/* ->obj is NULL once reported deleted. */
+
+static inline unsigned int member_select_type(int type)
+{
+	return type == COBALT_WAITSET_FDWRITE ? XNSELECT_WRITE : XNSELECT_READ;
+}
+
+/* nklock held, irqs off */
+static int member_ready_p(struct cobalt_waitset_member *m)
+{
+	struct cobalt_event *event;
+	struct cobalt_sem *sem;
+
+	switch (m->type) {
+	case COBALT_WAITSET_SEM:
+		sem = m->obj;
+		return atomic_long_read(&sem->datp->value) > 0;
+	case COBALT_WAITSET_EVENT:
+		event = m->obj;
+		return (event->data->value & m->mask) != 0;
+	default:
+		/*
+		 * Message queues and RTDM drivers signal both
+		 * transitions accurately.
+		 */
+		return 1;
+	}
+}
+
+/*
+ * nklock held, irqs off. Report the members deleted under our feet,
+ * once. xnselect_destroy() dropped their binding, leaving the pending
+ * bit set and the expected bit cleared. This is the only place where
+ * we scan the bit fields, which only happens after some deletion.
+ */
+static int waitset_collect_deleted(struct cobalt_waitset *ws,
+				   int *ready, int nready)
+{
+	struct xnselector *selector = ws->selector;
+	struct cobalt_waitset_member *m;
+	unsigned int type;
+	fd_set *pending;
+	int count = 0, n;
+
+	for (type = XNSELECT_READ; type <= XNSELECT_WRITE; type++) {
+		pending = &selector->fds[type].pending;
+		for (n = find_first_bit(pending->fds_bits, ws->nr);
+		     n < ws->nr;
+		     n = find_next_bit(pending->fds_bits, ws->nr, n + 1)) {
+			m = ws->members + n;
+			if (m->obj == NULL ||
+			    __FD_ISSET__(n, &selector->fds[type].expected))
+				continue;
+			if (count == nready)
+				return count;
+			m->obj = NULL;
+			__FD_CLR__(n, pending);
+			ready[count++] = n;
+		}
+	}
+
+	ws->deletions = selector->deletions;
+
+	return count;
+}
+
+/*
+ * nklock held, irqs off. Collect up to @nready members from the
+ * ready list of the selector. A member is reported only if its
+ * object actually is ready, otherwise its pending state is dropped
+ * so that the next state change wakes us up again. The list is
+ * rotated past the last reported member, so that a busy member may
+ * not starve the others.
+ */
+static int waitset_collect(struct cobalt_waitset *ws,
+			   int *ready, int nready)
+{
+	struct xnselector *selector = ws->selector;
+	struct xnselect_binding *binding, *tmp;
+	struct cobalt_waitset_member *m;
+	int count = 0;
+
+	if (ws->deletions != selector->deletions) {
+		count = waitset_collect_deleted(ws, ready, nready);
+		if (count == nready)
+			return count;
+	}
+
+	list_for_each_entry_safe(binding, tmp, &selector->ready, rlink) {
+		m = ws->members + binding->bit_index;
+		if (m->state != WAITSET_MEMBER_LIVE)
+			continue;
+		if (!member_ready_p(m)) {
+			__xnselect_clear(binding);
+			continue;
+		}
+		ready[count++] = binding->bit_index;
+		if (count == nready) {
+			if (&tmp->rlink != &selector->ready)
+				list_move_tail(&selector->ready, &tmp->rlink);
+			break;
+		}
+	}
+
+	return count;
+}
+
+/* nklock held, irqs off. */
+static void waitset_free_slot(struct cobalt_waitset *ws, int index)
+{
+	struct cobalt_waitset_member *m = ws->members + index;
+
+	m->state = WAITSET_MEMBER_FREE;
+	m->obj = NULL;
+	m->next = ws->free;
+	ws->free = index;
+}
+
+/* nklock held, irqs off. Drops the lock temporarily. */
+static void waitset_release(struct cobalt_waitset *ws, spl_t s)
+{
+	xnlock_put_irqrestore(&nklock, s);
+	/* Drops all bindings, then releases the selector. */
+	xnselector_destroy(ws->selector);
+	xnfree(ws->members);
+	xnfree(ws);
+	xnlock_get_irqsave(&nklock, s);
+}
+
+/*
+ * nklock held, irqs off. Adding a member requires to drop the lock
+ * while binding it, during which the waitset may be destroyed. The
+ * last adder in flight then releases the waitset.
+ */
+static void waitset_put(struct cobalt_waitset *ws, spl_t s)
+{
+	if (--ws->refs == 0 && ws->magic != COBALT_WAITSET_MAGIC)
+		waitset_release(ws, s);
+}
+
+int cobalt_waitset_init(struct cobalt_waitset_shadow __user *u_wsh,
+			int nmax)
+{
+	struct cobalt_waitset_shadow wsh;
+	struct cobalt_waitset *ws;
+	struct cobalt_kqueues *kq;
+	spl_t s;
+
+	if (nmax <= 0 || nmax > __FD_SETSIZE)
+		return -EINVAL;
+
+	ws = xnmalloc(sizeof(*ws));
+	if (ws == NULL)
+		return -ENOMEM;
+
+	ws->members = xnmalloc(nmax * sizeof(*ws->members));
+	if (ws->members == NULL)
+		goto fail_members;
+
+	ws->selector = xnmalloc(sizeof(*ws->selector));
+	if (ws->selector == NULL)
+		goto fail_selector;
+
+	xnselector_init(ws->selector);
+	ws->nr = 0;
+	ws->nmax = nmax;
+	ws->free = -1;
+	ws->refs = 0;
+	ws->deletions = 0;
+	ws->magic = COBALT_WAITSET_MAGIC;
+	kq = cobalt_kqueues(0);
+	ws->owningq = kq;
+
+	xnlock_get_irqsave(&nklock, s);
+	list_add_tail(&ws->link, &kq->waitsetq);
+	xnlock_put_irqrestore(&nklock, s);
+
+	wsh.waitset = ws;
+
+	return __xn_safe_copy_to_user(u_wsh, &wsh, sizeof(*u_wsh));
+
+fail_selector:
+	xnfree(ws->members);
+fail_members:
+	xnfree(ws);
+
+	return -ENOMEM;
+}
+
+int cobalt_waitset_add(struct cobalt_waitset_shadow __user *u_wsh,
+		       int type, unsigned long obj, unsigned long mask)
+{
+	struct cobalt_waitset *ws = NULL;
+	struct cobalt_waitset_member *m;
+	struct cobalt_event *event;
+	struct cobalt_sem *sem;
+	struct fds *fds;
+	int ret, index;
+	spl_t s;
+
+	__xn_get_user(ws, &u_wsh->waitset);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!cobalt_obj_active(ws, COBALT_WAITSET_MAGIC,
+			       struct cobalt_waitset)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* Reserve a slot, we may not hold the lock while binding. */
+	if (ws->free >= 0) {
+		index = ws->free;
+		ws->free = ws->members[index].next;
+	} else if (ws->nr < ws->nmax)
+		index = ws->nr++;
+	else {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	m = ws->members + index;
+	m->state = WAITSET_MEMBER_BUSY;
+	m->type = type;
+	m->obj = NULL;
+	m->mask = mask;
+	ws->refs++;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	switch (type) {
+	case COBALT_WAITSET_SEM:
+		ret = cobalt_sem_select_bind((struct __shadow_sem __user *)obj,
+					     ws->selector, index, &sem);
+		if (ret == 0)
+			obj = (unsigned long)sem;
+		break;
+	case COBALT_WAITSET_EVENT:
+		if (mask == 0) {
+			ret = -EINVAL;
+			break;
+		}
+		ret = cobalt_event_select_bind((struct cobalt_event_shadow __user *)obj,
+					       ws->selector, index, &event);
+		if (ret == 0)
+			obj = (unsigned long)event;
+		break;
+	case COBALT_WAITSET_FDREAD:
+	case COBALT_WAITSET_FDWRITE:
+		ret = cobalt_select_bind(ws->selector, member_select_type(type),
+					 (int)obj, index);
+		break;
+	default:
+		ret = -EINVAL;
+	}
+
+	xnlock_get_irqsave(&nklock, s);
+
+	/* Our reference kept the waitset memory valid meanwhile. */
+	if (ws->magic != COBALT_WAITSET_MAGIC) {
+		/* The binding goes away with the selector. */
+		waitset_put(ws, s);
+		ret = -EIDRM;
+		goto out;
+	}
+
+	ws->refs--;
+
+	if (ret) {
+		waitset_free_slot(ws, index);
+		goto out;
+	}
+
+	/*
+	 * The object may have been deleted since we bound it, a
+	 * waiter would have skipped the deletion meanwhile.
+	 */
+	fds = &ws->selector->fds[member_select_type(type)];
+	if (!__FD_ISSET__(index, &fds->expected)) {
+		__FD_CLR__(index, &fds->pending);
+		waitset_free_slot(ws, index);
+		ret = -EIDRM;
+		goto out;
+	}
+
+	m->state = WAITSET_MEMBER_LIVE;
+	m->obj = (void *)obj;
+	ret = index;
+
+	/*
+	 * A waiter may have skipped this member while we were
+	 * binding it, kick it if the initial state is ready.
+	 */
+	if (__FD_ISSET__(index, &fds->pending) &&
+	    xnsynch_flush(&ws->selector->synchbase, 0) == XNSYNCH_RESCHED)
+		xnsched_run();
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
+int cobalt_waitset_remove(struct cobalt_waitset_shadow __user *u_wsh,
+			  int index)
+{
+	struct xnselect_binding *binding, *victim = NULL;
+	struct cobalt_waitset *ws = NULL;
+	struct cobalt_waitset_member *m;
+	struct xnselector *selector;
+	int ret = 0;
+	spl_t s;
+
+	__xn_get_user(ws, &u_wsh->waitset);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!cobalt_obj_active(ws, COBALT_WAITSET_MAGIC,
+			       struct cobalt_waitset)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (index < 0 || index >= ws->nr) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	m = ws->members + index;
+	if (m->state != WAITSET_MEMBER_LIVE) {
+		ret = m->state == WAITSET_MEMBER_BUSY ? -EBUSY : -EINVAL;
+		goto out;
+	}
+
+	/*
+	 * Unbind the member, unless its object was deleted, in which
+	 * case xnselect_destroy() dropped the binding already.
+	 */
+	selector = ws->selector;
+	list_for_each_entry(binding, &selector->bindings, slink) {
+		if (binding->bit_index == index) {
+			victim = binding;
+			break;
+		}
+	}
+
+	if (victim) {
+		list_del(&victim->link);
+		list_del(&victim->rlink);
+		list_del(&victim->slink);
+		__FD_CLR__(index, &selector->fds[victim->type].expected);
+	}
+
+	__FD_CLR__(index, &selector->fds[member_select_type(m->type)].pending);
+	waitset_free_slot(ws, index);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (victim)
+		xnfree(victim);
+
+	return ret;
+}
+
+int cobalt_waitset_modify(struct cobalt_waitset_shadow __user *u_wsh,
+			  int index, unsigned long mask)
+{
+	struct cobalt_waitset *ws = NULL;
+	struct cobalt_waitset_member *m;
+	struct cobalt_event *event;
+	struct fds *fds;
+	int ret = 0;
+	spl_t s;
+
+	__xn_get_user(ws, &u_wsh->waitset);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!cobalt_obj_active(ws, COBALT_WAITSET_MAGIC,
+			       struct cobalt_waitset)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (index < 0 || index >= ws->nr) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	m = ws->members + index;
+	if (m->state != WAITSET_MEMBER_LIVE) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/*
+	 * The object may have been deleted without any wait
+	 * collecting it yet, in which case m->obj is stale. Its
+	 * binding is gone then, which clears the expected bit.
+	 */
+	fds = &ws->selector->fds[member_select_type(m->type)];
+	if (m->obj == NULL || !__FD_ISSET__(index, &fds->expected)) {
+		ret = -EIDRM;
+		goto out;
+	}
+
+	/* Only event members have a tunable interest so far. */
+	if (m->type != COBALT_WAITSET_EVENT || mask == 0) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	m->mask = mask;
+
+	/*
+	 * Our pending state may have been dropped while the former
+	 * mask did not match, raise it again if the event is
+	 * non-empty. Other selectors get the same state, which is
+	 * accurate for them too.
+	 */
+	event = m->obj;
+	if (xnselect_signal(&event->select_block, event->data->value != 0))
+		xnsched_run();
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
+int cobalt_waitset_wait(struct cobalt_waitset_shadow __user *u_wsh,
+			int __user *u_ready, int nready,
+			struct timespec __user *u_ts)
+{
+	int ready[WAITSET_MAXREADY];
+	xnticks_t timeout = XN_INFINITE;
+	xntmode_t tmode = XN_RELATIVE;
+	struct cobalt_waitset *ws = NULL;
+	struct timespec ts;
+	int ret = 0, info;
+	spl_t s;
+
+	if (nready <= 0)
+		return -EINVAL;
+
+	if (nready > WAITSET_MAXREADY)
+		nready = WAITSET_MAXREADY;
+
+	__xn_get_user(ws, &u_wsh->waitset);
+
+	if (u_ts) {
+		if (__xn_safe_copy_from_user(&ts, u_ts, sizeof(ts)))
+			return -EFAULT;
+		timeout = ts2ns(&ts);
+		if (timeout) {
+			timeout++;
+			tmode = XN_ABSOLUTE;
+		} else
+			timeout = XN_NONBLOCK;
+	}
+
+	xnlock_get_irqsave(&nklock, s);
+
+	for (;;) {
+		if (!cobalt_obj_active(ws, COBALT_WAITSET_MAGIC,
+				       struct cobalt_waitset)) {
+			ret = -EINVAL;
+			break;
+		}
+
+		ret = waitset_collect(ws, ready, nready);
+		if (ret)
+			break;
+
+		if (timeout == XN_NONBLOCK) {
+			ret = -EWOULDBLOCK;
+			break;
+		}
+
+		info = xnsynch_sleep_on(&ws->selector->synchbase,
+					timeout, tmode);
+		if (info & XNRMID) {
+			ret = -EIDRM;
+			break;
+		}
+		if (info & (XNBREAK|XNTIMEO)) {
+			ret = (info & XNBREAK) ? -EINTR : -ETIMEDOUT;
+			break;
+		}
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (ret > 0 &&
+	    __xn_safe_copy_to_user(u_ready, ready, ret * sizeof(ready[0])))
+		return -EFAULT;
+
+	return ret;
+}
+
+static void cobalt_waitset_destroy_inner(struct cobalt_waitset *ws,
+					 spl_t s)
+{
+	list_del(&ws->link);
+	ws->magic = 0;
+	if (xnsynch_flush(&ws->selector->synchbase, XNRMID) == XNSYNCH_RESCHED)
+		xnsched_run();
+
+	/* Otherwise, the last adder in flight will release it. */
+	if (ws->refs == 0)
+		waitset_release(ws, s);
+}
+
+int cobalt_waitset_destroy(struct cobalt_waitset_shadow __user *u_wsh)
+{
+	struct cobalt_waitset *ws = NULL;
+	int ret = 0;
+	spl_t s;
+
+	__xn_get_user(ws, &u_wsh->waitset);
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!cobalt_obj_active(ws, COBALT_WAITSET_MAGIC,
+			       struct cobalt_waitset)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	cobalt_waitset_destroy_inner(ws, s);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
+void cobalt_waitsetq_cleanup(struct cobalt_kqueues *q)
+{
+	struct cobalt_waitset *ws, *tmp;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (list_empty(&q->waitsetq))
+		goto out;
+
+	list_for_each_entry_safe(ws, tmp, &q->waitsetq, link)
+		cobalt_waitset_destroy_inner(ws, s);
+out:
+	xnlock_put_irqrestore(&nklock, s);
+}
+
+void cobalt_waitset_pkg_init(void)
+{
+	INIT_LIST_HEAD(&cobalt_global_kqueues.waitsetq);
+}
+
+void cobalt_waitset_pkg_cleanup(void)
+{
+	cobalt_waitsetq_cleanup(&cobalt_global_kqueues);
+}
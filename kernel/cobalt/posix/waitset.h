@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _COBALT_POSIX_WAITSET_H
+#define _COBALT_POSIX_WAITSET_H
+
+#include <cobalt/kernel/select.h>
+#include <cobalt/uapi/waitset.h>
+
+struct cobalt_kqueues;
+
+struct cobalt_waitset_member {
+	int state;
+	int type;
+	void *obj;
+	unsigned long mask;
+	int next;		/* Next free slot. */
+};
+
+struct cobalt_waitset {
+	unsigned int magic;
+	struct xnselector *selector;
+	struct cobalt_kqueues *owningq;
+	struct list_head link;
+	int nr;
+	int nmax;
+	int free;
+	int refs;
+	unsigned int deletions;
+	struct cobalt_waitset_member *members;
+};
+
+int cobalt_waitset_init(struct cobalt_waitset_shadow __user *u_wsh,
+			int nmax);
+
+int cobalt_waitset_add(struct cobalt_waitset_shadow __user *u_wsh,
+		       int type, unsigned long obj, unsigned long mask);
+
+int cobalt_waitset_remove(struct cobalt_waitset_shadow __user *u_wsh,
+			  int index);
+
+int cobalt_waitset_modify(struct cobalt_waitset_shadow __user *u_wsh,
+			  int index, unsigned long mask);
+
+int cobalt_waitset_wait(struct cobalt_waitset_shadow __user *u_wsh,
+			int __user *u_ready, int nready,
+			struct timespec __user *u_ts);
+
+int cobalt_waitset_destroy(struct cobalt_waitset_shadow __user *u_wsh);
+
+void cobalt_waitsetq_cleanup(struct cobalt_kqueues *q);
+
+void cobalt_waitset_pkg_init(void);
+
+void cobalt_waitset_pkg_cleanup(void);
+
+#endif /* !_COBALT_POSIX_WAITSET_H */
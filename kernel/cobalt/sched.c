@@ -1224,6 +1224,132 @@ static struct xnvfile_snapshot_ops vfile_schedacct_ops = {
 
 #endif /* CONFIG_XENO_OPT_STATS */
 
+/*
+ * The relax vfile reports the histogram of relax causes for each
+ * thread which ever switched to secondary mode, followed by its most
+ * recent relax events, oldest first. Each event line gives the time
+ * elapsed since the switch, its cause and the user-space address the
+ * thread was about to resume at.
+ */
+static const char *relax_reasons[XNTHREAD_RELAX_REASONS] = {
+	[SIGDEBUG_UNDEFINED] = "other",
+	[SIGDEBUG_MIGRATE_SIGNAL] = "signal",
+	[SIGDEBUG_MIGRATE_SYSCALL] = "syscall",
+	[SIGDEBUG_MIGRATE_FAULT] = "fault",
+	[SIGDEBUG_MIGRATE_PRIOINV] = "prioinv",
+	[SIGDEBUG_NOMLOCK] = "nomlock",
+	[SIGDEBUG_WATCHDOG] = "watchdog",
+	[SIGDEBUG_RESCNT_IMBALANCE] = "rescnt",
+};
+
+struct vfile_relax_priv {
+	struct xnthread *curr;
+	xnticks_t start_time;
+};
+
+struct vfile_relax_data {
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+	unsigned long count;
+	unsigned long hits[XNTHREAD_RELAX_REASONS];
+	int nrevents;
+	struct xnthread_relax_event events[XNTHREAD_RELAX_RING];
+	xnticks_t start_time;
+};
+
+static struct xnvfile_snapshot_ops vfile_relax_ops;
+
+static struct xnvfile_snapshot relax_vfile = {
+	.privsz = sizeof(struct vfile_relax_priv),
+	.datasz = sizeof(struct vfile_relax_data),
+	.tag = &nkthreadlist_tag,
+	.ops = &vfile_relax_ops,
+};
+
+static int vfile_relax_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_relax_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->curr = list_first_entry(&nkthreadq, struct xnthread, glink);
+	priv->start_time = xnclock_read_monotonic(&nkclock);
+
+	return nknrthreads;
+}
+
+static int vfile_relax_next(struct xnvfile_snapshot_iterator *it,
+			    void *data)
+{
+	struct vfile_relax_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_relax_data *p = data;
+	struct xnthread *thread;
+	unsigned long count;
+	int n;
+
+	if (priv->curr == NULL)
+		return 0;	/* All done. */
+
+	thread = priv->curr;
+	if (list_is_last(&thread->glink, &nkthreadq))
+		priv->curr = NULL;
+	else
+		priv->curr = list_next_entry(thread, glink);
+
+	count = thread->stat.relax.count;
+	if (count == 0)
+		return VFILE_SEQ_SKIP;
+
+	p->pid = xnthread_host_pid(thread);
+	memcpy(p->name, thread->name, sizeof(p->name));
+	p->count = count;
+	memcpy(p->hits, thread->stat.relax.hits, sizeof(p->hits));
+	p->nrevents = count < XNTHREAD_RELAX_RING ? count : XNTHREAD_RELAX_RING;
+	/* Oldest event first. */
+	for (n = 0, count -= p->nrevents; n < p->nrevents; n++, count++)
+		p->events[n] =
+			thread->stat.relax.ring[count & (XNTHREAD_RELAX_RING - 1)];
+	p->start_time = priv->start_time;
+
+	return 1;
+}
+
+static int vfile_relax_show(struct xnvfile_snapshot_iterator *it,
+			    void *data)
+{
+	struct vfile_relax_data *p = data;
+	struct xnthread_relax_event *e;
+	char tbuf[16];
+	int n;
+
+	if (p == NULL) {
+		xnvfile_printf(it, "%-6s %-10s", "PID", "MSW");
+		for (n = 0; n < XNTHREAD_RELAX_REASONS; n++)
+			xnvfile_printf(it, " %-8s", relax_reasons[n]);
+		xnvfile_printf(it, " %s\n", "NAME");
+		return 0;
+	}
+
+	xnvfile_printf(it, "%-6d %-10lu", p->pid, p->count);
+	for (n = 0; n < XNTHREAD_RELAX_REASONS; n++)
+		xnvfile_printf(it, " %-8lu", p->hits[n]);
+	xnvfile_printf(it, " %s\n", p->name);
+
+	for (n = 0; n < p->nrevents; n++) {
+		e = p->events + n;
+		xntimer_format_time(p->start_time - e->date,
+				    tbuf, sizeof(tbuf));
+		xnvfile_printf(it, "       -%-10s %-8s %#lx\n",
+			       tbuf, relax_reasons[e->reason], e->pc);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops vfile_relax_ops = {
+	.rewind = vfile_relax_rewind,
+	.next = vfile_relax_next,
+	.show = vfile_relax_show,
+};
+
 #ifdef CONFIG_SMP
 
 static int affinity_vfile_show(struct xnvfile_regular_iterator *it,
@@ -1323,6 +1449,10 @@ int xnsched_init_proc(void)
 		return ret;
 #endif /* CONFIG_XENO_OPT_STATS */
 
+	ret = xnvfile_init_snapshot("relax", &relax_vfile, &sched_vfroot);
+	if (ret)
+		return ret;
+
 #ifdef CONFIG_SMP
 	xnvfile_init_regular("affinity", &affinity_vfile, &nkvfroot);
 #endif /* CONFIG_SMP */
@@ -1342,6 +1472,7 @@ void xnsched_cleanup_proc(void)
 #ifdef CONFIG_SMP
 	xnvfile_destroy_regular(&affinity_vfile);
 #endif /* CONFIG_SMP */
+	xnvfile_destroy_snapshot(&relax_vfile);
 #ifdef CONFIG_XENO_OPT_STATS
 	xnvfile_destroy_snapshot(&schedacct_vfile);
 	xnvfile_destroy_snapshot(&schedstat_vfile);
@@ -43,6 +43,11 @@
  * - a @a struct @a xnselector structure, the selection structure,  passed by
  * the thread calling the xnselect service, where this service does all its
  * housekeeping.
+ *
+ * In addition, every binding which has a pending state is queued to
+ * the ready list of its selector. Persistent selectors may walk this
+ * list to find the ready descriptors in O(ready) time, instead of
+ * scanning the bit fields.
  *@{*/
 
 #include <linux/types.h>
@@ -130,10 +135,13 @@ int xnselect_bind(struct xnselect *select_block,
 	__FD_SET__(index, &selector->fds[type].expected);
 	if (state) {
 		__FD_SET__(index, &selector->fds[type].pending);
+		list_add_tail(&binding->rlink, &selector->ready);
 		if (xnselect_wakeup(selector))
 			xnsched_run();
-	} else
+	} else {
 		__FD_CLR__(index, &selector->fds[type].pending);
+		INIT_LIST_HEAD(&binding->rlink);
+	}
 
 	return 0;
 }
@@ -149,6 +157,8 @@ int __xnselect_signal(struct xnselect *select_block, unsigned state)
 	list_for_each_entry(binding, &select_block->bindings, link) {
 		selector = binding->selector;
 		if (state) {
+			if (list_empty(&binding->rlink))
+				list_add_tail(&binding->rlink, &selector->ready);
 			if (!__FD_ISSET__(binding->bit_index,
 					&selector->fds[binding->type].pending)) {
 				__FD_SET__(binding->bit_index,
@@ -157,8 +167,7 @@ int __xnselect_signal(struct xnselect *select_block, unsigned state)
 					resched = 1;
 			}
 		} else
-			__FD_CLR__(binding->bit_index,
-				 &selector->fds[binding->type].pending);
+			__xnselect_clear(binding);
 	}
 
 	return resched;
@@ -189,7 +198,9 @@ void xnselect_destroy(struct xnselect *select_block)
 
 	list_for_each_entry_safe(binding, tmp, &select_block->bindings, link) {
 		list_del(&binding->link);
+		list_del(&binding->rlink);
 		selector = binding->selector;
+		selector->deletions++;
 		__FD_CLR__(binding->bit_index,
 			 &selector->fds[binding->type].expected);
 		if (!__FD_ISSET__(binding->bit_index,
@@ -293,6 +304,8 @@ int xnselector_init(struct xnselector *selector)
 		__FD_ZERO__(&selector->fds[i].pending);
 	}
 	INIT_LIST_HEAD(&selector->bindings);
+	INIT_LIST_HEAD(&selector->ready);
+	selector->deletions = 0;
 
 	return 0;
 }
@@ -432,6 +445,7 @@ static void xnselector_destroy_loop(void *cookie)
 			list_del(&binding->slink);
 			fd = binding->fd;
 			list_del(&binding->link);
+			list_del(&binding->rlink);
 			xnlock_put_irqrestore(&nklock, s);
 			xnfree(binding);
 			xnlock_get_irqsave(&nklock, s);
@@ -136,13 +136,173 @@ static int process_hash_enter(struct xnshadow_process *p)
 	return err;
 }
 
+#ifdef CONFIG_XENO_OPT_VFILE
+static struct xnvfile_rev_tag syscall_vfile_tag;
+#endif
+
+#ifdef CONFIG_XENO_OPT_STATS
+
+/*
+ * Per-process syscall accounting. Counters are collected for the
+ * services invoked by Xenomai threads, on a per-personality basis.
+ * Every CPU updates a private copy of the counters with hw IRQs off,
+ * which the vfile folds. nr_syscall_slots tracks the number of
+ * counter slots attached to all processes, which bounds the size of
+ * a vfile snapshot.
+ */
+static int nr_syscall_slots;
+
+static struct xnsyscall_stat *syscall_stats_alloc(int muxid)
+{
+	struct xnpersonality *personality = personalities[muxid];
+
+	return kzalloc(sizeof(struct xnsyscall_stat) *
+		       personality->nrcalls * nr_cpu_ids, GFP_KERNEL);
+}
+
+#if BITS_PER_LONG < 64
+
+/*
+ * The time sums can't be read atomically, readers retry until they
+ * get a copy no update overlapped with.
+ */
+static inline void syscall_stat_write_begin(struct xnsyscall_stat *stat)
+{
+	stat->seq++;
+	smp_wmb();
+}
+
+static inline void syscall_stat_write_end(struct xnsyscall_stat *stat)
+{
+	smp_wmb();
+	stat->seq++;
+}
+
+static inline void syscall_stat_read(struct xnsyscall_stat *stat,
+				     struct xnsyscall_stat *copy)
+{
+	unsigned int seq;
+
+	for (;;) {
+		seq = ACCESS_ONCE(stat->seq);
+		smp_rmb();
+		*copy = *stat;
+		smp_rmb();
+		if ((seq & 1) == 0 && seq == ACCESS_ONCE(stat->seq))
+			break;
+		cpu_relax();
+	}
+}
+
+#else /* BITS_PER_LONG >= 64 */
+
+static inline void syscall_stat_write_begin(struct xnsyscall_stat *stat) { }
+
+static inline void syscall_stat_write_end(struct xnsyscall_stat *stat) { }
+
+static inline void syscall_stat_read(struct xnsyscall_stat *stat,
+				     struct xnsyscall_stat *copy)
+{
+	*copy = *stat;
+}
+
+#endif /* BITS_PER_LONG >= 64 */
+
+/* nklock locked, irqs off. */
+static void syscall_stats_attach(struct xnshadow_process *p, int muxid,
+				 struct xnsyscall_stat *stats)
+{
+	if (stats == NULL)
+		return;	/* Not lethal, we just won't account. */
+
+	p->syscall_stats[muxid] = stats;
+	nr_syscall_slots += personalities[muxid]->nrcalls;
+	xnvfile_touch_tag(&syscall_vfile_tag);
+}
+
+/* nklock locked, irqs off. */
+static struct xnsyscall_stat *
+syscall_stats_detach(struct xnshadow_process *p, int muxid)
+{
+	struct xnsyscall_stat *stats = p->syscall_stats[muxid];
+
+	if (stats) {
+		p->syscall_stats[muxid] = NULL;
+		nr_syscall_slots -= personalities[muxid]->nrcalls;
+		xnvfile_touch_tag(&syscall_vfile_tag);
+	}
+
+	return stats;
+}
+
+static inline xnticks_t syscall_account_start(void)
+{
+	return xnstat_exectime_now();
+}
+
+static inline void syscall_account(int muxid, int muxop,
+				   int mode, xnticks_t start)
+{
+	struct xnshadow_process *p = xnshadow_current_process();
+	xnticks_t now = xnstat_exectime_now();
+	struct xnsyscall_stat *stats;
+	spl_t s;
+
+	if (p == NULL)
+		return;
+
+	stats = p->syscall_stats[muxid];
+	if (stats == NULL)
+		return;
+
+	/*
+	 * Primary and secondary mode callers may update the same
+	 * entries on a CPU, keep the head domain out meanwhile.
+	 */
+	splhigh(s);
+	stats += ipipe_processor_id() * personalities[muxid]->nrcalls + muxop;
+	syscall_stat_write_begin(stats);
+	stats->calls[mode]++;
+	stats->exectime[mode] += now - start;
+	syscall_stat_write_end(stats);
+	splexit(s);
+}
+
+#else /* !CONFIG_XENO_OPT_STATS */
+
+static inline struct xnsyscall_stat *syscall_stats_alloc(int muxid)
+{
+	return NULL;
+}
+
+static inline void syscall_stats_attach(struct xnshadow_process *p, int muxid,
+					struct xnsyscall_stat *stats) { }
+
+static inline struct xnsyscall_stat *
+syscall_stats_detach(struct xnshadow_process *p, int muxid)
+{
+	return NULL;
+}
+
+static inline xnticks_t syscall_account_start(void)
+{
+	return 0;
+}
+
+static inline void syscall_account(int muxid, int muxop,
+				   int mode, xnticks_t start) { }
+
+#endif /* !CONFIG_XENO_OPT_STATS */
+
 static void process_hash_remove(struct xnshadow_process *p)
 {
 	spl_t s;
 
 	xnlock_get_irqsave(&nklock, s);
-	if (p->mm)
+	if (p->mm) {
 		hlist_del(&p->hlink);
+		xnvfile_touch_tag(&syscall_vfile_tag);
+	}
 	xnlock_put_irqrestore(&nklock, s);
 }
 
@@ -161,6 +321,7 @@ static void *private_lookup(unsigned int muxid)
 
 static inline void process_remove(struct xnshadow_process *p)
 {
+	struct xnsyscall_stat *stats;
 	unsigned muxid;
 	spl_t s;
 
@@ -185,6 +346,12 @@ static inline void process_remove(struct xnshadow_process *p)
 		
 		xnlock_get_irqsave(&nklock, s);
 		p->priv[muxid] = NULL;
+		stats = syscall_stats_detach(p, muxid);
+		if (stats) {
+			xnlock_put_irqrestore(&nklock, s);
+			kfree(stats);
+			xnlock_get_irqsave(&nklock, s);
+		}
 	}
 	xnlock_put_irqrestore(&nklock, s);
 
@@ -521,6 +688,28 @@ int xnshadow_harden(void)
 }
 EXPORT_SYMBOL_GPL(xnshadow_harden);
 
+/*
+ * Keep track of the last relax events of each thread, regardless of
+ * whether SIGDEBUG notifications were requested, and of the
+ * statistics support. This only costs a few stores per relax. nklock
+ * held, irqs off.
+ */
+static inline void record_relax(struct xnthread *thread, int reason)
+{
+	struct xnthread_relax_event *e;
+
+	if (reason < 0 || reason >= XNTHREAD_RELAX_REASONS)
+		reason = SIGDEBUG_UNDEFINED;
+
+	thread->stat.relax.hits[reason]++;
+	e = thread->stat.relax.ring +
+		(thread->stat.relax.count++ & (XNTHREAD_RELAX_RING - 1));
+	e->date = xnclock_read_monotonic(&nkclock);
+	e->pc = xnthread_test_state(thread, XNUSER) ?
+		instruction_pointer(task_pt_regs(current)) : 0;
+	e->reason = reason;
+}
+
 /**
  * @internal
  * @fn void xnshadow_relax(int notify, int reason);
@@ -538,6 +727,8 @@ EXPORT_SYMBOL_GPL(xnshadow_harden);
  * trigger such signal.
  *
  * @param reason The reason to report along with the SIGDEBUG signal.
+ * The switch is also logged to the relax event ring of the thread,
+ * which /proc/xenomai/sched/relax exposes.
  *
  * @remark Tags: primary-only, might-switch.
  *
@@ -579,6 +770,7 @@ void xnshadow_relax(int notify, int reason)
 	 * dropped by xnthread_suspend().
 	 */
 	xnlock_get(&nklock);
+	record_relax(thread, reason);
 	set_task_state(p, p->state & ~TASK_NOWAKEUP);
 	xnthread_run_handler(thread, relax_thread);
 	xnthread_suspend(thread, XNRELAX, XN_INFINITE, XN_RELATIVE, NULL);
@@ -915,6 +1107,13 @@ int xnshadow_map_user(struct xnthread *thread,
 		leave_personality(personality);
 		return -ENOMEM;
 	}
+	/*
+	 * Shadows track the resources they hold into their user
+	 * window from now on, so that userland may grab mutexes
+	 * without a syscall. See xnthread_rescnt_ref().
+	 */
+	u_window->hrescnt = xnthread_get_rescnt(thread);
+	u_window->pagefaults = 0;
 	thread->u_window = u_window;
 	__xn_put_user(xnheap_mapped_offset(sem_heap, u_window), u_window_offset);
 	pin_to_initial_cpu(thread);
@@ -1300,6 +1499,7 @@ static int xnshadow_sys_bind(unsigned int magic,
 	struct xnpersonality *personality;
 	struct xnshadow_process *process;
 	unsigned long featreq, featmis;
+	struct xnsyscall_stat *stats;
 	int muxid, abirev, ret;
 	struct xnbindreq breq;
 	struct xnfeatinfo *f;
@@ -1399,6 +1599,8 @@ muxid_eventcb:
 	if (priv == NULL)
 		return muxid;
 
+	stats = syscall_stats_alloc(muxid);
+
 	xnlock_get_irqsave(&nklock, s);
 	if (process->priv[muxid]) {
 		/*
@@ -1408,8 +1610,10 @@ muxid_eventcb:
 		 */
 		xnlock_put_irqrestore(&nklock, s);
 		personality->ops.detach_process(priv);
+		kfree(stats);
 	} else {
 		process->priv[muxid] = priv;
+		syscall_stats_attach(process, muxid, stats);
 		xnlock_put_irqrestore(&nklock, s);
 	}
 
@@ -1628,10 +1832,16 @@ static void user_process_detach(void *arg)
 {
 	struct xnshadow_process *process = arg;
 	struct xnsys_ppd *p = &process->sys_ppd;
+	struct xnsyscall_stat *stats;
+	spl_t s;
 
 	if (p->exe_path)
 		kfree(p->exe_path);
 	process_hash_remove(process);
+	xnlock_get_irqsave(&nklock, s);
+	stats = syscall_stats_detach(process, user_muxid);
+	xnlock_put_irqrestore(&nklock, s);
+	kfree(stats);
 	xnheap_destroy_mapped(&p->sem_heap, post_ppd_release, NULL);
 	atomic_dec(&personalities[user_muxid]->refcnt);
 }
@@ -1639,9 +1849,11 @@ static void user_process_detach(void *arg)
 static void *user_process_attach(void)
 {
 	struct xnshadow_process *process;
+	struct xnsyscall_stat *stats;
 	struct xnsys_ppd *p;
 	char *exe_path;
 	int ret;
+	spl_t s;
 
 	process = kzalloc(sizeof(*process), GFP_KERNEL);
 	if (process == NULL)
@@ -1681,11 +1893,19 @@ static void *user_process_attach(void)
 	atomic_set(&p->refcnt, 1);
 	atomic_inc(&personalities[user_muxid]->refcnt);
 
+#ifdef CONFIG_XENO_OPT_STATS
+	process->pid = current->tgid;
+#endif
 	if (process_hash_enter(process) == -EBUSY) {
 		user_process_detach(process);
 		return ERR_PTR(-EBUSY);
 	}
 
+	stats = syscall_stats_alloc(user_muxid);
+	xnlock_get_irqsave(&nklock, s);
+	syscall_stats_attach(process, user_muxid, stats);
+	xnlock_put_irqrestore(&nklock, s);
+
 	return process;
 }
 
@@ -1905,11 +2125,12 @@ EXPORT_SYMBOL_GPL(xnshadow_pop_personality);
 
 static int handle_head_syscall(struct ipipe_domain *ipd, struct pt_regs *regs)
 {
-	int muxid, muxop, switched, ret, sigs;
+	int muxid, muxop, switched, ret, sigs, mode;
 	struct xnpersonality *personality;
 	struct xnthread *thread;
 	unsigned long sysflags;
 	struct xnsyscall *sc;
+	xnticks_t start;
 
 	thread = xnshadow_current();
 	if (thread)
@@ -2014,7 +2235,10 @@ restart:
 		 */
 	}
 
+	mode = xnsched_root_p();
+	start = syscall_account_start();
 	ret = sc->svc(__xn_reg_arglist(regs));
+	syscall_account(muxid, muxop, mode, start);
 	if (ret == -ENOSYS && (sysflags & __xn_exec_adaptive) != 0) {
 		if (switched) {
 			switched = 0;
@@ -2092,9 +2316,10 @@ bad_syscall:
 
 static int handle_root_syscall(struct ipipe_domain *ipd, struct pt_regs *regs)
 {
-	int muxid, muxop, sysflags, switched, ret, sigs;
+	int muxid, muxop, sysflags, switched, ret, sigs, mode;
 	struct xnthread *thread;
 	struct xnsyscall *sc;
+	xnticks_t start;
 
 	/*
 	 * Catch cancellation requests pending for user shadows
@@ -2155,7 +2380,10 @@ restart:
 		 */
 		switched = 0;
 
+	mode = xnsched_root_p();
+	start = syscall_account_start();
 	ret = sc->svc(__xn_reg_arglist(regs));
+	syscall_account(muxid, muxop, mode, start);
 	if (ret == -ENOSYS && (sysflags & __xn_exec_adaptive) != 0) {
 		if (switched) {
 			switched = 0;
@@ -2584,13 +2812,17 @@ static inline int handle_exception(struct ipipe_trap_data *d)
 		       xnthread_host_pid(thread));
 #endif /* XENO_DEBUG(NUCLEUS) */
 
-	if (xnarch_fault_pf_p(d))
+	if (xnarch_fault_pf_p(d)) {
 		/*
 		 * The page fault counter is not SMP-safe, but it's a
 		 * simple indicator that something went wrong wrt
 		 * memory locking anyway.
 		 */
 		xnstat_counter_inc(&thread->stat.pf);
+		/* Only the faulting thread updates its own window. */
+		if (thread->u_window)
+			thread->u_window->pagefaults++;
+	}
 
 	xnshadow_relax(xnarch_fault_notify(d), SIGDEBUG_MIGRATE_FAULT);
 
@@ -2633,6 +2865,153 @@ void xnshadow_release_events(void)
 	ipipe_set_hooks(ipipe_root_domain, 0);
 }
 
+#if defined(CONFIG_XENO_OPT_STATS) && defined(CONFIG_XENO_OPT_VFILE)
+
+/*
+ * The syscall accounting vfile is parser-friendly: each line reports
+ * the counters of a service a process used at least once, i.e. pid,
+ * personality, service number and name, followed by the call count
+ * and cumulated time (ns) in primary mode, then in secondary mode.
+ */
+static struct xnvfile_snapshot_ops syscall_vfile_ops;
+
+struct syscall_vfile_priv {
+	int bucket;
+	struct xnshadow_process *curr;
+	int muxid;
+	int muxop;
+};
+
+struct syscall_vfile_data {
+	pid_t pid;
+	const char *personality;
+	const char *name;
+	int muxop;
+	unsigned long calls[2];
+	xnticks_t exectime[2];
+};
+
+static struct xnvfile_snapshot syscall_vfile = {
+	.privsz = sizeof(struct syscall_vfile_priv),
+	.datasz = sizeof(struct syscall_vfile_data),
+	.tag = &syscall_vfile_tag,
+	.ops = &syscall_vfile_ops,
+};
+
+static int syscall_vfile_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct syscall_vfile_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->bucket = 0;
+	priv->curr = NULL;
+	priv->muxid = 0;
+	priv->muxop = 0;
+
+	return nr_syscall_slots;
+}
+
+/* Sum up the per-CPU counters of a service. */
+static void syscall_vfile_fold(struct syscall_vfile_data *p,
+			       struct xnsyscall_stat *stats, int nrcalls)
+{
+	struct xnsyscall_stat copy;
+	int cpu;
+
+	memset(p->calls, 0, sizeof(p->calls));
+	memset(p->exectime, 0, sizeof(p->exectime));
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++, stats += nrcalls) {
+		syscall_stat_read(stats, &copy);
+		p->calls[0] += copy.calls[0];
+		p->calls[1] += copy.calls[1];
+		p->exectime[0] += copy.exectime[0];
+		p->exectime[1] += copy.exectime[1];
+	}
+}
+
+static int syscall_vfile_next(struct xnvfile_snapshot_iterator *it,
+			      void *data)
+{
+	struct syscall_vfile_priv *priv = xnvfile_iterator_priv(it);
+	struct syscall_vfile_data *p = data;
+	struct xnpersonality *personality;
+	struct xnsyscall_stat *stats;
+	struct hlist_node *next;
+	int muxop;
+
+	for (;;) {
+		if (priv->curr == NULL) {
+			if (priv->bucket >= PROCESS_HASH_SIZE)
+				return 0; /* We are done. */
+			next = process_hash[priv->bucket++].first;
+		} else {
+			stats = priv->curr->syscall_stats[priv->muxid];
+			personality = personalities[priv->muxid];
+			if (stats && priv->muxop < personality->nrcalls) {
+				muxop = priv->muxop++;
+				syscall_vfile_fold(p, stats + muxop,
+						   personality->nrcalls);
+				if (p->calls[0] + p->calls[1] == 0)
+					continue;
+				p->pid = priv->curr->pid;
+				p->personality = personality->name;
+				p->name = personality->syscalls[muxop].name ?: "?";
+				p->muxop = muxop;
+				return 1;
+			}
+			priv->muxop = 0;
+			if (++priv->muxid < NR_PERSONALITIES)
+				continue;
+			next = priv->curr->hlink.next;
+		}
+		priv->curr = next ?
+			hlist_entry(next, struct xnshadow_process, hlink) : NULL;
+		priv->muxid = 0;
+	}
+}
+
+static int syscall_vfile_show(struct xnvfile_snapshot_iterator *it,
+			      void *data)
+{
+	struct syscall_vfile_data *p = data;
+
+	if (p == NULL)
+		return 0;
+
+	xnvfile_printf(it, "%d %s %d %s %lu %Lu %lu %Lu\n",
+		       p->pid, p->personality, p->muxop, p->name,
+		       p->calls[0],
+		       xnclock_ticks_to_ns(&nkclock, p->exectime[0]),
+		       p->calls[1],
+		       xnclock_ticks_to_ns(&nkclock, p->exectime[1]));
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops syscall_vfile_ops = {
+	.rewind = syscall_vfile_rewind,
+	.next = syscall_vfile_next,
+	.show = syscall_vfile_show,
+};
+
+static inline void syscall_init_vfile(void)
+{
+	xnvfile_init_snapshot("syscalls", &syscall_vfile, &nkvfroot);
+}
+
+static inline void syscall_cleanup_vfile(void)
+{
+	xnvfile_destroy_snapshot(&syscall_vfile);
+}
+
+#else /* !(CONFIG_XENO_OPT_STATS && CONFIG_XENO_OPT_VFILE) */
+
+static inline void syscall_init_vfile(void) { }
+
+static inline void syscall_cleanup_vfile(void) { }
+
+#endif /* !(CONFIG_XENO_OPT_STATS && CONFIG_XENO_OPT_VFILE) */
+
 int xnshadow_mount(void)
 {
 	unsigned int i, size;
@@ -2668,12 +3047,15 @@ int xnshadow_mount(void)
 	user_muxid = xnshadow_register_personality(&user_personality);
 	XENO_BUGON(NUCLEUS, user_muxid != 0);
 
+	syscall_init_vfile();
+
 	return 0;
 }
 
 void xnshadow_cleanup(void)
 {
 	if (user_muxid >= 0) {
+		syscall_cleanup_vfile();
 		xnshadow_unregister_personality(user_muxid);
 		user_muxid = -1;
 	}
@@ -41,11 +41,31 @@
 
 void a4l_free_buffer(a4l_buf_t * buf_desc)
 {
+	unsigned long i, nr_pages = buf_desc->size >> PAGE_SHIFT;
+
+	if (buf_desc->chk_list != NULL) {
+		vfree(buf_desc->chk_list);
+		buf_desc->chk_list = NULL;
+		buf_desc->chk_count = 0;
+	}
+
 	if (buf_desc->pg_list != NULL) {
-		rtdm_free(buf_desc->pg_list);
+		vfree(buf_desc->pg_list);
 		buf_desc->pg_list = NULL;
 	}
 
+	if (buf_desc->pages != NULL) {
+		if (buf_desc->buf != NULL)
+			vunmap(buf_desc->buf);
+		for (i = 0; i < nr_pages && buf_desc->pages[i]; i++) {
+			ClearPageReserved(buf_desc->pages[i]);
+			__free_page(buf_desc->pages[i]);
+		}
+		vfree(buf_desc->pages);
+		buf_desc->pages = NULL;
+		buf_desc->buf = NULL;
+	}
+
 	if (buf_desc->buf != NULL) {
 		char *vaddr, *vabase = buf_desc->buf;
 		for (vaddr = vabase; vaddr < vabase + buf_desc->size;
@@ -56,6 +76,86 @@ void a4l_free_buffer(a4l_buf_t * buf_desc)
 	}
 }
 
+/* Build the buffer out of blocks as large as the page allocator can
+   provide; each block is split so that its pages can be mapped and
+   released one by one, then the whole set is made virtually
+   contiguous with vmap(). */
+static int a4l_alloc_contig(a4l_buf_t *buf_desc)
+{
+	unsigned long i = 0, j, nr_pages = buf_desc->size >> PAGE_SHIFT;
+	int order = MAX_ORDER - 1;
+	struct page *page;
+
+	buf_desc->pages = vmalloc(nr_pages * sizeof(struct page *));
+	if (buf_desc->pages == NULL)
+		return -ENOMEM;
+
+	memset(buf_desc->pages, 0, nr_pages * sizeof(struct page *));
+
+	while (i < nr_pages) {
+
+		while ((1UL << order) > nr_pages - i)
+			order--;
+
+		page = alloc_pages(GFP_KERNEL | GFP_DMA32 |
+				   __GFP_NOWARN | __GFP_NORETRY, order);
+		if (page == NULL) {
+			if (order == 0)
+				return -ENOMEM;
+			order--;
+			continue;
+		}
+
+		if (order > 0)
+			split_page(page, order);
+
+		for (j = 0; j < (1UL << order); j++) {
+			SetPageReserved(page + j);
+			buf_desc->pages[i++] = page + j;
+		}
+	}
+
+	buf_desc->buf = vmap(buf_desc->pages, nr_pages, VM_MAP, PAGE_KERNEL);
+	if (buf_desc->buf == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/* Merge the physically adjacent pages into chunks */
+static int a4l_build_chunks(a4l_buf_t *buf_desc)
+{
+	unsigned long i, nr_pages = buf_desc->size >> PAGE_SHIFT;
+	unsigned int count = 1;
+	a4l_bufchk_t *chk;
+
+	for (i = 1; i < nr_pages; i++)
+		if (buf_desc->pg_list[i] != buf_desc->pg_list[i - 1] + PAGE_SIZE)
+			count++;
+
+	buf_desc->chk_list = vmalloc(count * sizeof(a4l_bufchk_t));
+	if (buf_desc->chk_list == NULL)
+		return -ENOMEM;
+
+	chk = buf_desc->chk_list;
+	chk->addr = buf_desc->pg_list[0];
+	chk->size = PAGE_SIZE;
+
+	for (i = 1; i < nr_pages; i++) {
+		if (buf_desc->pg_list[i] == chk->addr + chk->size)
+			chk->size += PAGE_SIZE;
+		else {
+			chk++;
+			chk->addr = buf_desc->pg_list[i];
+			chk->size = PAGE_SIZE;
+		}
+	}
+
+	buf_desc->chk_count = count;
+
+	return 0;
+}
+
 int a4l_alloc_buffer(a4l_buf_t *buf_desc, int buf_size)
 {
 	int ret = 0;
@@ -64,20 +164,33 @@ int a4l_alloc_buffer(a4l_buf_t *buf_desc, int buf_size)
 	buf_desc->size = buf_size;
 	buf_desc->size = PAGE_ALIGN(buf_desc->size);
 
-	buf_desc->buf = vmalloc_32(buf_desc->size);
-	if (buf_desc->buf == NULL) {
-		ret = -ENOMEM;
-		goto out_virt_contig_alloc;
+	if (buf_desc->cfg_flags & A4L_BUFCFG_CONTIG) {
+		ret = a4l_alloc_contig(buf_desc);
+		if (ret != 0)
+			goto out_virt_contig_alloc;
+	} else {
+		buf_desc->buf = vmalloc_32(buf_desc->size);
+		if (buf_desc->buf == NULL) {
+			ret = -ENOMEM;
+			goto out_virt_contig_alloc;
+		}
+
+		vabase = buf_desc->buf;
+
+		for (vaddr = vabase; vaddr < vabase + buf_desc->size;
+		     vaddr += PAGE_SIZE)
+			SetPageReserved(vmalloc_to_page(vaddr));
 	}
 
 	vabase = buf_desc->buf;
 
-	for (vaddr = vabase; vaddr < vabase + buf_desc->size;
-	     vaddr += PAGE_SIZE)
-		SetPageReserved(vmalloc_to_page(vaddr));
-
-	buf_desc->pg_list = rtdm_malloc(((buf_desc->size) >> PAGE_SHIFT) *
-					sizeof(unsigned long));
+	/*
+	 * The page and chunk lists are only used from NRT context,
+	 * and may be way too large for the real-time system heap
+	 * with big buffers.
+	 */
+	buf_desc->pg_list = vmalloc(((buf_desc->size) >> PAGE_SHIFT) *
+				    sizeof(unsigned long));
 	if (buf_desc->pg_list == NULL) {
 		ret = -ENOMEM;
 		goto out_virt_contig_alloc;
@@ -88,6 +201,8 @@ int a4l_alloc_buffer(a4l_buf_t *buf_desc, int buf_size)
 		buf_desc->pg_list[(vaddr - vabase) >> PAGE_SHIFT] =
 			(unsigned long) page_to_phys(vmalloc_to_page(vaddr));
 
+	ret = a4l_build_chunks(buf_desc);
+
 out_virt_contig_alloc:
 	if (ret != 0)
 		a4l_free_buffer(buf_desc);
@@ -95,6 +210,82 @@ out_virt_contig_alloc:
 	return ret;
 }
 
+/* --- Status page functions --- */
+
+/* When the status page is mapped, the consumer of an input
+   subdevice advances its count in user space; this count is pulled
+   back before the kernel relies on buf->cns_count. Only forward
+   moves within the produced data are accepted. */
+static void a4l_pull_status(a4l_buf_t *buf)
+{
+	a4l_bufstat_t *st = buf->status;
+	unsigned long count;
+
+	if (st == NULL || buf->subd == NULL || !a4l_subd_is_input(buf->subd))
+		return;
+
+	count = ACCESS_ONCE(st->cns_count);
+	if ((long)(count - buf->cns_count) > 0 &&
+	    (long)(buf->prd_count - count) >= 0)
+		buf->cns_count = count;
+}
+
+/* Munge the input data up to @count, unless it has been done
+   already. */
+static void a4l_munge_upto(a4l_subd_t *subd,
+			   a4l_buf_t *buf, unsigned long count)
+{
+	if (subd->munge == NULL || (long)(count - buf->mng_count) <= 0)
+		return;
+
+	__munge(subd, subd->munge, buf, count - buf->mng_count);
+	buf->mng_count = count;
+}
+
+/* Publish the producer side state to the status page. The data
+   have to be munged before a user space consumer may see them. */
+static void a4l_push_status(a4l_buf_t *buf)
+{
+	a4l_bufstat_t *st = buf->status;
+	a4l_subd_t *subd = buf->subd;
+	unsigned long events = A4L_BUFSTAT_ACTIVE;
+
+	if (st == NULL || subd == NULL || !a4l_subd_is_input(subd))
+		return;
+
+	a4l_munge_upto(subd, buf, buf->cns_count + __count_to_get(buf));
+
+	if (test_bit(A4L_BUF_EOA_NR, &buf->flags))
+		events |= A4L_BUFSTAT_EOA;
+	if (test_bit(A4L_BUF_ERROR_NR, &buf->flags))
+		events |= A4L_BUFSTAT_ERROR;
+
+	st->end_count = buf->end_count;
+	st->wake_count = buf->wake_count;
+	st->events = events;
+	/* Data and flags must be visible before the new count */
+	smp_wmb();
+	st->prd_count = buf->prd_count;
+}
+
+/* Amount of data a poller should wait for: with a status page, the
+   consumer only enters the kernel when the data it could see in
+   user space were not enough, so it is put to sleep until the
+   wake-up threshold is reached, like a futex. */
+static unsigned long a4l_poll_threshold(a4l_buf_t *buf)
+{
+	unsigned long wake;
+
+	if (buf->status == NULL || buf->wake_count == 0)
+		return 1;
+
+	wake = __count_to_end(buf);
+	if (wake > buf->wake_count)
+		wake = buf->wake_count;
+
+	return wake ?: 1;
+}
+
 static void a4l_reinit_buffer(a4l_buf_t *buf_desc)
 {
 	/* No command to process yet */
@@ -113,6 +304,12 @@ static void a4l_reinit_buffer(a4l_buf_t *buf_desc)
 	/* Flush pending events */
 	buf_desc->flags = 0;
 	a4l_flush_sync(&buf_desc->sync);
+
+	if (buf_desc->status) {
+		memset(buf_desc->status, 0, sizeof(a4l_bufstat_t));
+		buf_desc->status->size = buf_desc->size;
+		buf_desc->status->wake_count = buf_desc->wake_count;
+	}
 }
 
 void a4l_init_buffer(a4l_buf_t *buf_desc)
@@ -125,6 +322,12 @@ void a4l_init_buffer(a4l_buf_t *buf_desc)
 void a4l_cleanup_buffer(a4l_buf_t *buf_desc)
 {
 	a4l_cleanup_sync(&buf_desc->sync);
+
+	if (buf_desc->status) {
+		ClearPageReserved(vmalloc_to_page(buf_desc->status));
+		vfree(buf_desc->status);
+		buf_desc->status = NULL;
+	}
 }
 
 int a4l_setup_buffer(a4l_cxt_t *cxt, a4l_cmd_t *cmd)
@@ -170,6 +373,8 @@ int a4l_setup_buffer(a4l_cxt_t *cxt, a4l_cmd_t *cmd)
 	__a4l_dbg(1, core_dbg,
 		  "a4l_setup_buffer: end_count=%lu\n", buf_desc->end_count);
 
+	a4l_push_status(buf_desc);
+
 	return 0;
 }
 
@@ -266,6 +471,8 @@ int a4l_buf_prepare_absput(a4l_subd_t *subd, unsigned long count)
 	if (!a4l_subd_is_input(subd))
 		return -EINVAL;
 
+	a4l_pull_status(buf);
+
 	return __pre_abs_put(buf, count);
 }
 
@@ -293,6 +500,8 @@ int a4l_buf_prepare_put(a4l_subd_t *subd, unsigned long count)
 	if (!a4l_subd_is_input(subd))
 		return -EINVAL;
 
+	a4l_pull_status(buf);
+
 	return __pre_put(buf, count);
 }
 
@@ -320,6 +529,8 @@ int a4l_buf_put(a4l_subd_t *subd, void *bufdata, unsigned long count)
 	if (!a4l_subd_is_input(subd))
 		return -EINVAL;
 
+	a4l_pull_status(buf);
+
 	if (__count_to_put(buf) < count)
 		return -EAGAIN;
 
@@ -429,6 +640,8 @@ int a4l_buf_evt(a4l_subd_t *subd, unsigned long evts)
 	if (!buf || !test_bit(A4L_SUBD_BUSY_NR, &subd->status))
 		return -ENOENT;
 
+	a4l_pull_status(buf);
+
 	/* Here we save the data count available for the user side */
 	if (evts == 0) {
 		count = a4l_subd_is_input(subd) ?
@@ -445,6 +658,8 @@ int a4l_buf_evt(a4l_subd_t *subd, unsigned long evts)
 		}
 	}
 
+	a4l_push_status(buf);
+
 	if (count >= wake)
 		/* Notify the user-space side */
 		a4l_signal_sync(&buf->sync);
@@ -461,6 +676,8 @@ unsigned long a4l_buf_count(a4l_subd_t *subd)
 	if (!buf || !test_bit(A4L_SUBD_BUSY_NR, &subd->status))
 		return -ENOENT;
 
+	a4l_pull_status(buf);
+
 	if (a4l_subd_is_input(subd))
 		ret = __count_to_put(buf);
 	else if (a4l_subd_is_output(subd))
@@ -542,6 +759,64 @@ int a4l_ioctl_mmap(a4l_cxt_t *cxt, void *arg)
 				      arg, &map_cfg, sizeof(a4l_mmap_t));
 }
 
+/* The ioctl MMAPSTAT maps the buffer status page (counters and
+   events) into the caller's address space. Combined with the buffer
+   mapping, a consumer can then follow the acquisition without any
+   syscall until it has to block. */
+
+int a4l_ioctl_mmapstat(a4l_cxt_t *cxt, void *arg)
+{
+	a4l_dev_t *dev = a4l_get_dev(cxt);
+	a4l_buf_t *buf = cxt->buffer;
+	a4l_mmap_t map_cfg;
+	a4l_bufstat_t *st;
+	int ret;
+
+	if (rtdm_in_rt_context())
+		return -ENOSYS;
+
+	if (!test_bit(A4L_DEV_ATTACHED_NR, &dev->flags)) {
+		__a4l_err("a4l_ioctl_mmapstat: cannot mmap on "
+			  "an unattached device\n");
+		return -EINVAL;
+	}
+
+	if (rtdm_safe_copy_from_user(cxt->user_info,
+				     &map_cfg, arg, sizeof(a4l_mmap_t)) != 0)
+		return -EFAULT;
+
+	if (buf->status == NULL) {
+		st = vmalloc_32(PAGE_SIZE);
+		if (st == NULL)
+			return -ENOMEM;
+		memset(st, 0, PAGE_SIZE);
+		SetPageReserved(vmalloc_to_page(st));
+		st->size = buf->size;
+		st->wake_count = buf->wake_count;
+		buf->status = st;
+		/* Catch up with an acquisition already in progress */
+		if (buf->subd) {
+			st->cns_count = buf->cns_count;
+			a4l_push_status(buf);
+		}
+	}
+
+	ret = rtdm_mmap_to_user(cxt->user_info,
+				buf->status, PAGE_SIZE,
+				PROT_READ | PROT_WRITE,
+				&map_cfg.ptr, NULL, NULL);
+	if (ret < 0) {
+		__a4l_err("a4l_ioctl_mmapstat: internal error, "
+			  "rtdm_mmap_to_user failed (err=%d)\n", ret);
+		return ret;
+	}
+
+	map_cfg.size = PAGE_SIZE;
+
+	return rtdm_safe_copy_to_user(cxt->user_info,
+				      arg, &map_cfg, sizeof(a4l_mmap_t));
+}
+
 /* --- IOCTL / FOPS functions --- */
 
 int a4l_ioctl_cancel(a4l_cxt_t * cxt, void *arg)
@@ -590,6 +865,7 @@ int a4l_ioctl_bufcfg(a4l_cxt_t * cxt, void *arg)
 	a4l_buf_t *buf = cxt->buffer;
 	a4l_subd_t *subd = buf->subd;
 	a4l_bufcfg_t buf_cfg;
+	int ret;
 
 	/* As Linux API is used to allocate a virtual buffer,
 	   the calling process must not be in primary mode */
@@ -608,8 +884,12 @@ int a4l_ioctl_bufcfg(a4l_cxt_t * cxt, void *arg)
 				     arg, sizeof(a4l_bufcfg_t)) != 0)
 		return -EFAULT;
 
-	if (buf_cfg.buf_size > A4L_BUF_MAXSIZE) {
-		__a4l_err("a4l_ioctl_bufcfg: buffer size too big (<=16MB)\n");
+	if (buf_cfg.buf_size > A4L_BUF_CONTIG_MAXSIZE ||
+	    (buf_cfg.buf_size > A4L_BUF_MAXSIZE &&
+	     (buf_cfg.idx_subd == A4L_BUF_DEFMAGIC ||
+	      !(buf->cfg_flags & A4L_BUFCFG_CONTIG)))) {
+		__a4l_err("a4l_ioctl_bufcfg: buffer size too big (<=16MB, "
+			  "<=1GB with A4L_BUFCFG_CONTIG)\n");
 		return -EINVAL;
 	}
 
@@ -633,11 +913,17 @@ int a4l_ioctl_bufcfg(a4l_cxt_t * cxt, void *arg)
 	a4l_free_buffer(buf);
 
 	/* ...to reallocate it */
-	return a4l_alloc_buffer(buf, buf_cfg.buf_size);
+	ret = a4l_alloc_buffer(buf, buf_cfg.buf_size);
+
+	if (buf->status)
+		buf->status->size = buf->size;
+
+	return ret;
 }
 
 /* The ioctl BUFCFG2 allows the user space process to define the
-   minimal amount of data which should trigger a wake-up. If the ABI
+   minimal amount of data which should trigger a wake-up and the
+   allocation flags of the next buffer configured with BUFCFG. If the ABI
    could be broken, this facility would be handled by the original
    BUFCFG ioctl. At the next major release, this ioctl will vanish. */
 
@@ -665,7 +951,17 @@ int a4l_ioctl_bufcfg2(a4l_cxt_t * cxt, void *arg)
 		return -EINVAL;
 	}
 
+	if (buf_cfg.flags & ~A4L_BUFCFG_CONTIG) {
+		__a4l_err("a4l_ioctl_bufcfg2: invalid flags (%lx)\n",
+			  buf_cfg.flags);
+		return -EINVAL;
+	}
+
 	buf->wake_count = buf_cfg.wake_count;
+	buf->cfg_flags = buf_cfg.flags;
+
+	if (buf->status)
+		buf->status->wake_count = buf->wake_count;
 
 	return 0;
 }
@@ -705,13 +1001,18 @@ int a4l_ioctl_bufinfo(a4l_cxt_t * cxt, void *arg)
 		goto a4l_ioctl_bufinfo_out;
 	}
 
+	a4l_pull_status(buf);
+
 	ret = __handle_event(buf);
 
 	if (a4l_subd_is_input(subd)) {
 
 		/* Updates consume count if rw_count is not null */
-		if (info.rw_count != 0)
+		if (info.rw_count != 0) {
 			buf->cns_count += info.rw_count;
+			if (buf->status)
+				buf->status->cns_count = buf->cns_count;
+		}
 
 		/* Retrieves the data amount to read */
 		tmp_cnt = info.rw_count = __count_to_get(buf);
@@ -757,7 +1058,9 @@ int a4l_ioctl_bufinfo(a4l_cxt_t * cxt, void *arg)
 	}
 
 	/* Performs the munge if need be */
-	if (subd->munge != NULL) {
+	if (a4l_subd_is_input(subd))
+		a4l_munge_upto(subd, buf, buf->cns_count + tmp_cnt);
+	else if (subd->munge != NULL) {
 
 		/* Call the munge callback */
 		__munge(subd, subd->munge, buf, tmp_cnt);
@@ -796,7 +1099,10 @@ int a4l_ioctl_bufinfo2(a4l_cxt_t * cxt, void *arg)
 		return -EINVAL;
 	}
 
+	memset(&buf_cfg, 0, sizeof(a4l_bufcfg2_t));
 	buf_cfg.wake_count = buf->wake_count;
+	buf_cfg.flags = buf->cfg_flags;
+	buf_cfg.chunks = buf->chk_count;
 
 	if (rtdm_safe_copy_to_user(cxt->user_info,
 				   arg, &buf_cfg, sizeof(a4l_bufcfg2_t)) != 0)
@@ -839,7 +1145,10 @@ ssize_t a4l_read_buffer(a4l_cxt_t * cxt, void *bufdata, size_t nbytes)
 		int ret = __handle_event(buf);
 
 		/* Compute the data amount to copy */
-		unsigned long tmp_cnt = __count_to_get(buf);
+		unsigned long tmp_cnt;
+
+		a4l_pull_status(buf);
+		tmp_cnt = __count_to_get(buf);
 
 		/* Check tmp_cnt count is not higher than
 		   the global count to read */
@@ -863,12 +1172,7 @@ ssize_t a4l_read_buffer(a4l_cxt_t * cxt, void *bufdata, size_t nbytes)
 		if (tmp_cnt > 0) {
 
 			/* Performs the munge if need be */
-			if (subd->munge != NULL) {
-				__munge(subd, subd->munge, buf, tmp_cnt);
-
-				/* Updates munge count */
-				buf->mng_count += tmp_cnt;
-			}
+			a4l_munge_upto(subd, buf, buf->cns_count + tmp_cnt);
 
 			/* Performs the copy */
 			ret = __consume(cxt, buf, bufdata + count, tmp_cnt);
@@ -880,6 +1184,8 @@ ssize_t a4l_read_buffer(a4l_cxt_t * cxt, void *bufdata, size_t nbytes)
 
 			/* Updates consume count */
 			buf->cns_count += tmp_cnt;
+			if (buf->status)
+				buf->status->cns_count = buf->cns_count;
 
 			/* Updates the return value */
 			count += tmp_cnt;
@@ -1074,6 +1380,7 @@ int a4l_ioctl_poll(a4l_cxt_t * cxt, void *arg)
 
 	/* Checks the buffer events */
 	a4l_flush_sync(&buf->sync);
+	a4l_pull_status(buf);
 	ret = __handle_event(buf);
 
 	/* Retrieves the data amount to compute
@@ -1104,7 +1411,9 @@ int a4l_ioctl_poll(a4l_cxt_t * cxt, void *arg)
 		tmp_cnt = __count_to_put(buf);
 	}
 
-	if (poll.arg == A4L_NONBLOCK || tmp_cnt != 0)
+	if (poll.arg == A4L_NONBLOCK ||
+	    (tmp_cnt != 0 && (!a4l_subd_is_input(subd) ||
+			      tmp_cnt >= a4l_poll_threshold(buf))))
 		goto out_poll;
 
 	if (poll.arg == A4L_INFINITE)
@@ -383,11 +383,17 @@ void a4l_mite_dma_disarm(struct mite_channel *mite_chan)
 	writel(chor, mite->mite_io_addr + MITE_CHOR(mite_chan->channel));
 }
 
+/* Physically contiguous chunks of the buffer are described by a
+   single link, up to MITE_MAX_LINK_SIZE bytes; longer links would
+   only delay the link completion events */
+#define MITE_MAX_LINK_SIZE (256 * 1024)
+
 int a4l_mite_buf_change(struct mite_dma_descriptor_ring *ring, a4l_subd_t *subd)
 {
 	a4l_buf_t *buf = subd->buf;
+	unsigned long addr, size, len;
 	unsigned int n_links;
-	int i;
+	int i, j;
 
 	if (ring->descriptors) {
 		pci_free_consistent(ring->pcidev,
@@ -401,7 +407,10 @@ int a4l_mite_buf_change(struct mite_dma_descriptor_ring *ring, a4l_subd_t *subd)
 	if (buf->size == 0) {
 		return 0;
 	}
-	n_links = buf->size >> PAGE_SHIFT;
+
+	for (i = 0, n_links = 0; i < buf->chk_count; i++)
+		n_links += DIV_ROUND_UP(buf->chk_list[i].size,
+					MITE_MAX_LINK_SIZE);
 
 	MDPRINTK("ring->pcidev=%p, n_links=0x%04x\n", ring->pcidev, n_links);
 
@@ -415,12 +424,21 @@ int a4l_mite_buf_change(struct mite_dma_descriptor_ring *ring, a4l_subd_t *subd)
 	}
 	ring->n_links = n_links;
 
-	for (i = 0; i < n_links; i++) {
-		ring->descriptors[i].count = cpu_to_le32(PAGE_SIZE);
-		ring->descriptors[i].addr = cpu_to_le32(buf->pg_list[i]);
-		ring->descriptors[i].next =
-			cpu_to_le32(ring->descriptors_dma_addr +
-				    (i + 1) * sizeof(struct mite_dma_descriptor));
+	for (i = 0, j = 0; i < buf->chk_count; i++) {
+		addr = buf->chk_list[i].addr;
+		size = buf->chk_list[i].size;
+		while (size > 0) {
+			len = min(size, (unsigned long)MITE_MAX_LINK_SIZE);
+			ring->descriptors[j].count = cpu_to_le32(len);
+			ring->descriptors[j].addr = cpu_to_le32(addr);
+			ring->descriptors[j].next =
+				cpu_to_le32(ring->descriptors_dma_addr +
+					    (j + 1) *
+					    sizeof(struct mite_dma_descriptor));
+			addr += len;
+			size -= len;
+			j++;
+		}
 	}
 
 	ring->descriptors[n_links - 1].next =
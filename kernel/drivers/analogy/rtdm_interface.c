@@ -52,7 +52,8 @@ int (*a4l_ioctl_functions[NB_IOCTL_FUNCTIONS]) (a4l_cxt_t *, void *) = {
 	a4l_ioctl_nbchaninfo,
 	a4l_ioctl_nbrnginfo,
 	a4l_ioctl_bufcfg2,
-	a4l_ioctl_bufinfo2
+	a4l_ioctl_bufinfo2,
+	a4l_ioctl_mmapstat
 };
 
 #ifdef CONFIG_PROC_FS
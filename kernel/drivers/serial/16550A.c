@@ -19,6 +19,7 @@
 #include <linux/version.h>
 #include <linux/module.h>
 #include <linux/ioport.h>
+#include <linux/log2.h>
 #include <asm/io.h>
 
 #include <rtdm/serial.h>
@@ -28,8 +29,10 @@
 
 #define MAX_DEVICES		8
 
-#define IN_BUFFER_SIZE		4096
-#define OUT_BUFFER_SIZE		4096
+#define IN_BUFFER_SIZE		4096	/* default RX ring size */
+#define OUT_BUFFER_SIZE		4096	/* default TX ring size */
+#define MIN_BUFFER_SIZE		64
+#define MAX_BUFFER_SIZE		(1 << 20)
 
 #define DEFAULT_BAUD_BASE	115200
 #define DEFAULT_TX_FIFO		16
@@ -38,6 +41,7 @@
 #define DATA_BITS_MASK		0x03
 #define STOP_BITS_MASK		0x01
 #define FIFO_MASK		0xC0
+#define FIFO_SHIFT		6
 #define EVENT_MASK		0x0F
 
 #define LCR_DLAB		0x80
@@ -57,6 +61,7 @@
 #define IIR_RX			0x04
 #define IIR_STAT		0x06
 #define IIR_MASK		0x07
+#define IIR_RX_TIMEOUT		0x08	/* RX IRQ raised by char timeout */
 
 #define RHR			0	/* Receive Holding Buffer */
 #define THR			0	/* Transmit Holding Buffer */
@@ -87,7 +92,8 @@ struct rt_16550_context {
 	size_t in_npend;		/* pending bytes in RX ring */
 	int in_nwait;			/* bytes the user waits for */
 	rtdm_event_t in_event;		/* raised to unblock reader */
-	char in_buf[IN_BUFFER_SIZE];	/* RX ring buffer */
+	char *in_buf;			/* RX ring buffer */
+	size_t in_size;			/* RX ring size, power of 2 */
 	volatile unsigned long in_lock;	/* single-reader lock */
 	uint64_t *in_history;		/* RX timestamp buffer */
 
@@ -95,7 +101,8 @@ struct rt_16550_context {
 	int out_tail;			/* TX ring buffer, tail pointer */
 	size_t out_npend;		/* pending bytes in TX ring */
 	rtdm_event_t out_event;		/* raised to unblock writer */
-	char out_buf[OUT_BUFFER_SIZE];	/* TX ring buffer */
+	char *out_buf;			/* TX ring buffer */
+	size_t out_size;		/* TX ring size, power of 2 */
 	rtdm_mutex_t out_lock;		/* single-writer mutex */
 
 	uint64_t last_timestamp;	/* timestamp of last event */
@@ -107,8 +114,17 @@ struct rt_16550_context {
 	int mcr_status;			/* MCR cache */
 	int status;			/* cache for LSR + soft-states */
 	int saved_errors;		/* error cache for RTIOC_GET_STATUS */
+
+	int rx_trigger;			/* current RX FIFO trigger (FCR bits) */
+	unsigned long char_time;	/* nanosecs per character on the line */
+	unsigned long rx_gap;		/* smoothed inter-byte gap (ns) */
+	uint64_t rx_last;		/* timestamp of last RX interrupt */
+	struct rtser_stats stats;	/* per-port statistics */
 };
 
+/* Number of bytes the RX FIFO holds when the trigger level fires. */
+static const int rx_trigger_bytes[] = { 1, 4, 8, 14 };
+
 static const struct rtser_config default_config = {
 	0xFFFF, RTSER_DEF_BAUD, RTSER_DEF_PARITY, RTSER_DEF_BITS,
 	RTSER_DEF_STOPB, RTSER_DEF_HAND, RTSER_DEF_FIFO_DEPTH, 0,
@@ -124,16 +140,24 @@ static unsigned long irqtype[MAX_DEVICES] = {
 };
 static unsigned int baud_base[MAX_DEVICES];
 static int tx_fifo[MAX_DEVICES];
+static unsigned int rx_bufsz[MAX_DEVICES];
+static unsigned int tx_bufsz[MAX_DEVICES];
 static unsigned int start_index;
 
 module_param_array(irq, uint, NULL, 0400);
 module_param_array(baud_base, uint, NULL, 0400);
 module_param_array(tx_fifo, int, NULL, 0400);
+module_param_array(rx_bufsz, uint, NULL, 0644);
+module_param_array(tx_bufsz, uint, NULL, 0644);
 
 MODULE_PARM_DESC(irq, "IRQ numbers of the serial devices");
 MODULE_PARM_DESC(baud_base, "Maximum baud rate of the serial device "
 		 "(internal clock rate / 16)");
 MODULE_PARM_DESC(tx_fifo, "Transmitter FIFO size");
+MODULE_PARM_DESC(rx_bufsz, "Receive ring buffer size (power of 2, "
+		 "applied on next open)");
+MODULE_PARM_DESC(tx_bufsz, "Transmit ring buffer size (power of 2, "
+		 "applied on next open)");
 
 module_param(start_index, uint, 0400);
 MODULE_PARM_DESC(start_index, "First device instance number to be used");
@@ -145,35 +169,62 @@ MODULE_AUTHOR("jan.kiszka@web.de");
 #include "16550A_pnp.h"
 #include "16550A_pci.h"
 
+#define RX_LSR_MASK	(RTSER_LSR_DATA | RTSER_LSR_OVERRUN_ERR |	\
+			 RTSER_LSR_PARITY_ERR | RTSER_LSR_FRAMING_ERR |	\
+			 RTSER_LSR_BREAK_IND)
+
+static inline int rt_16550_rx_put(struct rt_16550_context *ctx, int c,
+				  uint64_t *timestamp)
+{
+	ctx->in_buf[ctx->in_tail] = c;
+	if (ctx->in_history)
+		ctx->in_history[ctx->in_tail] = *timestamp;
+	ctx->in_tail = (ctx->in_tail + 1) & (ctx->in_size - 1);
+
+	if (++ctx->in_npend > ctx->in_size) {
+		ctx->in_npend--;
+		ctx->stats.rx_overruns++;
+		return RTSER_SOFT_OVERRUN_ERR;
+	}
+
+	return 0;
+}
+
 static inline int rt_16550_rx_interrupt(struct rt_16550_context *ctx,
-					uint64_t * timestamp)
+					uint64_t * timestamp, int burst)
 {
 	unsigned long base = ctx->base_addr;
 	int mode = rt_16550_io_mode_from_ctx(ctx);
 	int rbytes = 0;
-	int lsr = 0;
+	int lsr;
 	int c;
 
-	do {
+	lsr = rt_16550_reg_in(mode, base, LSR);
+
+	/*
+	 * The trigger level was reached, so at least @burst
+	 * characters are waiting in the FIFO. Unless one of them
+	 * carries an error, drain them without polling LSR in
+	 * between, this saves one bus access per character.
+	 */
+	if (burst > 1 && (lsr & RTSER_LSR_FIFO_ERR) == 0) {
+		lsr &= RX_LSR_MASK & ~RTSER_LSR_DATA;
+		do {
+			c = rt_16550_reg_in(mode, base, RHR);
+			lsr |= rt_16550_rx_put(ctx, c, timestamp);
+			rbytes++;
+		} while (--burst > 0);
+		lsr |= rt_16550_reg_in(mode, base, LSR) & RX_LSR_MASK;
+	} else
+		lsr &= RX_LSR_MASK;
+
+	while (lsr & RTSER_LSR_DATA) {
 		c = rt_16550_reg_in(mode, base, RHR);	/* read input char */
-
-		ctx->in_buf[ctx->in_tail] = c;
-		if (ctx->in_history)
-			ctx->in_history[ctx->in_tail] = *timestamp;
-		ctx->in_tail = (ctx->in_tail + 1) & (IN_BUFFER_SIZE - 1);
-
-		if (++ctx->in_npend > IN_BUFFER_SIZE) {
-			lsr |= RTSER_SOFT_OVERRUN_ERR;
-			ctx->in_npend--;
-		}
-
+		lsr |= rt_16550_rx_put(ctx, c, timestamp);
 		rbytes++;
 		lsr &= ~RTSER_LSR_DATA;
-		lsr |= (rt_16550_reg_in(mode, base, LSR) &
-			(RTSER_LSR_DATA | RTSER_LSR_OVERRUN_ERR |
-			 RTSER_LSR_PARITY_ERR | RTSER_LSR_FRAMING_ERR |
-			 RTSER_LSR_BREAK_IND));
-	} while (lsr & RTSER_LSR_DATA);
+		lsr |= (rt_16550_reg_in(mode, base, LSR) & RX_LSR_MASK);
+	}
 
 	/* save new errors */
 	ctx->status |= lsr;
@@ -205,7 +256,8 @@ static inline void rt_16550_tx_interrupt(struct rt_16550_context *ctx)
 		     count--, ctx->out_npend--) {
 			c = ctx->out_buf[ctx->out_head++];
 			rt_16550_reg_out(mode, base, THR, c);
-			ctx->out_head &= (OUT_BUFFER_SIZE - 1);
+			ctx->out_head &= (ctx->out_size - 1);
+			ctx->stats.tx_bytes++;
 		}
 	}
 }
@@ -220,6 +272,53 @@ static inline void rt_16550_stat_interrupt(struct rt_16550_context *ctx)
 			 RTSER_LSR_FRAMING_ERR | RTSER_LSR_BREAK_IND));
 }
 
+static inline void rt_16550_set_rx_trigger(struct rt_16550_context *ctx,
+					   int trigger)
+{
+	/* Writing FCR without the reset bits leaves the FIFOs intact. */
+	ctx->rx_trigger = trigger;
+	rt_16550_reg_out(rt_16550_io_mode_from_ctx(ctx), ctx->base_addr,
+			 FCR, FCR_FIFO | trigger);
+	ctx->stats.trigger_changes++;
+}
+
+/*
+ * Adaptive RX trigger policy: a continuous stream (inter-byte gap
+ * close to the character time on the line) moves the trigger up to
+ * cut the interrupt rate, while sparse traffic or a burst ending
+ * below the threshold (i.e. the UART had to raise a character
+ * timeout) moves it down to keep the reception latency low.
+ */
+static inline void rt_16550_adapt_rx_trigger(struct rt_16550_context *ctx,
+					     int rbytes, int timeout,
+					     uint64_t timestamp)
+{
+	int level = ctx->rx_trigger >> FIFO_SHIFT;
+	unsigned long gap;
+	uint64_t delta;
+
+	delta = timestamp - ctx->rx_last;
+	ctx->rx_last = timestamp;
+	if (delta > 1000000000)
+		delta = 1000000000;
+	gap = (unsigned long)delta / rbytes;
+
+	/* Low-pass filter over the last few interrupts (gain 1/4). */
+	ctx->rx_gap = ctx->rx_gap - (ctx->rx_gap >> 2) + (gap >> 2);
+
+	if (ctx->rx_gap > 16 * ctx->char_time)
+		level = 0;
+	else if (timeout) {
+		if (level > 0)
+			level--;
+	} else if (ctx->rx_gap <= 2 * ctx->char_time &&
+		   rbytes >= rx_trigger_bytes[level] && level < 3)
+		level++;
+
+	if ((level << FIFO_SHIFT) != ctx->rx_trigger)
+		rt_16550_set_rx_trigger(ctx, level << FIFO_SHIFT);
+}
+
 static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 {
 	struct rt_16550_context *ctx;
@@ -229,6 +328,7 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 	uint64_t timestamp = rtdm_clock_read();
 	int rbytes = 0;
 	int events = 0;
+	int timeout = 0;
 	int modem;
 	int ret = RTDM_IRQ_NONE;
 
@@ -239,18 +339,26 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 	rtdm_lock_get(&ctx->lock);
 
 	while (1) {
-		iir = rt_16550_reg_in(mode, base, IIR) & IIR_MASK;
+		iir = rt_16550_reg_in(mode, base, IIR);
 		if (iir & IIR_PIRQ)
 			break;
 
-		if (iir == IIR_RX) {
-			rbytes += rt_16550_rx_interrupt(ctx, &timestamp);
+		if ((iir & IIR_MASK) == IIR_RX) {
+			if (iir & IIR_RX_TIMEOUT) {
+				/* FIFO below trigger level, poll LSR. */
+				timeout = 1;
+				rbytes += rt_16550_rx_interrupt(ctx,
+								&timestamp, 0);
+			} else
+				rbytes += rt_16550_rx_interrupt(ctx, &timestamp,
+					rx_trigger_bytes[ctx->rx_trigger >>
+							 FIFO_SHIFT]);
 			events |= RTSER_EVENT_RXPEND;
-		} else if (iir == IIR_STAT)
+		} else if ((iir & IIR_MASK) == IIR_STAT)
 			rt_16550_stat_interrupt(ctx);
-		else if (iir == IIR_TX)
+		else if ((iir & IIR_MASK) == IIR_TX)
 			rt_16550_tx_interrupt(ctx);
-		else if (iir == IIR_MODEM) {
+		else if ((iir & IIR_MASK) == IIR_MODEM) {
 			modem = rt_16550_reg_in(mode, base, MSR);
 			if (modem & (modem << 4))
 				events |= RTSER_EVENT_MODEMHI;
@@ -261,6 +369,17 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 		ret = RTDM_IRQ_HANDLED;
 	}
 
+	if (ret == RTDM_IRQ_HANDLED)
+		ctx->stats.irqs++;
+
+	if (rbytes > 0) {
+		ctx->stats.rx_irqs++;
+		ctx->stats.rx_bytes += rbytes;
+		if (ctx->config.fifo_depth & RTSER_FIFO_DEPTH_ADAPTIVE)
+			rt_16550_adapt_rx_trigger(ctx, rbytes, timeout,
+						  timestamp);
+	}
+
 	if (ctx->in_nwait > 0) {
 		if ((ctx->in_nwait <= rbytes) || ctx->status) {
 			ctx->in_nwait = 0;
@@ -323,6 +442,8 @@ static int rt_16550_set_config(struct rt_16550_context *ctx,
 		rt_16550_reg_out(mode, base, LCR, LCR_DLAB);
 		rt_16550_reg_out(mode, base, DLL, baud_div & 0xff);
 		rt_16550_reg_out(mode, base, DLM, baud_div >> 8);
+		/* start + 8 data + stop bits, good enough for the RX policy */
+		ctx->char_time = (1000000000 / ctx->config.baud_rate) * 10;
 	}
 
 	if (config->config_mask & RTSER_SET_PARITY)
@@ -345,11 +466,14 @@ static int rt_16550_set_config(struct rt_16550_context *ctx,
 	}
 
 	if (config->config_mask & RTSER_SET_FIFO_DEPTH) {
-		ctx->config.fifo_depth = config->fifo_depth & FIFO_MASK;
+		ctx->config.fifo_depth = config->fifo_depth &
+			(FIFO_MASK | RTSER_FIFO_DEPTH_ADAPTIVE);
+		ctx->rx_trigger = ctx->config.fifo_depth & FIFO_MASK;
+		ctx->rx_gap = 0;
 		rt_16550_reg_out(mode, base, FCR,
 				 FCR_FIFO | FCR_RESET_RX | FCR_RESET_TX);
 		rt_16550_reg_out(mode, base, FCR,
-				 FCR_FIFO | ctx->config.fifo_depth);
+				 FCR_FIFO | ctx->rx_trigger);
 	}
 
 	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
@@ -437,6 +561,21 @@ void rt_16550_cleanup_ctx(struct rt_16550_context *ctx)
 	rtdm_event_destroy(&ctx->out_event);
 	rtdm_event_destroy(&ctx->ioc_event);
 	rtdm_mutex_destroy(&ctx->out_lock);
+	kfree(ctx->in_buf);
+	kfree(ctx->out_buf);
+}
+
+static size_t rt_16550_bufsz(unsigned int size, size_t defsz)
+{
+	if (size == 0)
+		return defsz;
+
+	if (size < MIN_BUFFER_SIZE)
+		size = MIN_BUFFER_SIZE;
+	else if (size > MAX_BUFFER_SIZE)
+		size = MAX_BUFFER_SIZE;
+
+	return roundup_pow_of_two(size);
 }
 
 int rt_16550_open(struct rtdm_dev_context *context,
@@ -450,6 +589,17 @@ int rt_16550_open(struct rtdm_dev_context *context,
 
 	ctx = (struct rt_16550_context *)context->dev_private;
 
+	/* Ring sizes may have been changed via sysfs since last open. */
+	ctx->in_size = rt_16550_bufsz(rx_bufsz[dev_id], IN_BUFFER_SIZE);
+	ctx->out_size = rt_16550_bufsz(tx_bufsz[dev_id], OUT_BUFFER_SIZE);
+	ctx->in_buf = kmalloc(ctx->in_size, GFP_KERNEL);
+	ctx->out_buf = kmalloc(ctx->out_size, GFP_KERNEL);
+	if (ctx->in_buf == NULL || ctx->out_buf == NULL) {
+		kfree(ctx->in_buf);
+		kfree(ctx->out_buf);
+		return -ENOMEM;
+	}
+
 	/* IPC initialisation - cannot fail with used parameters */
 	rtdm_lock_init(&ctx->lock);
 	rtdm_event_init(&ctx->in_event, 0);
@@ -477,6 +627,9 @@ int rt_16550_open(struct rtdm_dev_context *context,
 	ctx->status = 0;
 	ctx->saved_errors = 0;
 
+	ctx->rx_last = 0;
+	memset(&ctx->stats, 0, sizeof(ctx->stats));
+
 	rt_16550_set_config(ctx, &default_config, &dummy);
 
 	err = rtdm_irq_request(&ctx->irq_handle, irq[dev_id],
@@ -606,7 +759,7 @@ int rt_16550_ioctl(struct rtdm_dev_context *context,
 
 			if (config->timestamp_history &
 			    RTSER_RX_TIMESTAMP_HISTORY)
-				hist_buf = kmalloc(IN_BUFFER_SIZE *
+				hist_buf = kmalloc(ctx->in_size *
 						   sizeof(nanosecs_abs_t),
 						   GFP_KERNEL);
 		}
@@ -775,12 +928,29 @@ int rt_16550_ioctl(struct rtdm_dev_context *context,
 		if (fcr) {
 			rt_16550_reg_out(mode, base, FCR, fcr);
 			rt_16550_reg_out(mode, base, FCR,
-					 FCR_FIFO | ctx->config.fifo_depth);
+					 FCR_FIFO | ctx->rx_trigger);
 		}
 		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 		break;
 	}
 
+	case RTSER_RTIOC_GET_STATS: {
+		struct rtser_stats stats;
+
+		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+		stats = ctx->stats;
+		stats.fifo_depth = ctx->rx_trigger;
+		stats.rx_gap = ctx->rx_gap;
+		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+		if (user_info)
+			err = rtdm_safe_copy_to_user(user_info, arg, &stats,
+						     sizeof(stats));
+		else
+			memcpy(arg, &stats, sizeof(stats));
+		break;
+	}
+
 	default:
 		err = -ENOTTY;
 	}
@@ -852,10 +1022,10 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 			rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 			/* Do we have to wrap around the buffer end? */
-			if (in_pos + subblock > IN_BUFFER_SIZE) {
+			if (in_pos + subblock > ctx->in_size) {
 				/* Treat the block between head and buffer end
 				   separately. */
-				subblock = IN_BUFFER_SIZE - in_pos;
+				subblock = ctx->in_size - in_pos;
 
 				if (user_info) {
 					if (rtdm_copy_to_user
@@ -893,7 +1063,7 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 			rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 
 			ctx->in_head =
-			    (ctx->in_head + block) & (IN_BUFFER_SIZE - 1);
+			    (ctx->in_head + block) & (ctx->in_size - 1);
 			if ((ctx->in_npend -= block) == 0)
 				ctx->ioc_events &= ~RTSER_EVENT_RXPEND;
 
@@ -986,7 +1156,7 @@ ssize_t rt_16550_write(struct rtdm_dev_context * context,
 	while (nbyte > 0) {
 		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 
-		free = OUT_BUFFER_SIZE - ctx->out_npend;
+		free = ctx->out_size - ctx->out_npend;
 
 		if (free > 0) {
 			block = subblock = (nbyte <= free) ? nbyte : free;
@@ -995,10 +1165,10 @@ ssize_t rt_16550_write(struct rtdm_dev_context * context,
 			rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 			/* Do we have to wrap around the buffer end? */
-			if (out_pos + subblock > OUT_BUFFER_SIZE) {
+			if (out_pos + subblock > ctx->out_size) {
 				/* Treat the block between head and buffer
 				   end separately. */
-				subblock = OUT_BUFFER_SIZE - out_pos;
+				subblock = ctx->out_size - out_pos;
 
 				if (user_info) {
 					if (rtdm_copy_from_user
@@ -1036,7 +1206,7 @@ ssize_t rt_16550_write(struct rtdm_dev_context * context,
 			rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 
 			ctx->out_tail =
-			    (ctx->out_tail + block) & (OUT_BUFFER_SIZE - 1);
+			    (ctx->out_tail + block) & (ctx->out_size - 1);
 			ctx->out_npend += block;
 
 			/* unmask tx interrupt */
@@ -1102,7 +1272,7 @@ static const struct rtdm_device __initdata device_tmpl = {
 	.device_sub_class	= RTDM_SUBCLASS_16550A,
 	.profile_version	= RTSER_PROFILE_VER,
 	.driver_name		= RT_16550_DRIVER_NAME,
-	.driver_version		= RTDM_DRIVER_VER(1, 5, 2),
+	.driver_version		= RTDM_DRIVER_VER(1, 6, 0),
 	.peripheral_name	= "UART 16550A",
 	.provider_name		= "Jan Kiszka",
 };
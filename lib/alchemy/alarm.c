@@ -35,6 +35,7 @@
 #include "reference.h"
 #include "internal.h"
 #include "alarm.h"
+#include "task.h"
 #include "timer.h"
 
 struct pvcluster alchemy_alarm_table;
@@ -75,6 +76,50 @@ static void alarm_handler(struct timerobj *tmobj)
 	acb->handler(acb->arg);
 }
 
+static int create_alarm(RT_ALARM *alarm, const char *name,
+			void (*handler)(void *arg),
+			void *arg, int prio)
+{
+	struct alchemy_alarm *acb;
+	struct service svc;
+	int ret;
+
+	CANCEL_DEFER(svc);
+
+	acb = pvmalloc(sizeof(*acb));
+	if (acb == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = timerobj_init_server(&acb->tmobj, TIMEROBJ_CPU_AUTO, prio);
+	if (ret)
+		goto fail;
+
+	generate_name(acb->name, name, &alarm_namegen);
+	acb->handler = handler;
+	acb->arg = arg;
+	acb->expiries = 0;
+	acb->magic = alarm_magic;
+	alarm->handle = (uintptr_t)acb;
+
+	if (pvcluster_addobj(&alchemy_alarm_table, acb->name, &acb->cobj)) {
+		timerobj_destroy(&acb->tmobj);
+		ret = -EEXIST;
+		goto fail;
+	}
+
+	CANCEL_RESTORE(svc);
+
+	return 0;
+fail:
+	pvfree(acb);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
 /**
  * @fn int rt_alarm_create(RT_ALARM *alarm,const char *name,void (*handler)(void *arg),void *arg)
  * @brief Create an alarm object.
@@ -120,44 +165,50 @@ int rt_alarm_create(RT_ALARM *alarm, const char *name,
 		    void (*handler)(void *arg),
 		    void *arg)
 {
-	struct alchemy_alarm *acb;
-	struct service svc;
-	int ret;
-
-	CANCEL_DEFER(svc);
-
-	acb = pvmalloc(sizeof(*acb));
-	if (acb == NULL) {
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	ret = timerobj_init(&acb->tmobj);
-	if (ret)
-		goto fail;
-
-	generate_name(acb->name, name, &alarm_namegen);
-	acb->handler = handler;
-	acb->arg = arg;
-	acb->expiries = 0;
-	acb->magic = alarm_magic;
-	alarm->handle = (uintptr_t)acb;
-
-	if (pvcluster_addobj(&alchemy_alarm_table, acb->name, &acb->cobj)) {
-		timerobj_destroy(&acb->tmobj);
-		ret = -EEXIST;
-		goto fail;
-	}
-
-	CANCEL_RESTORE(svc);
+	return create_alarm(alarm, name, handler, arg,
+			    TIMEROBJ_PRIO_DEFAULT);
+}
 
-	return 0;
-fail:
-	pvfree(acb);
-out:
-	CANCEL_RESTORE(svc);
+/**
+ * @fn int rt_alarm_create_prio(RT_ALARM *alarm,const char *name,void (*handler)(void *arg),void *arg,int prio)
+ * @brief Create an alarm object served at a given priority.
+ *
+ * This routine works like rt_alarm_create(), except that the alarm
+ * handler runs at priority @a prio, instead of above all Alchemy
+ * tasks. Alarms created with distinct priorities are served by
+ * distinct threads, so that a lengthy handler only delays the
+ * handlers of alarms with the same or lower priority.
+ *
+ * @param alarm The address of an alarm descriptor.
+ *
+ * @param name The symbolic name of the alarm.
+ *
+ * @param handler The address of the alarm routine.
+ *
+ * @param arg A user-defined opaque argument passed to the @a handler.
+ *
+ * @param prio The priority level the @a handler runs at, in the
+ * range [1 .. T_HIPRIO].
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a prio is invalid.
+ *
+ * - any other error code returned by rt_alarm_create().
+ *
+ * Valid calling context:
+ *
+ * - Regular POSIX threads
+ * - Xenomai threads
+ */
+int rt_alarm_create_prio(RT_ALARM *alarm, const char *name,
+			 void (*handler)(void *arg),
+			 void *arg, int prio)
+{
+	if (prio <= T_LOPRIO || prio > T_HIPRIO)
+		return -EINVAL;
 
-	return ret;
+	return create_alarm(alarm, name, handler, arg, prio);
 }
 
 /**
@@ -48,6 +48,59 @@ static DEFINE_NAME_GENERATOR(buffer_namegen, "buffer",
 
 DEFINE_SYNC_LOOKUP(buffer, RT_BUFFER);
 
+static void wakeup_readers(struct alchemy_buffer *bcb)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	/*
+	 * Wake up all threads waiting for input, if we accumulated
+	 * enough data to feed the leading one.
+	 */
+	thobj = syncobj_peek_grant(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size <= bcb->fillsz)
+		syncobj_grant_all(&bcb->sobj);
+}
+
+static void wakeup_writers(struct alchemy_buffer *bcb)
+{
+	struct alchemy_buffer_wait *wait;
+	struct threadobj *thobj;
+
+	/*
+	 * Wake up all threads waiting for the buffer to drain, if we
+	 * freed enough room for the leading one to post its message.
+	 */
+	thobj = syncobj_peek_drain(&bcb->sobj);
+	if (thobj == NULL)
+		return;
+
+	wait = threadobj_get_wait(thobj);
+	if (wait->size + bcb->fillsz <= bcb->bufsz)
+		syncobj_drain(&bcb->sobj);
+}
+
+static void get_span(struct alchemy_buffer *bcb, size_t off, size_t len,
+		     RT_BUFFER_SPAN *span)
+{
+	size_t n = bcb->bufsz - off;
+
+	span->ptr1 = bcb->buf + off;
+	if (len <= n) {
+		span->len1 = len;
+		span->ptr2 = NULL;
+		span->len2 = 0;
+	} else {
+		span->len1 = n;
+		span->ptr2 = bcb->buf;
+		span->len2 = len - n;
+	}
+}
+
 static void buffer_finalize(struct syncobj *sobj)
 {
 	struct alchemy_buffer *bcb;
@@ -65,8 +118,10 @@ fnref_register(libalchemy, buffer_finalize);
  * receive data asynchronously via a memory buffer. Data may be of an
  * arbitrary length, albeit this IPC is best suited for small to
  * medium-sized messages, since data always have to be copied to the
- * buffer during transit. Large messages may be more efficiently
- * handled by message queues (RT_QUEUE).
+ * buffer during transit, unless the in-place interface is used (see
+ * rt_buffer_reserve_timed() and rt_buffer_acquire_timed()). Large
+ * messages may be more efficiently handled by message queues
+ * (RT_QUEUE).
  *
  * @param bf The address of a buffer descriptor which can be later
  * used to identify uniquely the created object, upon success of this
@@ -88,6 +143,10 @@ fnref_register(libalchemy, buffer_finalize);
  * - B_PRIO makes tasks pend in priority order for reading data from
  *   the buffer.
  *
+ * - B_SPIN causes waiters to poll the buffer for a short while before
+ *   going to sleep, like S_SPIN does for semaphores (see
+ *   rt_sem_create()).
+ *
  * This parameter also applies to tasks blocked on the buffer's write
  * side (see rt_buffer_write()).
  *
@@ -145,9 +204,14 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name,
 	bcb->rdoff = 0;
 	bcb->wroff = 0;
 	bcb->fillsz = 0;
+	bcb->wrsvsz = 0;
+	bcb->rdacqsz = 0;
 	if (mode & B_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (mode & B_SPIN)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	syncobj_init(&bcb->sobj, CLOCK_COPPERPLATE, sobj_flags,
 		     fnref_put(libalchemy, buffer_finalize));
 
@@ -342,7 +406,6 @@ ssize_t rt_buffer_read_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
 	size_t len, rbytes, n;
 	struct syncstate syns;
 	struct service svc;
@@ -376,9 +439,11 @@ redo:
 	for (;;) {
 		/*
 		 * We should be able to read a complete message of the
-		 * requested length, or block.
+		 * requested length, or block. We also have to wait
+		 * for any data held by rt_buffer_acquire() to be
+		 * released.
 		 */
-		if (bcb->fillsz < len)
+		if (bcb->rdacqsz || bcb->fillsz < len)
 			goto wait;
 
 		/* Read from the buffer in a circular way. */
@@ -400,20 +465,7 @@ redo:
 		bcb->fillsz -= len;
 		bcb->rdoff = rdoff;
 		ret = (ssize_t)len;
-
-		/*
-		 * Wake up all threads waiting for the buffer to
-		 * drain, if we freed enough room for the leading one
-		 * to post its message.
-		 */
-		thobj = syncobj_peek_drain(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
-
-		wait = threadobj_get_wait(thobj);
-		if (wait->size + bcb->fillsz <= bcb->bufsz)
-			syncobj_drain(&bcb->sobj);
-
+		wakeup_writers(bcb);
 		goto done;
 	wait:
 		if (alchemy_poll_mode(abs_timeout)) {
@@ -426,9 +478,13 @@ redo:
 		 * sending data, while we are about to wait for
 		 * receiving some. In such a case, we have a
 		 * pathological use of the buffer. We must allow for a
-		 * short read to prevent a deadlock.
+		 * short read to prevent a deadlock. This does not
+		 * apply when writers wait for a pending reservation
+		 * to be committed, or we have to wait for acquired
+		 * data to be released.
 		 */
-		if (bcb->fillsz > 0 && syncobj_count_drain(&bcb->sobj)) {
+		if (bcb->fillsz > 0 && bcb->wrsvsz == 0 && bcb->rdacqsz == 0 &&
+		    syncobj_count_drain(&bcb->sobj)) {
 			len = bcb->fillsz;
 			goto redo;
 		}
@@ -556,7 +612,6 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 {
 	struct alchemy_buffer_wait *wait = NULL;
 	struct alchemy_buffer *bcb;
-	struct threadobj *thobj;
 	size_t len, rbytes, n;
 	struct syncstate syns;
 	struct service svc;
@@ -590,9 +645,10 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 	for (;;) {
 		/*
 		 * We should be able to write the entire message at
-		 * once, or block.
+		 * once, or block. Messages may not overtake a pending
+		 * reservation either.
 		 */
-		if (bcb->fillsz + len > bcb->bufsz)
+		if (bcb->wrsvsz || bcb->fillsz + len > bcb->bufsz)
 			goto wait;
 
 		/* Write to the buffer in a circular way. */
@@ -615,19 +671,7 @@ ssize_t rt_buffer_write_timed(RT_BUFFER *bf,
 		bcb->fillsz += len;
 		bcb->wroff = wroff;
 		ret = (ssize_t)len;
-
-		/*
-		 * Wake up all threads waiting for input, if we
-		 * accumulated enough data to feed the leading one.
-		 */
-		thobj = syncobj_peek_grant(&bcb->sobj);
-		if (thobj == NULL)
-			goto done;
-
-		wait = threadobj_get_wait(thobj);
-		if (wait->size <= bcb->fillsz)
-			syncobj_grant_all(&bcb->sobj);
-
+		wakeup_readers(bcb);
 		goto done;
 	wait:
 		if (alchemy_poll_mode(abs_timeout)) {
@@ -676,6 +720,444 @@ out:
 	return ret;
 }
 
+/**
+ * @fn ssize_t rt_buffer_reserve(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, RTIME timeout)
+ * @brief Reserve space in an IPC buffer (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_reserve_timed() accepting a
+ * relative timeout specification expressed as a scalar value.
+ *
+ * @param bf The descriptor address of the buffer to reserve space
+ * from.
+ *
+ * @param size The length in bytes of the space to reserve.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the reserved space.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ */
+
+/**
+ * @fn ssize_t rt_buffer_reserve_until(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, RTIME abs_timeout)
+ * @brief Reserve space in an IPC buffer (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_reserve_timed() accepting an
+ * absolute timeout specification expressed as a scalar value.
+ *
+ * @param bf The descriptor address of the buffer to reserve space
+ * from.
+ *
+ * @param size The length in bytes of the space to reserve.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the reserved space.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ */
+
+/**
+ * @fn ssize_t rt_buffer_reserve_timed(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, const struct timespec *abs_timeout)
+ * @brief Reserve space in an IPC buffer.
+ *
+ * This routine reserves space for a message in the specified buffer,
+ * so that the caller may build the message in place instead of
+ * copying it with rt_buffer_write_timed(). The message becomes
+ * visible to readers when rt_buffer_commit() is called. If not enough
+ * buffer space is available on entry, the caller is allowed to block
+ * until enough room is freed, or a timeout elapses, whichever comes
+ * first.
+ *
+ * A single reservation may be pending on a buffer at any point in
+ * time. Other writers wait until it is committed.
+ *
+ * @param bf The descriptor address of the buffer to reserve space
+ * from.
+ *
+ * @param size The length in bytes of the space to reserve.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the reserved space. The space
+ * is split into two segments when it wraps around the end of the
+ * buffer (see RT_BUFFER_SPAN).
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for enough buffer space to be
+ * available (see note). Passing NULL causes the caller to block
+ * indefinitely until enough buffer space is available. Passing {
+ * .tv_sec = 0, .tv_nsec = 0 } causes the service to return
+ * immediately without blocking in case of buffer space shortage.
+ *
+ * @return The number of bytes reserved is returned upon
+ * success. Otherwise:
+ *
+ * - -ETIMEDOUT is returned if the absolute @a abs_timeout date is
+ * reached before enough buffer space is available.
+ *
+ * - -EWOULDBLOCK is returned if @a abs_timeout is { .tv_sec = 0,
+ * .tv_nsec = 0 } and not enough buffer space is immediately
+ * available on entry.
+ *
+ * - -EINTR is returned if rt_task_unblock() was called for the
+ * current task before enough buffer space became available.
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a size is zero or greater than the actual buffer length.
+ *
+ * - -EIDRM is returned if @a bf is deleted while the caller was
+ * waiting for buffer space. In such event, @a bf is no more valid
+ * upon return of this service.
+ *
+ * - -EPERM is returned if this service should block, but was not
+ * called from a Xenomai thread.
+ *
+ * Valid calling contexts:
+ *
+ * - Xenomai threads
+ * - Any other context if @a abs_timeout is { .tv_sec = 0, .tv_nsec = 0 } .
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_reserve_timed(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer_wait *wait = NULL;
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	if (size == 0)
+		return -EINVAL;
+
+	if (!threadobj_current_p() && !alchemy_poll_mode(abs_timeout))
+		return -EPERM;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (size > bcb->bufsz) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	for (;;) {
+		if (bcb->wrsvsz == 0 && bcb->fillsz + size <= bcb->bufsz) {
+			bcb->wrsvsz = size;
+			get_span(bcb, bcb->wroff, size, span);
+			ret = (ssize_t)size;
+			break;
+		}
+
+		if (alchemy_poll_mode(abs_timeout)) {
+			ret = -EWOULDBLOCK;
+			break;
+		}
+
+		if (wait == NULL)
+			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+
+		wait->size = size;
+
+		/* Same deadlock mitigation as rt_buffer_write_timed(). */
+		if (bcb->fillsz > 0 && syncobj_count_grant(&bcb->sobj))
+			syncobj_grant_all(&bcb->sobj);
+
+		ret = syncobj_wait_drain(&bcb->sobj, abs_timeout, &syns);
+		if (ret) {
+			if (ret == -EIDRM)
+				goto out;
+			break;
+		}
+	}
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	if (wait)
+		threadobj_finish_wait();
+
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+/**
+ * @fn int rt_buffer_commit(RT_BUFFER *bf, size_t size)
+ * @brief Commit reserved space to an IPC buffer.
+ *
+ * This routine publishes the message built into the space obtained
+ * from a previous call to rt_buffer_reserve_timed(), then ends the
+ * reservation.
+ *
+ * @param bf The descriptor address of the buffer to commit to.
+ *
+ * @param size The actual length in bytes of the message, which may
+ * be lower than the reserved size. Zero is a valid value, which
+ * cancels the reservation.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, no
+ * reservation is pending, or @a size is greater than the reserved
+ * size.
+ *
+ * Valid calling context: any.
+ */
+int rt_buffer_commit(RT_BUFFER *bf, size_t size)
+{
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (bcb->wrsvsz == 0 || size > bcb->wrsvsz) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	bcb->wroff = (bcb->wroff + size) % bcb->bufsz;
+	bcb->fillsz += size;
+	bcb->wrsvsz = 0;
+	wakeup_readers(bcb);
+	wakeup_writers(bcb);
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+/**
+ * @fn ssize_t rt_buffer_acquire(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, RTIME timeout)
+ * @brief Acquire data from an IPC buffer (with relative scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_acquire_timed() accepting a
+ * relative timeout specification expressed as a scalar value.
+ *
+ * @param bf The descriptor address of the buffer to acquire data
+ * from.
+ *
+ * @param size The length in bytes of the data to acquire.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the acquired data.
+ *
+ * @param timeout A delay expressed in clock ticks.
+ */
+
+/**
+ * @fn ssize_t rt_buffer_acquire_until(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, RTIME abs_timeout)
+ * @brief Acquire data from an IPC buffer (with absolute scalar timeout).
+ *
+ * This routine is a variant of rt_buffer_acquire_timed() accepting an
+ * absolute timeout specification expressed as a scalar value.
+ *
+ * @param bf The descriptor address of the buffer to acquire data
+ * from.
+ *
+ * @param size The length in bytes of the data to acquire.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the acquired data.
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks.
+ */
+
+/**
+ * @fn ssize_t rt_buffer_acquire_timed(RT_BUFFER *bf, size_t size, RT_BUFFER_SPAN *span, const struct timespec *abs_timeout)
+ * @brief Acquire data from an IPC buffer.
+ *
+ * This routine gives the caller access to the next message in the
+ * specified buffer, so that it may be parsed in place instead of
+ * being copied out with rt_buffer_read_timed(). The data is consumed
+ * when rt_buffer_release() is called. If not enough data is
+ * available on entry, the caller is allowed to block until enough
+ * data is written to the buffer, or a timeout elapses.
+ *
+ * A single acquisition may be pending on a buffer at any point in
+ * time. Other readers wait until the data is released. Unlike
+ * rt_buffer_read_timed(), this service never returns a short
+ * message.
+ *
+ * @param bf The descriptor address of the buffer to acquire data
+ * from.
+ *
+ * @param size The length in bytes of the data to acquire.
+ *
+ * @param span The address of a span descriptor which will be written
+ * upon success with the location of the acquired data. The data is
+ * split into two segments when it wraps around the end of the buffer
+ * (see RT_BUFFER_SPAN).
+ *
+ * @param abs_timeout An absolute date expressed in clock ticks,
+ * specifying a time limit to wait for enough data to be available
+ * from the buffer (see note). Passing NULL causes the caller to block
+ * indefinitely until enough data is available. Passing { .tv_sec = 0,
+ * .tv_nsec = 0 } causes the service to return immediately without
+ * blocking in case not enough data is available.
+ *
+ * @return The number of bytes acquired is returned upon
+ * success. Otherwise:
+ *
+ * - -ETIMEDOUT is returned if @a abs_timeout is reached before
+ * enough data is available.
+ *
+ * - -EWOULDBLOCK is returned if @a abs_timeout is { .tv_sec = 0,
+ * .tv_nsec = 0 } and not enough data is immediately available on
+ * entry.
+ *
+ * - -EINTR is returned if rt_task_unblock() was called for the
+ * current task before enough data became available.
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, or
+ * @a size is zero or greater than the actual buffer length.
+ *
+ * - -EIDRM is returned if @a bf is deleted while the caller was
+ * waiting for data. In such event, @a bf is no more valid upon return
+ * of this service.
+ *
+ * - -EPERM is returned if this service should block, but was not
+ * called from a Xenomai thread.
+ *
+ * Valid calling contexts:
+ *
+ * - Xenomai threads
+ * - Any other context if @a abs_timeout is { .tv_sec = 0,
+ * .tv_nsec = 0 }.
+ *
+ * @note @a abs_timeout is interpreted as a multiple of the Alchemy
+ * clock resolution (see --alchemy-clock-resolution option, defaults
+ * to 1 nanosecond).
+ */
+ssize_t rt_buffer_acquire_timed(RT_BUFFER *bf,
+				size_t size, RT_BUFFER_SPAN *span,
+				const struct timespec *abs_timeout)
+{
+	struct alchemy_buffer_wait *wait = NULL;
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	if (size == 0)
+		return -EINVAL;
+
+	if (!threadobj_current_p() && !alchemy_poll_mode(abs_timeout))
+		return -EPERM;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (size > bcb->bufsz) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	for (;;) {
+		if (bcb->rdacqsz == 0 && bcb->fillsz >= size) {
+			bcb->rdacqsz = size;
+			get_span(bcb, bcb->rdoff, size, span);
+			ret = (ssize_t)size;
+			break;
+		}
+
+		if (alchemy_poll_mode(abs_timeout)) {
+			ret = -EWOULDBLOCK;
+			break;
+		}
+
+		if (wait == NULL)
+			wait = threadobj_prepare_wait(struct alchemy_buffer_wait);
+
+		wait->size = size;
+
+		ret = syncobj_wait_grant(&bcb->sobj, abs_timeout, &syns);
+		if (ret) {
+			if (ret == -EIDRM)
+				goto out;
+			break;
+		}
+	}
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	if (wait)
+		threadobj_finish_wait();
+
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+/**
+ * @fn int rt_buffer_release(RT_BUFFER *bf, size_t size)
+ * @brief Release acquired data from an IPC buffer.
+ *
+ * This routine consumes the data obtained from a previous call to
+ * rt_buffer_acquire_timed(), then ends the acquisition.
+ *
+ * @param bf The descriptor address of the buffer to release data to.
+ *
+ * @param size The length in bytes of the data to consume, which may
+ * be lower than the acquired size. The remaining data is left in the
+ * buffer for the next reader. Zero is a valid value, which leaves the
+ * buffer untouched.
+ *
+ * @return Zero is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a bf is not a valid buffer descriptor, no
+ * acquisition is pending, or @a size is greater than the acquired
+ * size.
+ *
+ * Valid calling context: any.
+ */
+int rt_buffer_release(RT_BUFFER *bf, size_t size)
+{
+	struct alchemy_buffer *bcb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	CANCEL_DEFER(svc);
+
+	bcb = get_alchemy_buffer(bf, &syns, &ret);
+	if (bcb == NULL)
+		goto out;
+
+	if (bcb->rdacqsz == 0 || size > bcb->rdacqsz) {
+		ret = -EINVAL;
+		goto done;
+	}
+
+	bcb->rdoff = (bcb->rdoff + size) % bcb->bufsz;
+	bcb->fillsz -= size;
+	bcb->rdacqsz = 0;
+	wakeup_writers(bcb);
+	wakeup_readers(bcb);
+done:
+	put_alchemy_buffer(bcb, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
 /**
  * @fn int rt_buffer_clear(RT_BUFFER *bf)
  * @brief Clear an IPC buffer.
@@ -688,6 +1170,10 @@ out:
  *
  * - -EINVAL is returned if @a bf is not a valid buffer descriptor.
  *
+ * - -EBUSY is returned if buffer space is currently reserved by
+ * rt_buffer_reserve_timed(), or data is held by
+ * rt_buffer_acquire_timed().
+ *
  * Valid calling context: any.
  */
 int rt_buffer_clear(RT_BUFFER *bf)
@@ -703,11 +1189,16 @@ int rt_buffer_clear(RT_BUFFER *bf)
 	if (bcb == NULL)
 		goto out;
 
+	if (bcb->wrsvsz || bcb->rdacqsz) {
+		ret = -EBUSY;
+		goto done;
+	}
+
 	bcb->wroff = 0;
 	bcb->rdoff = 0;
 	bcb->fillsz = 0;
 	syncobj_drain(&bcb->sobj);
-
+done:
 	put_alchemy_buffer(bcb, &syns);
 out:
 	CANCEL_RESTORE(svc);
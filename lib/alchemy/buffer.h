@@ -34,6 +34,8 @@ struct alchemy_buffer {
 	size_t rdoff;
 	size_t wroff;
 	size_t fillsz;
+	size_t wrsvsz;		/* Reserved by rt_buffer_reserve(). */
+	size_t rdacqsz;		/* Held by rt_buffer_acquire(). */
 };
 
 struct alchemy_buffer_wait {
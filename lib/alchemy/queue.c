@@ -44,6 +44,189 @@ static DEFINE_NAME_GENERATOR(queue_namegen, "queue",
 
 DEFINE_SYNC_LOOKUP(queue, RT_QUEUE);
 
+DEFINE_LOOKUP_PRIVATE(queue, RT_QUEUE);
+
+/* Lock a queue control block obtained from find_alchemy_queue(). */
+static inline int lock_alchemy_queue(struct alchemy_queue *qcb,
+				     struct syncstate *syns)
+{
+	if (syncobj_lock(&qcb->sobj, syns) || qcb->magic != queue_magic)
+		return -EINVAL;
+
+	return 0;
+}
+
+static inline struct alchemy_queue_ring *queue_ring(struct alchemy_queue *qcb)
+{
+	return (struct alchemy_queue_ring *)(qcb + 1);
+}
+
+/*
+ * Q_SPSC queues convey messages through a lock-free ring. The
+ * producer calls rt_queue_alloc(), rt_queue_send() and
+ * rt_queue_write(), the consumer calls rt_queue_receive(),
+ * rt_queue_read() and rt_queue_free(). The syncobj lock is only
+ * grabbed for putting the consumer to sleep when the ring is empty,
+ * and for waking it up.
+ */
+static struct alchemy_queue_msg *spsc_alloc(struct alchemy_queue *qcb,
+					    size_t size)
+{
+	struct alchemy_queue_ring *ring = queue_ring(qcb);
+	struct alchemy_queue_msg *msg;
+	uintptr_t head;
+
+	/*
+	 * Buffers released by the consumer are pushed to the
+	 * recycled stack, which the producer grabs at once when its
+	 * private cache runs empty. There is a single popper, so ABA
+	 * is not an issue here.
+	 */
+	if (ring->freelist == 0) {
+		do
+			head = ACCESS_ONCE(ring->recycled);
+		while (head &&
+		       atomic_cmp_swap(&ring->recycled, head, 0) != head);
+		ring->freelist = head;
+	}
+
+	msg = mainheap_deref(ring->freelist, struct alchemy_queue_msg);
+	if (msg) {
+		ring->freelist = msg->spsc.link;
+		if (msg->spsc.bufsz >= size)
+			return msg;
+		/* Too small, give it back to the pool. */
+		heapobj_free(&qcb->hobj, msg);
+	}
+
+	msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
+	if (msg)
+		msg->spsc.bufsz = size;
+
+	return msg;
+}
+
+static void spsc_recycle(struct alchemy_queue *qcb,
+			 struct alchemy_queue_msg *msg)
+{
+	struct alchemy_queue_ring *ring = queue_ring(qcb);
+	uintptr_t head, ref = mainheap_ref(msg, uintptr_t);
+
+	do {
+		head = ACCESS_ONCE(ring->recycled);
+		msg->spsc.link = head;
+	} while (atomic_cmp_swap(&ring->recycled, head, ref) != head);
+}
+
+static int spsc_send(struct alchemy_queue *qcb,
+		     struct alchemy_queue_msg *msg)
+{
+	struct alchemy_queue_ring *ring = queue_ring(qcb);
+	struct syncstate syns;
+	struct service svc;
+	unsigned int tail;
+	int ret = 0;
+
+	tail = ring->tail;
+	if (tail - ACCESS_ONCE(ring->head) >= qcb->limit)
+		return -ENOMEM;
+
+	ring->slots[tail & ring->mask] = mainheap_ref(msg, uintptr_t);
+	smp_wmb();
+	ACCESS_ONCE(ring->tail) = tail + 1;
+	/*
+	 * Pairs with the barrier in spsc_receive(): either the
+	 * consumer sees the new tail, or we see it sleeping.
+	 */
+	smp_mb();
+	if (ACCESS_ONCE(ring->sleeping) == 0)
+		return 0;
+
+	CANCEL_DEFER(svc);
+
+	if (syncobj_lock(&qcb->sobj, &syns))
+		ret = -EINVAL;
+	else {
+		if (syncobj_grant_one(&qcb->sobj))
+			ret = 1;
+		syncobj_unlock(&qcb->sobj, &syns);
+	}
+
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
+static struct alchemy_queue_msg *spsc_pop(struct alchemy_queue *qcb)
+{
+	struct alchemy_queue_ring *ring = queue_ring(qcb);
+	struct alchemy_queue_msg *msg;
+	unsigned int head;
+
+	head = ring->head;
+	if (head == ACCESS_ONCE(ring->tail))
+		return NULL;
+
+	smp_rmb();
+	msg = mainheap_deref(ring->slots[head & ring->mask],
+			     struct alchemy_queue_msg);
+	/* Fetch the slot before the producer may reuse it. */
+	smp_mb();
+	ACCESS_ONCE(ring->head) = head + 1;
+
+	return msg;
+}
+
+static int spsc_receive(struct alchemy_queue *qcb,
+			struct alchemy_queue_msg **msgp,
+			const struct timespec *abs_timeout)
+{
+	struct alchemy_queue_ring *ring = queue_ring(qcb);
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	*msgp = spsc_pop(qcb);
+	if (*msgp)
+		return 0;
+
+	if (alchemy_poll_mode(abs_timeout))
+		return -EWOULDBLOCK;
+
+	CANCEL_DEFER(svc);
+
+	if (syncobj_lock(&qcb->sobj, &syns)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	threadobj_prepare_wait(struct alchemy_queue_wait);
+
+	for (;;) {
+		ring->sleeping = 1;
+		smp_mb();
+		*msgp = spsc_pop(qcb);
+		if (*msgp)
+			break;
+		ret = syncobj_wait_grant(&qcb->sobj, abs_timeout, &syns);
+		if (ret) {
+			if (ret == -EIDRM) {
+				threadobj_finish_wait();
+				goto out;
+			}
+			break;
+		}
+	}
+
+	ring->sleeping = 0;
+	threadobj_finish_wait();
+	syncobj_unlock(&qcb->sobj, &syns);
+out:
+	CANCEL_RESTORE(svc);
+
+	return ret;
+}
+
 static void queue_finalize(struct syncobj *sobj)
 {
 	struct alchemy_queue *qcb;
@@ -81,12 +264,27 @@ fnref_register(libalchemy, queue_finalize);
  * OR'ed into this bitmask, each of them affecting the new queue:
  *
  * - Q_FIFO makes tasks pend in FIFO order on the queue for consuming
- * messages.
+ *   messages.
  *
  * - Q_PRIO makes tasks pend in priority order on the queue.
  *
+ * - Q_SPSC makes the queue a single producer, single consumer
+ *   channel. Messages are conveyed through a lock-free ring of @a
+ *   qlimit entries, which must not be Q_UNLIMITED. Only one task may
+ *   allocate and send messages, and only one task may receive, read
+ *   and free them. rt_queue_flush() should be called by the
+ *   receiving task. Q_URGENT and Q_BROADCAST are not supported by
+ *   such queue.
+ *
+ * - Q_SPIN causes waiters to poll the queue for a short while before
+ *   going to sleep, like S_SPIN does for semaphores (see
+ *   rt_sem_create()).
+ *
  * @return Zero is returned upon success. Otherwise:
  *
+ * - -EINVAL is returned if @a mode is invalid, or Q_SPSC was given
+ * with an unlimited @a qlimit.
+ *
  * - -ENOMEM is returned if the system fails to get memory from the
  * main heap in order to create the queue.
  *
@@ -118,20 +316,30 @@ fnref_register(libalchemy, queue_finalize);
 int rt_queue_create(RT_QUEUE *queue, const char *name,
 		    size_t poolsize, size_t qlimit, int mode)
 {
+	struct alchemy_queue_ring *ring;
 	struct alchemy_queue *qcb;
 	int sobj_flags = 0, ret;
+	unsigned int nslots = 0;
 	struct service svc;
 
 	if (threadobj_irq_p())
 		return -EPERM;
 
-	if (poolsize == 0 || (mode & ~Q_PRIO) != 0)
+	if (poolsize == 0 || (mode & ~(Q_PRIO|Q_SPSC|Q_SPIN)) != 0)
 		return -EINVAL;
 
+	if (mode & Q_SPSC) {
+		if (qlimit == Q_UNLIMITED || qlimit > (1U << 30))
+			return -EINVAL;
+		for (nslots = 1; nslots < qlimit; nslots <<= 1)
+			;
+	}
+
 	CANCEL_DEFER(svc);
 
 	ret = -ENOMEM;
-	qcb = xnmalloc(sizeof(*qcb));
+	qcb = xnmalloc(sizeof(*qcb) + (nslots ? sizeof(*ring) +
+				       nslots * sizeof(uintptr_t) : 0));
 	if (qcb == NULL)
 		goto out;
 
@@ -163,9 +371,22 @@ int rt_queue_create(RT_QUEUE *queue, const char *name,
 	list_init(&qcb->mq);
 	qcb->mcount = 0;
 
+	if (mode & Q_SPSC) {
+		ring = queue_ring(qcb);
+		ring->tail = 0;
+		ring->head = 0;
+		ring->mask = nslots - 1;
+		ring->sleeping = 0;
+		ring->recycled = 0;
+		ring->freelist = 0;
+	}
+
 	if (mode & Q_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (mode & Q_SPIN)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	syncobj_init(&qcb->sobj, CLOCK_COPPERPLATE, sobj_flags,
 		     fnref_put(libalchemy, queue_finalize));
 
@@ -259,10 +480,23 @@ void *rt_queue_alloc(RT_QUEUE *queue, size_t size)
 	struct service svc;
 	int ret;
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		return NULL;
+
+	if (qcb->mode & Q_SPSC) {
+		msg = spsc_alloc(qcb, size);
+		if (msg == NULL)
+			return NULL;
+		msg->size = size;
+		msg->refcount = 1;
+		return msg + 1;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &ret);
-	if (qcb == NULL)
+	ret = lock_alchemy_queue(qcb, &syns);
+	if (ret)
 		goto out;
 
 	msg = heapobj_alloc(&qcb->hobj, size + sizeof(*msg));
@@ -319,10 +553,26 @@ int rt_queue_free(RT_QUEUE *queue, void *buf)
 
 	msg = (struct alchemy_queue_msg *)buf - 1;
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		return ret;
+
+	if (qcb->mode & Q_SPSC) {
+		/*
+		 * The buffer is owned by the caller, no need to
+		 * serialize the reference count update.
+		 */
+		if (msg->refcount == 0)
+			return -EINVAL;
+		if (--msg->refcount == 0)
+			spsc_recycle(qcb, msg);
+		return 0;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &ret);
-	if (qcb == NULL)
+	ret = lock_alchemy_queue(qcb, &syns);
+	if (ret)
 		goto out;
 
 	if (heapobj_validate(&qcb->hobj, msg) == 0) {
@@ -417,10 +667,25 @@ int rt_queue_send(RT_QUEUE *queue,
 
 	msg = (struct alchemy_queue_msg *)buf - 1;
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		return ret;
+
+	if (qcb->mode & Q_SPSC) {
+		if (mode != Q_NORMAL || msg->refcount == 0)
+			return -EINVAL;
+		msg->size = size;
+		msg->refcount--;
+		ret = spsc_send(qcb, msg);
+		if (ret < 0)
+			msg->refcount++;
+		return ret;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &ret);
-	if (qcb == NULL)
+	ret = lock_alchemy_queue(qcb, &syns);
+	if (ret)
 		goto out;
 
 	if (qcb->limit && qcb->mcount >= qcb->limit) {
@@ -531,10 +796,29 @@ int rt_queue_write(RT_QUEUE *queue,
 	if (size == 0)
 		return 0;
 
+	qcb = find_alchemy_queue(queue, &ret);
+	if (qcb == NULL)
+		return ret;
+
+	if (qcb->mode & Q_SPSC) {
+		if (mode != Q_NORMAL)
+			return -EINVAL;
+		msg = spsc_alloc(qcb, size);
+		if (msg == NULL)
+			return -ENOMEM;
+		msg->size = size;
+		msg->refcount = 0;
+		memcpy(msg + 1, buf, size);
+		ret = spsc_send(qcb, msg);
+		if (ret < 0)
+			spsc_recycle(qcb, msg);
+		return ret;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &ret);
-	if (qcb == NULL)
+	ret = lock_alchemy_queue(qcb, &syns);
+	if (ret)
 		goto out;
 
 	waiter = syncobj_peek_grant(&qcb->sobj);
@@ -703,10 +987,23 @@ ssize_t rt_queue_receive_timed(RT_QUEUE *queue, void **bufp,
 	if (!threadobj_current_p() && !alchemy_poll_mode(abs_timeout))
 		return -EPERM;
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL)
+		return err;
+
+	if (qcb->mode & Q_SPSC) {
+		err = spsc_receive(qcb, &msg, abs_timeout);
+		if (err)
+			return err;
+		msg->refcount++;
+		*bufp = msg + 1;
+		return (ssize_t)msg->size;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &err);
-	if (qcb == NULL) {
+	err = lock_alchemy_queue(qcb, &syns);
+	if (err) {
 		ret = err;
 		goto out;
 	}
@@ -862,10 +1159,25 @@ ssize_t rt_queue_read_timed(RT_QUEUE *queue,
 	if (size == 0)
 		return 0;
 
+	qcb = find_alchemy_queue(queue, &err);
+	if (qcb == NULL)
+		return err;
+
+	if (qcb->mode & Q_SPSC) {
+		err = spsc_receive(qcb, &msg, abs_timeout);
+		if (err)
+			return err;
+		ret = (ssize_t)(msg->size > size ? size : msg->size);
+		if (ret > 0)
+			memcpy(buf, msg + 1, ret);
+		spsc_recycle(qcb, msg);
+		return ret;
+	}
+
 	CANCEL_DEFER(svc);
 
-	qcb = get_alchemy_queue(queue, &syns, &err);
-	if (qcb == NULL) {
+	err = lock_alchemy_queue(qcb, &syns);
+	if (err) {
 		ret = err;
 		goto out;
 	}
@@ -941,6 +1253,12 @@ int rt_queue_flush(RT_QUEUE *queue)
 	if (qcb == NULL)
 		goto out;
 
+	if (qcb->mode & Q_SPSC) {
+		for (ret = 0; (msg = spsc_pop(qcb)) != NULL; ret++)
+			spsc_recycle(qcb, msg);
+		goto done;
+	}
+
 	ret = qcb->mcount;
 	qcb->mcount = 0;
 
@@ -956,7 +1274,7 @@ int rt_queue_flush(RT_QUEUE *queue)
 			heapobj_free(&qcb->hobj, msg);
 		}
 	}
-
+done:
 	put_alchemy_queue(qcb, &syns);
 out:
 	CANCEL_RESTORE(svc);
@@ -995,7 +1313,10 @@ int rt_queue_inquire(RT_QUEUE *queue, RT_QUEUE_INFO *info)
 		goto out;
 
 	info->nwaiters = syncobj_count_grant(&qcb->sobj);
-	info->nmessages = qcb->mcount;
+	if (qcb->mode & Q_SPSC)
+		info->nmessages = queue_ring(qcb)->tail - queue_ring(qcb)->head;
+	else
+		info->nmessages = qcb->mcount;
 	info->mode = qcb->mode;
 	info->qlimit = qcb->limit;
 	info->poolsize = heapobj_size(&qcb->hobj);
@@ -35,14 +35,36 @@ struct alchemy_queue {
 	struct clusterobj cobj;
 	struct list mq;
 	unsigned int mcount;
+	/* Q_SPSC: struct alchemy_queue_ring follows. */
 };
 
 #define queue_magic	0x8787ebeb
 
+/*
+ * Message ring of a Q_SPSC queue. The producer only updates the
+ * tail and the consumer only updates the head, the syncobj is used
+ * for sleeping and waking up the consumer.
+ */
+struct alchemy_queue_ring {
+	unsigned int tail;	/* Next slot to fill. */
+	unsigned int head;	/* Next slot to consume. */
+	unsigned int mask;
+	int sleeping;		/* Consumer is about to wait. */
+	uintptr_t recycled;	/* Buffers released to the producer. */
+	uintptr_t freelist;	/* Producer-private buffer cache. */
+	uintptr_t slots[0];
+};
+
 struct alchemy_queue_msg {
 	size_t size;
 	unsigned int refcount;
-	struct holder next;
+	union {
+		struct holder next;
+		struct {	/* Q_SPSC only. */
+			uintptr_t link;
+			size_t bufsz;
+		} spsc;
+	};
 	/* Payload data follows. */
 };
 
@@ -91,6 +91,13 @@ fnref_register(libalchemy, sem_finalize);
  * even if no waiter is pending. For this reason, the semaphore count
  * in pulse mode remains zero.
  *
+ * - S_SPIN causes waiters to poll the semaphore for a short while
+ * before going to sleep, which saves a context switch when it is
+ * signaled shortly after from another CPU. The spinning delay adapts
+ * to the wait times observed, and is bounded by the timeout of the
+ * wait. This flag is ignored over the Cobalt core, and on
+ * uniprocessor systems.
+ *
  * @return Zero is returned upon success. Otherwise:
  *
  * - -EINVAL is returned if the @a icount is non-zero and S_PULSE is
@@ -140,6 +147,9 @@ int rt_sem_create(RT_SEM *sem, const char *name,
 	if (mode & S_PRIO)
 		smobj_flags |= SEMOBJ_PRIO;
 
+	if (mode & S_SPIN)
+		smobj_flags |= SEMOBJ_ADAPTIVE;
+
 	ret = semobj_init(&scb->smobj, smobj_flags, icount,
 			  fnref_put(libalchemy, sem_finalize));
 	if (ret) {
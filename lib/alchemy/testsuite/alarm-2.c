@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/alarm.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4
+};
+
+static RT_TASK t_main;
+
+static RT_ALARM lo_alarm, hi_alarm;
+
+static RTIME hi_last, hi_maxgap;
+
+static int hi_hits;
+
+static void lo_handler(void *arg)
+{
+	/* Hog the CPU way longer than the high priority period. */
+	rt_timer_spin(50000000ULL);
+}
+
+static void hi_handler(void *arg)
+{
+	RTIME now = rt_timer_read();
+
+	if (hi_last && now - hi_last > hi_maxgap)
+		hi_maxgap = now - hi_last;
+
+	hi_last = now;
+	hi_hits++;
+}
+
+static void main_task(void *arg)
+{
+	int ret;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_alarm_start(&hi_alarm, 1000000ULL, 1000000ULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_alarm_start(&lo_alarm, 10000000ULL, 100000000ULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 2);
+
+	ret = rt_task_sleep(500000000ULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_alarm_stop(&lo_alarm);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_alarm_stop(&hi_alarm);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 3);
+
+	/*
+	 * The low priority handler spins for 50ms every 100ms: had it
+	 * delayed the high priority alarm, we would have seen a 50ms
+	 * gap between two shots of the latter.
+	 */
+	traceobj_assert(&trobj, hi_hits > 250);
+	traceobj_assert(&trobj, hi_maxgap < 20000000ULL);
+
+	ret = rt_alarm_delete(&lo_alarm);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_alarm_delete(&hi_alarm);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 4);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_alarm_create_prio(&lo_alarm, "LOALARM", lo_handler, NULL, 10);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_alarm_create_prio(&hi_alarm, "HIALARM", hi_handler, NULL, 80);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  90, 0, main_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	exit(0);
+}
@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/buffer.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4
+};
+
+#define BUFSZ      100
+#define LINESZ     30
+#define NLINES     1000
+
+static RT_TASK t_main, t_peer;
+
+static RT_BUFFER buffer;
+
+static void fill_span(RT_BUFFER_SPAN *span, int seq)
+{
+	unsigned char *p;
+	size_t n;
+
+	for (n = 0, p = span->ptr1; n < span->len1; n++)
+		*p++ = seq + n;
+
+	for (p = span->ptr2; n < span->len1 + span->len2; n++)
+		*p++ = seq + n;
+}
+
+static int check_span(RT_BUFFER_SPAN *span, int seq)
+{
+	unsigned char *p;
+	size_t n;
+
+	for (n = 0, p = span->ptr1; n < span->len1; n++)
+		if (*p++ != (unsigned char)(seq + n))
+			return 0;
+
+	for (p = span->ptr2; n < span->len1 + span->len2; n++)
+		if (*p++ != (unsigned char)(seq + n))
+			return 0;
+
+	return 1;
+}
+
+static void peer_task(void *arg)
+{
+	RT_BUFFER_SPAN span;
+	int ret, n, wraps = 0;
+
+	traceobj_enter(&trobj);
+
+	for (n = 0; n < NLINES; n++) {
+		ret = rt_buffer_acquire(&buffer, LINESZ, &span, TM_INFINITE);
+		traceobj_assert(&trobj, ret == LINESZ);
+		traceobj_assert(&trobj, span.len1 + span.len2 == LINESZ);
+		if (span.ptr2)
+			wraps++;
+		traceobj_assert(&trobj, check_span(&span, n));
+		ret = rt_buffer_release(&buffer, LINESZ);
+		traceobj_assert(&trobj, ret == 0);
+	}
+
+	/* LINESZ does not divide BUFSZ, so lines must have wrapped. */
+	traceobj_assert(&trobj, wraps > 0);
+
+	traceobj_mark(&trobj, 3);
+
+	traceobj_exit(&trobj);
+}
+
+static void main_task(void *arg)
+{
+	RT_BUFFER_SPAN span;
+	RT_BUFFER_INFO info;
+	int ret, n;
+
+	traceobj_enter(&trobj);
+
+	ret = rt_buffer_create(&buffer, NULL, BUFSZ, B_FIFO);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_buffer_reserve(&buffer, LINESZ, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == LINESZ);
+
+	/* Writers and clearing wait for the reservation to end. */
+	ret = rt_buffer_write(&buffer, "x", 1, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == -EWOULDBLOCK);
+
+	ret = rt_buffer_clear(&buffer);
+	traceobj_assert(&trobj, ret == -EBUSY);
+
+	ret = rt_buffer_commit(&buffer, LINESZ + 1);
+	traceobj_assert(&trobj, ret == -EINVAL);
+
+	/* Cancel the reservation. */
+	ret = rt_buffer_commit(&buffer, 0);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_buffer_commit(&buffer, 0);
+	traceobj_assert(&trobj, ret == -EINVAL);
+
+	ret = rt_buffer_acquire(&buffer, 1, &span, TM_NONBLOCK);
+	traceobj_assert(&trobj, ret == -EWOULDBLOCK);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_task_create(&t_peer, "peer_task", 0, 11, T_JOINABLE);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_task_start(&t_peer, peer_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 2);
+
+	for (n = 0; n < NLINES; n++) {
+		ret = rt_buffer_reserve(&buffer, LINESZ, &span, TM_INFINITE);
+		traceobj_assert(&trobj, ret == LINESZ);
+		traceobj_assert(&trobj, span.len1 + span.len2 == LINESZ);
+		fill_span(&span, n);
+		ret = rt_buffer_commit(&buffer, LINESZ);
+		traceobj_assert(&trobj, ret == 0);
+	}
+
+	ret = rt_task_join(&t_peer);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 4);
+
+	ret = rt_buffer_inquire(&buffer, &info);
+	traceobj_assert(&trobj, ret == 0);
+	traceobj_assert(&trobj, info.availmem == BUFSZ);
+
+	ret = rt_buffer_delete(&buffer);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  10, 0, main_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/queue.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5
+};
+
+#define NMESSAGES  10000
+#define QLIMIT     16
+
+RT_QUEUE q;
+
+static void peer_task(void *arg)
+{
+	int ret, n, *msg, val;
+
+	traceobj_enter(&trobj);
+
+	/*
+	 * Alternate zero-copy receptions and plain reads, blocking
+	 * whenever the ring runs empty.
+	 */
+	for (n = 0; n < NMESSAGES; n++) {
+		if (n & 1) {
+			ret = rt_queue_read(&q, &val, sizeof(val), TM_INFINITE);
+			traceobj_assert(&trobj, ret == sizeof(val));
+		} else {
+			ret = rt_queue_receive(&q, (void **)&msg, TM_INFINITE);
+			traceobj_assert(&trobj, ret == sizeof(*msg));
+			val = *msg;
+			ret = rt_queue_free(&q, msg);
+			traceobj_assert(&trobj, ret == 0);
+		}
+		traceobj_assert(&trobj, val == n);
+	}
+
+	traceobj_mark(&trobj, 4);
+
+	traceobj_exit(&trobj);
+}
+
+static void main_task(void *arg)
+{
+	RT_QUEUE_INFO info;
+	RT_TASK t_peer;
+	int ret, n, *msg;
+
+	traceobj_enter(&trobj);
+
+	ret = rt_queue_create(&q, "QUEUE", 64, Q_UNLIMITED, Q_SPSC);
+	traceobj_assert(&trobj, ret == -EINVAL);
+
+	ret = rt_queue_create(&q, "QUEUE", QLIMIT * sizeof(int),
+			      QLIMIT, Q_FIFO|Q_SPSC);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 1);
+
+	/* Fill up the ring, then make sure it refuses more. */
+	for (n = 0; n < QLIMIT; n++) {
+		ret = rt_queue_write(&q, &n, sizeof(n), Q_NORMAL);
+		traceobj_assert(&trobj, ret == 0);
+	}
+
+	ret = rt_queue_write(&q, &n, sizeof(n), Q_NORMAL);
+	traceobj_assert(&trobj, ret == -ENOMEM);
+
+	ret = rt_queue_write(&q, &n, sizeof(n), Q_URGENT);
+	traceobj_assert(&trobj, ret == -EINVAL);
+
+	ret = rt_queue_inquire(&q, &info);
+	traceobj_assert(&trobj, ret == 0);
+	traceobj_assert(&trobj, info.nmessages == QLIMIT);
+
+	ret = rt_queue_flush(&q);
+	traceobj_assert(&trobj, ret == QLIMIT);
+
+	traceobj_mark(&trobj, 2);
+
+	ret = rt_task_create(&t_peer, "peer_task", 0, 11, T_JOINABLE);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_task_start(&t_peer, peer_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 3);
+
+	for (n = 0; n < NMESSAGES; n++) {
+		if (n & 1) {
+			msg = rt_queue_alloc(&q, sizeof(*msg));
+			traceobj_assert(&trobj, msg != NULL);
+			*msg = n;
+			do
+				ret = rt_queue_send(&q, msg, sizeof(*msg), Q_NORMAL);
+			while (ret == -ENOMEM && rt_task_yield() == 0);
+		} else {
+			do
+				ret = rt_queue_write(&q, &n, sizeof(n), Q_NORMAL);
+			while (ret == -ENOMEM && rt_task_yield() == 0);
+		}
+		traceobj_assert(&trobj, ret >= 0);
+	}
+
+	ret = rt_task_join(&t_peer);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 5);
+
+	ret = rt_queue_inquire(&q, &info);
+	traceobj_assert(&trobj, ret == 0);
+	traceobj_assert(&trobj, info.nmessages == 0);
+
+	ret = rt_queue_delete(&q);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	RT_TASK t_main;
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_task_spawn(&t_main, "main_task", 0,  10, 0, main_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <copperplate/traceobj.h>
+#include <alchemy/task.h>
+#include <alchemy/sem.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5
+};
+
+#define NR_ROUNDS  10000
+
+static RT_TASK t_main, t_peer;
+
+static RT_SEM ping, pong;
+
+static int smp;
+
+/*
+ * Pin the ping-pong partners on distinct CPUs, so that a spinning
+ * waiter may actually see the peer post the semaphore. S_SPIN is
+ * ignored on uniprocessor systems.
+ */
+static void pin_task(RT_TASK *task, int cpu)
+{
+	cpu_set_t cpus;
+	int ret;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	ret = rt_task_set_affinity(task, &cpus);
+	traceobj_assert(&trobj, ret == 0);
+}
+
+static long count_sleeps(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_THREAD, &ru);
+
+	return ru.ru_nvcsw;
+}
+
+static void peer_task(void *arg)
+{
+	int ret, n;
+
+	traceobj_enter(&trobj);
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		ret = rt_sem_p(&ping, TM_INFINITE);
+		traceobj_assert(&trobj, ret == 0);
+		ret = rt_sem_v(&pong);
+		traceobj_assert(&trobj, ret == 0);
+	}
+
+	traceobj_mark(&trobj, 3);
+
+	/* Spinning waiters must still be flushed upon deletion. */
+	ret = rt_sem_p(&ping, TM_INFINITE);
+	traceobj_assert(&trobj, ret == -EIDRM);
+
+	traceobj_exit(&trobj);
+}
+
+static void main_task(void *arg)
+{
+	RT_SEM_INFO info;
+	long sleeps;
+	int ret, n;
+
+	traceobj_enter(&trobj);
+
+	smp = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+	if (smp)
+		pin_task(NULL, 0);
+
+	ret = rt_sem_create(&ping, "PING", 0, S_PRIO|S_SPIN);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_sem_create(&pong, "PONG", 0, S_PRIO|S_SPIN);
+	traceobj_assert(&trobj, ret == 0);
+
+	/* Spinning must not defeat the timeout. */
+	ret = rt_sem_p(&pong, 1000000);
+	traceobj_assert(&trobj, ret == -ETIMEDOUT);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = rt_task_create(&t_peer, "peer_task", 0, 20, T_JOINABLE);
+	traceobj_assert(&trobj, ret == 0);
+
+	if (smp)
+		pin_task(&t_peer, 1);
+
+	ret = rt_task_start(&t_peer, peer_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 2);
+
+	sleeps = count_sleeps();
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		ret = rt_sem_v(&ping);
+		traceobj_assert(&trobj, ret == 0);
+		ret = rt_sem_p(&pong, TM_INFINITE);
+		traceobj_assert(&trobj, ret == 0);
+	}
+
+	sleeps = count_sleeps() - sleeps;
+
+	ret = rt_sem_inquire(&ping, &info);
+	traceobj_assert(&trobj, ret == 0 && info.count == 0);
+
+#ifdef __MERCURY__
+	/*
+	 * Without spinning, we would sleep on every round waiting for
+	 * the peer's reply. Cobalt semaphores wait in the core, and
+	 * ignore S_SPIN.
+	 */
+	if (smp)
+		traceobj_assert(&trobj, sleeps < NR_ROUNDS / 2);
+#endif
+
+	traceobj_mark(&trobj, 4);
+
+	ret = rt_task_sleep(1000000);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_sem_delete(&ping);
+	traceobj_assert(&trobj, ret == 0);
+
+	ret = rt_task_join(&t_peer);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_mark(&trobj, 5);
+
+	ret = rt_sem_delete(&pong);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rt_task_spawn(&t_main, "main_task", 0, 20, 0, main_task, NULL);
+	traceobj_assert(&trobj, ret == 0);
+
+	traceobj_join(&trobj);
+
+	exit(0);
+}
@@ -105,7 +105,8 @@ int a4l_snd_cancel(a4l_desc_t * dsc, unsigned int idx_subd)
  * optionally a4l_fill_desc())
  * @param[in] idx_subd Index of the concerned subdevice
  * @param[in] size New buffer size, the maximal tolerated value is
- * 16MB (A4L_BUF_MAXSIZE)
+ * 16MB (A4L_BUF_MAXSIZE), or 1GB (A4L_BUF_CONTIG_MAXSIZE) if the
+ * flag A4L_BUFCFG_CONTIG was set with a4l_set_bufflags()
  *
  * @return 0 on success. Otherwise:
  *
@@ -134,15 +135,20 @@ int a4l_set_bufsize(a4l_desc_t * dsc,
 int a4l_set_wakesize(a4l_desc_t * dsc, unsigned long size)
 {
 	int err;
-	a4l_bufcfg2_t cfg = { .wake_count = size };
+	a4l_bufcfg2_t cfg;
 
 	/* Basic checking */
 	if (dsc == NULL || dsc->fd < 0)
 		return -EINVAL;
 
-	return  __sys_ioctl(dsc->fd, A4L_BUFCFG2, &cfg);
+	/* Keep the allocation flags untouched */
+	err = __sys_ioctl(dsc->fd, A4L_BUFINFO2, &cfg);
+	if (err < 0)
+		return err;
 
-	return err;
+	cfg.wake_count = size;
+
+	return __sys_ioctl(dsc->fd, A4L_BUFCFG2, &cfg);
 }
 
 int a4l_get_wakesize(a4l_desc_t * dsc, unsigned long *size)
@@ -162,6 +168,85 @@ int a4l_get_wakesize(a4l_desc_t * dsc, unsigned long *size)
 	return err;
 }
 
+/**
+ * @brief Set the allocation flags of the asynchronous buffer
+ *
+ * The flags are applied when the buffer is reallocated, that is to
+ * say at the next call to a4l_set_bufsize().
+ *
+ * With A4L_BUFCFG_CONTIG, the buffer is built out of physically
+ * contiguous blocks as large as the kernel page allocator can
+ * provide; the drivers relying on scatter-gather DMA then describe
+ * the buffer with one descriptor per block instead of one per page,
+ * and buffers up to 1GB (A4L_BUF_CONTIG_MAXSIZE) are accepted.
+ *
+ * @param[in] dsc Device descriptor filled by a4l_open() (and
+ * optionally a4l_fill_desc())
+ * @param[in] flags Allocation flags (A4L_BUFCFG_xxx)
+ *
+ * @return 0 on success. Otherwise:
+ *
+ * - -EINVAL is returned if the analogy descriptor is not correct or
+ *    if the flags are not supported (Please, type "dmesg" for more
+ *    info)
+ * - -EFAULT is returned if a user <-> kernel transfer went wrong
+ *
+ */
+int a4l_set_bufflags(a4l_desc_t * dsc, unsigned long flags)
+{
+	int err;
+	a4l_bufcfg2_t cfg;
+
+	/* Basic checking */
+	if (dsc == NULL || dsc->fd < 0)
+		return -EINVAL;
+
+	err = __sys_ioctl(dsc->fd, A4L_BUFINFO2, &cfg);
+	if (err < 0)
+		return err;
+
+	cfg.flags = flags;
+
+	return __sys_ioctl(dsc->fd, A4L_BUFCFG2, &cfg);
+}
+
+/**
+ * @brief Get the allocation flags of the asynchronous buffer
+ *
+ * @param[in] dsc Device descriptor filled by a4l_open() (and
+ * optionally a4l_fill_desc())
+ * @param[out] flags Allocation flags (A4L_BUFCFG_xxx)
+ * @param[out] chunks Count of physically contiguous chunks building
+ * the current buffer (may be NULL)
+ *
+ * @return 0 on success. Otherwise:
+ *
+ * - -EINVAL is returned if the analogy descriptor is not correct or
+ *    if some argument is missing
+ * - -EFAULT is returned if a user <-> kernel transfer went wrong
+ *
+ */
+int a4l_get_bufflags(a4l_desc_t * dsc,
+		     unsigned long *flags, unsigned long *chunks)
+{
+	int err;
+	a4l_bufcfg2_t cfg;
+
+	/* Basic checking */
+	if (flags == NULL || dsc == NULL || dsc->fd < 0)
+		return -EINVAL;
+
+	err = __sys_ioctl(dsc->fd, A4L_BUFINFO2, &cfg);
+	if (err < 0)
+		return err;
+
+	*flags = cfg.flags;
+	if (chunks)
+		*chunks = cfg.chunks;
+
+	return 0;
+}
+
 /**
  * @brief Get the size of the asynchronous buffer
  *
@@ -349,6 +434,165 @@ int a4l_mmap(a4l_desc_t * dsc,
 	return ret;
 }
 
+/**
+ * @brief Map the asynchronous buffer status into a user-space
+ *
+ * The status page holds the producer and consumer counts of the
+ * ring-buffer, shared with the kernel. Along with a4l_mmap(), it
+ * allows an input acquisition to be consumed without any syscall:
+ * a4l_bufstat_avail() reads the amount of data available,
+ * a4l_bufstat_consume() releases the data processed in place, and
+ * a4l_bufstat_wait() only enters the kernel when less than the
+ * wake-up size (see a4l_set_wakesize()) is available.
+ *
+ * @param[in] dsc Device descriptor filled by a4l_open() (and
+ * optionally a4l_fill_desc())
+ * @param[in] idx_subd Index of the concerned subdevice
+ * @param[out] ptr Address of the pointer containing the assigned
+ * address on return
+ *
+ * @return 0 on success. Otherwise:
+ *
+ * - -EINVAL is returned if some argument is missing or wrong, the
+ *    descriptor and the pointer should be checked; check also the
+ *    kernel log
+ * - -ENOSYS is returned if the function is called in an RT context
+ * - -ENOMEM is returned if the system is out of memory
+ * - -EFAULT is returned if a user <-> kernel transfer went wrong
+ *
+ */
+int a4l_mmap_status(a4l_desc_t * dsc,
+		    unsigned int idx_subd, a4l_bufstat_t **ptr)
+{
+	int ret;
+	a4l_mmap_t map = { idx_subd, 0, NULL };
+
+	/* Basic checkings */
+	if (dsc == NULL || dsc->fd < 0)
+		return -EINVAL;
+
+	if (ptr == NULL)
+		return -EINVAL;
+
+	ret = __sys_ioctl(dsc->fd, A4L_MMAPSTAT, &map);
+
+	if (ret == 0)
+		*ptr = map.ptr;
+
+	return ret;
+}
+
+/**
+ * @brief Get the amount of data available in a mapped input buffer
+ *
+ * This service does not issue any syscall.
+ *
+ * @param[in] st Status page returned by a4l_mmap_status()
+ *
+ * @return the count of bytes which can be read from the mapped
+ * buffer, starting at offset (st->cns_count % st->size). Otherwise:
+ *
+ * - -EPIPE is returned if the buffer overflowed
+ * - -ENOENT is returned if the acquisition is over and all the data
+ *    were consumed
+ *
+ */
+long a4l_bufstat_avail(a4l_bufstat_t *st)
+{
+	unsigned long prd, end, events;
+
+	prd = *(volatile unsigned long *)&st->prd_count;
+	/* Read the count before the data and the flags it covers */
+	__sync_synchronize();
+	events = st->events;
+	end = st->end_count;
+
+	if (events & A4L_BUFSTAT_ERROR)
+		return -EPIPE;
+
+	if (end != 0 && (long)(prd - end) > 0)
+		prd = end;
+
+	if (prd == st->cns_count && (events & A4L_BUFSTAT_EOA))
+		return -ENOENT;
+
+	return prd - st->cns_count;
+}
+
+/**
+ * @brief Release data consumed in place from a mapped input buffer
+ *
+ * This service does not issue any syscall; the kernel picks the
+ * new consumer count up the next time it needs it.
+ *
+ * @param[in] st Status page returned by a4l_mmap_status()
+ * @param[in] count Count of bytes consumed
+ *
+ */
+void a4l_bufstat_consume(a4l_bufstat_t *st, unsigned long count)
+{
+	/* The data must be read before the slots are handed back */
+	__sync_synchronize();
+	*(volatile unsigned long *)&st->cns_count = st->cns_count + count;
+}
+
+/**
+ * @brief Wait for data in a mapped input buffer
+ *
+ * The caller is put to sleep only if less than the wake-up size is
+ * available, in which case a4l_poll() is issued and the kernel
+ * wakes the caller up once the threshold is reached.
+ *
+ * @param[in] dsc Device descriptor filled by a4l_open() (and
+ * optionally a4l_fill_desc())
+ * @param[in] idx_subd Index of the concerned subdevice
+ * @param[in] st Status page returned by a4l_mmap_status()
+ * @param[in] ms_timeout The number of miliseconds to wait for some
+ * data to be available. Passing A4L_INFINITE causes the caller to
+ * block indefinitely until some data is available. Passing
+ * A4L_NONBLOCK causes the function to return immediately without
+ * waiting for any available data
+ *
+ * @return the available data count, otherwise a negative error
+ * code:
+ *
+ * - -EPIPE is returned if the buffer overflowed
+ * - -ENOENT is returned if the acquisition is over
+ * - -EINTR is returned if calling task has been unblocked by a signal
+ *
+ */
+long a4l_bufstat_wait(a4l_desc_t * dsc, unsigned int idx_subd,
+		      a4l_bufstat_t *st, unsigned long ms_timeout)
+{
+	unsigned long wake, left;
+	long avail;
+	int ret;
+
+	avail = a4l_bufstat_avail(st);
+	if (avail < 0)
+		return avail;
+
+	wake = st->wake_count ?: 1;
+	if (st->end_count != 0) {
+		left = st->end_count - st->cns_count;
+		if (left < wake)
+			wake = left;
+	}
+
+	if ((unsigned long)avail >= wake || ms_timeout == A4L_NONBLOCK)
+		return avail;
+
+	ret = a4l_poll(dsc, idx_subd, ms_timeout);
+	if (ret < 0)
+		return ret;
+
+	/* The kernel resets the status once the acquisition is over */
+	if ((st->events & A4L_BUFSTAT_ACTIVE) == 0)
+		return -ENOENT;
+
+	return a4l_bufstat_avail(st);
+}
+
 /** @} Command syscall API */
 
 /*!
@@ -600,6 +600,39 @@ size_t get_max_size(void *mem_pool)
 #endif
 }
 
+/******************************************************************/
+size_t get_free_stats(void *mem_pool, size_t * largest, size_t * nfrags)
+{
+/******************************************************************/
+    tlsf_t *tlsf = (tlsf_t *) mem_pool;
+    size_t free_size = 0, bsize;
+    bhdr_t *b;
+    int fl, sl;
+
+    *largest = 0;
+    *nfrags = 0;
+
+    TLSF_ACQUIRE_LOCK(&tlsf->lock);
+
+    for (fl = 0; fl < REAL_FLI; fl++) {
+	if (!(tlsf->fl_bitmap & (1 << fl)))
+	    continue;
+	for (sl = 0; sl < MAX_SLI; sl++) {
+	    for (b = tlsf->matrix[fl][sl]; b; b = b->ptr.free_ptr.next) {
+		bsize = b->size & BLOCK_SIZE;
+		free_size += bsize;
+		if (bsize > *largest)
+		    *largest = bsize;
+		(*nfrags)++;
+	    }
+	}
+    }
+
+    TLSF_RELEASE_LOCK(&tlsf->lock);
+
+    return free_size;
+}
+
 /******************************************************************/
 void destroy_memory_pool(void *mem_pool)
 {
@@ -84,6 +84,62 @@ static int __do_clock_host_realtime(struct timespec *ts)
 	return 0;
 }
 
+static int __do_clock_coarse(unsigned long long offset, struct timespec *ts)
+{
+	struct xnvdso_coarse_data *coarse_data;
+	unsigned long long ns;
+	unsigned long rem;
+	urwstate_t tmp;
+
+	if (!xnvdso_test_feature(vdso, XNVDSO_FEAT_COARSE_CLOCK))
+		return -1;
+
+	coarse_data = &vdso->coarse_data;
+
+	unsynced_read_block(&tmp, &coarse_data->lock)
+		ns = coarse_data->date;
+
+	ns += offset;
+	ts->tv_sec = cobalt_divrem_billion(ns, &rem);
+	ts->tv_nsec = rem;
+
+	return 0;
+}
+
+static int __do_clock_external(clockid_t clock_id, struct timespec *ts)
+{
+	struct xnvdso_extclock_data *extclock_data;
+	unsigned long long ns, offset;
+	unsigned long rem;
+	urwstate_t tmp;
+	int nr, live;
+
+	if (!xnvdso_test_feature(vdso, XNVDSO_FEAT_EXT_CLOCKS))
+		return -1;
+
+	nr = __COBALT_CLOCK_INDEX(clock_id);
+	if (nr >= XNVDSO_MAX_EXTCLOCKS)
+		return -1;
+
+	extclock_data = &vdso->extclock_data[nr];
+
+	unsynced_read_block(&tmp, &extclock_data->lock) {
+		ns = cobalt_ticks_to_ns(__xn_rdtsc());
+		offset = extclock_data->offset;
+		live = extclock_data->live;
+	}
+
+	/* Let the core tell about unregistered clocks. */
+	if (!live)
+		return -1;
+
+	ns += offset;
+	ts->tv_sec = cobalt_divrem_billion(ns, &rem);
+	ts->tv_nsec = rem;
+
+	return 0;
+}
+
 COBALT_IMPL(int, clock_gettime, (clockid_t clock_id, struct timespec *tp))
 {
 	unsigned long long ns;
@@ -106,7 +162,19 @@ COBALT_IMPL(int, clock_gettime, (clockid_t clock_id, struct timespec *tp))
 		tp->tv_sec = cobalt_divrem_billion(ns, &rem);
 		tp->tv_nsec = rem;
 		return 0;
+	case CLOCK_MONOTONIC_COARSE:
+		if (__do_clock_coarse(0, tp) == 0)
+			return 0;
+		goto syscall;
+	case CLOCK_REALTIME_COARSE:
+		if (__do_clock_coarse(vdso->wallclock_offset, tp) == 0)
+			return 0;
+		goto syscall;
 	default:
+		if (__COBALT_CLOCK_EXT_P(clock_id) &&
+		    __do_clock_external(clock_id, tp) == 0)
+			return 0;
+	syscall:
 		ret = -XENOMAI_SKINCALL2(__cobalt_muxid,
 					 sc_cobalt_clock_gettime,
 					 clock_id,
@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <pthread.h>
+#include <sys/mman.h>
 #include <asm/xenomai/syscall.h>
 #include "current.h"
 #include "internal.h"
@@ -92,16 +93,65 @@ int __cobalt_thread_join(pthread_t thread)
 	return ret;
 }
 
+#ifdef MADV_POPULATE_WRITE
+
+static int populate_works = -1;
+
+/*
+ * Kernels predating MADV_POPULATE_WRITE fail it with EINVAL, which
+ * is also what we get for device mappings. Tell them apart once, by
+ * populating the current stack page.
+ */
+static int populate_supported(long pagesz)
+{
+	char probe, *page;
+
+	page = (char *)((unsigned long)&probe & ~(pagesz - 1));
+
+	if (populate_works < 0)
+		populate_works = madvise(page, pagesz,
+					 MADV_POPULATE_WRITE) == 0;
+
+	return populate_works;
+}
+
+#endif
+
 void ___cobalt_prefault(void *p, size_t len)
 {
 	volatile char *_p = (volatile char *)p, *end;
 	long pagesz = sysconf(_SC_PAGESIZE);
+	unsigned long start;
+
+	if (len == 0)
+		return;
 
 	end = _p + len;
-	do {
+	start = (unsigned long)p & ~(pagesz - 1);
+#ifdef MADV_POPULATE_WRITE
+	/*
+	 * Have the kernel populate the range in a single call. It
+	 * refuses VM_IO/VM_PFNMAP areas with EINVAL, and fails with
+	 * EFAULT on pages it can't populate; device memory is mapped
+	 * upfront, and must not be written to behind the driver's
+	 * back, so we are done then. Touch each page by hand only
+	 * if the kernel is too old for this.
+	 */
+	if (populate_supported(pagesz)) {
+		if (madvise((void *)start, (unsigned long)end - start,
+			    MADV_POPULATE_WRITE) == 0 ||
+		    errno == EINVAL || errno == EFAULT)
+			return;
+	}
+#endif
+	/*
+	 * Touch the first byte, then the start of every subsequent
+	 * page, so that a range crossing page boundaries is fully
+	 * covered regardless of its alignment.
+	 */
+	*_p = *_p;
+	for (_p = (volatile char *)start + pagesz; _p < end; _p += pagesz)
 		*_p = *_p;
-		_p += pagesz;
-	} while (_p < end);
 }
 
 int __cobalt_serial_debug(const char *fmt, ...)
@@ -191,14 +241,22 @@ int cobalt_monitor_enter(cobalt_monitor_t *mon)
 	 * - no recursive entry/locking.
 	 */
 
+	/*
+	 * Same rules as for mutexes: relaxed threads, weak or not,
+	 * must go through the kernel which hardens them. Weak threads
+	 * in primary mode may grab the gate locally, accounting for
+	 * it in their window.
+	 */
 	status = cobalt_get_current_mode();
-	if (status & (XNRELAX|XNWEAK))
+	if (status & XNRELAX)
 		goto syscall;
 
 	datp = get_monitor_data(mon);
 	cur = cobalt_get_current();
 	ret = xnsynch_fast_acquire(&datp->owner, cur);
 	if (ret == 0) {
+		if (status & XNWEAK)
+			cobalt_get_current_window()->hrescnt++;
 		datp->flags &= ~(COBALT_MONITOR_SIGNALED|COBALT_MONITOR_BROADCAST);
 		return 0;
 	}
@@ -220,8 +278,28 @@ syscall:
 	return ret;
 }
 
+/*
+ * Tell whether some signal pending on the monitor may wake up a
+ * sleeper. A grant might target a thread which is not waiting
+ * anymore, so we are conservative with those. Signals nobody can
+ * receive are simply dropped by the next entry.
+ */
+static inline int monitor_wakeup_p(struct cobalt_monitor_data *datp)
+{
+	unsigned long flags = datp->flags;
+
+	if ((flags & COBALT_MONITOR_PENDED) == 0)
+		return 0;
+
+	if ((flags & COBALT_MONITOR_GRANTED) && datp->grant_waiters > 0)
+		return 1;
+
+	return (flags & COBALT_MONITOR_DRAINED) && datp->drain_waiters > 0;
+}
+
 int cobalt_monitor_exit(cobalt_monitor_t *mon)
 {
+	struct xnthread_user_window *window;
 	struct cobalt_monitor_data *datp;
 	unsigned long status;
 	xnhandle_t cur;
@@ -229,15 +307,23 @@ int cobalt_monitor_exit(cobalt_monitor_t *mon)
 	__sync_synchronize();
 
 	datp = get_monitor_data(mon);
-	if ((datp->flags & COBALT_MONITOR_PENDED) &&
-	    (datp->flags & COBALT_MONITOR_SIGNALED))
+	if (monitor_wakeup_p(datp))
 		goto syscall;
 
+	cur = cobalt_get_current();
 	status = cobalt_get_current_mode();
-	if (status & XNWEAK)
+	if (status & XNWEAK) {
+		/* See pthread_mutex_unlock(). */
+		window = cobalt_get_current_window();
+		if ((status & XNRELAX) == 0 && window->hrescnt <= 1)
+			goto syscall;
+		if (xnsynch_fast_release(&datp->owner, cur)) {
+			window->hrescnt--;
+			return 0;
+		}
 		goto syscall;
+	}
 
-	cur = cobalt_get_current();
 	if (xnsynch_fast_release(&datp->owner, cur))
 		return 0;
 syscall:
@@ -287,7 +373,7 @@ int cobalt_monitor_grant_sync(cobalt_monitor_t *mon,
 
 	cobalt_monitor_grant(mon, u_window);
 
-	if ((datp->flags & COBALT_MONITOR_PENDED) == 0)
+	if (!monitor_wakeup_p(datp))
 		return 0;
 
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
@@ -318,7 +404,7 @@ int cobalt_monitor_grant_all_sync(cobalt_monitor_t *mon)
 
 	cobalt_monitor_grant_all(mon);
 
-	if ((datp->flags & COBALT_MONITOR_PENDED) == 0)
+	if (!monitor_wakeup_p(datp))
 		return 0;
 
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
@@ -349,7 +435,7 @@ int cobalt_monitor_drain_sync(cobalt_monitor_t *mon)
 
 	cobalt_monitor_drain(mon);
 
-	if ((datp->flags & COBALT_MONITOR_PENDED) == 0)
+	if (!monitor_wakeup_p(datp))
 		return 0;
 
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
@@ -380,7 +466,7 @@ int cobalt_monitor_drain_all_sync(cobalt_monitor_t *mon)
 
 	cobalt_monitor_drain_all(mon);
 
-	if ((datp->flags & COBALT_MONITOR_PENDED) == 0)
+	if (!monitor_wakeup_p(datp))
 		return 0;
 
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
@@ -463,7 +549,7 @@ int cobalt_event_post(cobalt_event_t *event, unsigned long bits)
 
 	__sync_or_and_fetch(&datp->value, bits); /* full barrier. */
 
-	if ((datp->flags & COBALT_EVENT_PENDED) == 0)
+	if ((datp->flags & (COBALT_EVENT_PENDED|COBALT_EVENT_WATCHED)) == 0)
 		return 0;
 
 	return XENOMAI_SKINCALL1(__cobalt_muxid,
@@ -474,8 +560,33 @@ int cobalt_event_wait(cobalt_event_t *event,
 		      unsigned long bits, unsigned long *bits_r,
 		      int mode, const struct timespec *timeout)
 {
+	struct cobalt_event_data *datp = get_event_data(event);
+	unsigned long value, rbits, testval;
 	int ret, oldtype;
 
+	/*
+	 * Fast path: the flags we wait for may already be set, in
+	 * which case there is nothing to wait for since waiting does
+	 * not consume them. Likewise, a plain reading of the group
+	 * value or a failed non-blocking attempt does not need the
+	 * core.
+	 */
+	value = __sync_fetch_and_or(&datp->value, 0); /* full barrier. */
+	if (bits == 0) {
+		*bits_r = value;
+		return 0;
+	}
+
+	rbits = value & bits;
+	testval = mode & COBALT_EVENT_ANY ? rbits : bits;
+	if (rbits && rbits == testval) {
+		*bits_r = rbits;
+		return 0;
+	}
+
+	if (timeout && timeout->tv_sec == 0 && timeout->tv_nsec == 0)
+		return -EWOULDBLOCK;
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	ret = XENOMAI_SKINCALL5(__cobalt_muxid,
@@ -509,3 +620,57 @@ int cobalt_event_inquire(cobalt_event_t *event, unsigned long *bits_r)
 
 	return datp->nwaiters;
 }
+
+int cobalt_waitset_init(cobalt_waitset_t *ws, int nmax)
+{
+	return XENOMAI_SKINCALL2(__cobalt_muxid,
+				 sc_cobalt_waitset_init, ws, nmax);
+}
+
+/*
+ * @obj is the address of a sem_t or cobalt_event_t, or a message
+ * queue or RTDM file descriptor, depending on @type. On success, the index
+ * identifying the new member in wait reports is returned.
+ */
+int cobalt_waitset_add(cobalt_waitset_t *ws, int type,
+		       unsigned long obj, unsigned long mask)
+{
+	return XENOMAI_SKINCALL4(__cobalt_muxid,
+				 sc_cobalt_waitset_add, ws, type, obj, mask);
+}
+
+int cobalt_waitset_remove(cobalt_waitset_t *ws, int index)
+{
+	return XENOMAI_SKINCALL2(__cobalt_muxid,
+				 sc_cobalt_waitset_remove, ws, index);
+}
+
+int cobalt_waitset_modify(cobalt_waitset_t *ws, int index,
+			  unsigned long mask)
+{
+	return XENOMAI_SKINCALL3(__cobalt_muxid,
+				 sc_cobalt_waitset_modify, ws, index, mask);
+}
+
+int cobalt_waitset_wait(cobalt_waitset_t *ws,
+			int *ready, int nready,
+			const struct timespec *timeout)
+{
+	int ret, oldtype;
+
+	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
+
+	ret = XENOMAI_SKINCALL4(__cobalt_muxid,
+				sc_cobalt_waitset_wait,
+				ws, ready, nready, timeout);
+
+	pthread_setcanceltype(oldtype, NULL);
+
+	return ret;
+}
+
+int cobalt_waitset_destroy(cobalt_waitset_t *ws)
+{
+	return XENOMAI_SKINCALL1(__cobalt_muxid,
+				 sc_cobalt_waitset_destroy, ws);
+}
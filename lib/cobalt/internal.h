@@ -27,6 +27,7 @@
 #include <cobalt/uapi/kernel/vdso.h>
 #include <cobalt/uapi/mutex.h>
 #include <cobalt/uapi/event.h>
+#include <cobalt/uapi/waitset.h>
 #include <cobalt/uapi/monitor.h>
 #include <cobalt/uapi/thread.h>
 #include <cobalt/uapi/cond.h>
@@ -121,6 +122,22 @@ int cobalt_event_inquire(cobalt_event_t *event,
 
 int cobalt_event_destroy(cobalt_event_t *event);
 
+int cobalt_waitset_init(cobalt_waitset_t *ws, int nmax);
+
+int cobalt_waitset_add(cobalt_waitset_t *ws, int type,
+		       unsigned long obj, unsigned long mask);
+
+int cobalt_waitset_remove(cobalt_waitset_t *ws, int index);
+
+int cobalt_waitset_modify(cobalt_waitset_t *ws, int index,
+			  unsigned long mask);
+
+int cobalt_waitset_wait(cobalt_waitset_t *ws,
+			int *ready, int nready,
+			const struct timespec *timeout);
+
+int cobalt_waitset_destroy(cobalt_waitset_t *ws);
+
 void cobalt_print_init(void);
 
 void cobalt_print_exit(void);
@@ -119,6 +119,26 @@ COBALT_IMPL(int, pthread_mutex_destroy, (pthread_mutex_t *mutex))
 	return -err;
 }
 
+/*
+ * Relaxed shadows must switch back to primary mode for grabbing a
+ * mutex, so that the regular kernel can't hold off a resource
+ * real-time threads may contend for: they always go through a
+ * syscall, which hardens them. This applies to weak threads as
+ * well. Those running in primary mode count the resources they hold
+ * into their user window, which the kernel checks before
+ * auto-relaxing them, so they may grab an uncontended mutex locally.
+ */
+static inline int mutex_fast_p(unsigned long status)
+{
+	return (status & XNRELAX) == 0;
+}
+
+static inline void mutex_fast_grab(unsigned long status)
+{
+	if (status & XNWEAK)
+		cobalt_get_current_window()->hrescnt++;
+}
+
 COBALT_IMPL(int, pthread_mutex_lock, (pthread_mutex_t *mutex))
 {
 	struct __shadow_mutex *_mutex =
@@ -134,15 +154,11 @@ COBALT_IMPL(int, pthread_mutex_lock, (pthread_mutex_t *mutex))
 	if (_mutex->magic != COBALT_MUTEX_MAGIC)
 		return EINVAL;
 
-	/*
-	 * We track resource ownership for non real-time shadows in
-	 * order to handle the auto-relax feature, so we must always
-	 * obtain them via a syscall.
-	 */
 	status = cobalt_get_current_mode();
-	if ((status & (XNRELAX|XNWEAK)) == 0) {
+	if (mutex_fast_p(status)) {
 		err = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
 		if (err == 0) {
+			mutex_fast_grab(status);
 			_mutex->lockcnt = 1;
 			return 0;
 		}
@@ -193,11 +209,11 @@ COBALT_IMPL(int, pthread_mutex_timedlock, (pthread_mutex_t *mutex,
 	if (_mutex->magic != COBALT_MUTEX_MAGIC)
 		return EINVAL;
 
-	/* See __cobalt_pthread_mutex_lock() */
 	status = cobalt_get_current_mode();
-	if ((status & (XNRELAX|XNWEAK)) == 0) {
+	if (mutex_fast_p(status)) {
 		err = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
 		if (err == 0) {
+			mutex_fast_grab(status);
 			_mutex->lockcnt = 1;
 			return 0;
 		}
@@ -249,9 +265,10 @@ COBALT_IMPL(int, pthread_mutex_trylock, (pthread_mutex_t *mutex))
 		return EINVAL;
 
 	status = cobalt_get_current_mode();
-	if ((status & (XNRELAX|XNWEAK)) == 0) {
+	if (mutex_fast_p(status)) {
 		err = xnsynch_fast_acquire(mutex_get_ownerp(_mutex), cur);
 		if (err == 0) {
+			mutex_fast_grab(status);
 			_mutex->lockcnt = 1;
 			return 0;
 		}
@@ -290,8 +307,10 @@ COBALT_IMPL(int, pthread_mutex_unlock, (pthread_mutex_t *mutex))
 {
 	struct __shadow_mutex *_mutex =
 		&((union cobalt_mutex_union *)mutex)->shadow_mutex;
+	struct xnthread_user_window *window;
 	struct mutex_dat *datp = NULL;
 	xnhandle_t cur = XN_NO_HANDLE;
+	unsigned long status;
 	int err;
 
 	if (_mutex->magic != COBALT_MUTEX_MAGIC)
@@ -313,8 +332,21 @@ COBALT_IMPL(int, pthread_mutex_unlock, (pthread_mutex_t *mutex))
 	if ((datp->flags & COBALT_MUTEX_COND_SIGNAL))
 		goto do_syscall;
 
-	if (cobalt_get_current_mode() & XNWEAK)
+	status = cobalt_get_current_mode();
+	if (status & XNWEAK) {
+		/*
+		 * Dropping the last resource from primary mode must
+		 * auto-relax us, which only the kernel can do.
+		 */
+		window = cobalt_get_current_window();
+		if ((status & XNRELAX) == 0 && window->hrescnt <= 1)
+			goto do_syscall;
+		if (xnsynch_fast_release(&datp->owner, cur)) {
+			window->hrescnt--;
+			return 0;
+		}
 		goto do_syscall;
+	}
 
 	if (xnsynch_fast_release(&datp->owner, cur))
 		return 0;
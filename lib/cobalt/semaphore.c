@@ -96,6 +96,10 @@ COBALT_IMPL(int, sem_post, (sem_t *sem))
 		if (datp->flags & SEM_PULSE)
 			return 0;
 
+		/* Waitsets must hear about the count increase. */
+		if (datp->flags & SEM_WATCHED)
+			goto do_syscall;
+
 		do {
 			old = value;
 			new = value + 1;
@@ -301,11 +305,18 @@ int sem_init_np(sem_t *sem, int flags, unsigned int value)
 
 	err = -XENOMAI_SKINCALL3(__cobalt_muxid,
 				 sc_cobalt_sem_init_np, _sem, flags, value);
-	if (!err)
-		return 0;
+	if (err) {
+		errno = err;
+		return -1;
+	}
 
-	errno = err;
-	return -1;
+	/*
+	 * Copperplate semaphores are built on this call, and rely on
+	 * the fast paths of sem_post() and sem_trywait(), which may
+	 * run in primary mode: make sure the shared count won't fault.
+	 */
+	__cobalt_prefault(sem_get_datp(_sem));
+	return 0;
 }
 
 int sem_broadcast_np(sem_t *sem)
@@ -441,6 +441,99 @@ int pthread_probe_np(pid_t tid)
 				 sc_cobalt_thread_probe, tid);
 }
 
+/**
+ * Prefault a memory range.
+ *
+ * This service populates and write-faults the pages backing the
+ * range [@a addr, @a addr + @a len), so that the caller won't take
+ * any minor fault when touching this range later on from primary
+ * mode. It is meant for heap areas and mapped RTDM buffers, before
+ * entering a time-critical loop. Device memory mapped by a driver is
+ * left untouched.
+ *
+ * This service is a non-portable extension of the POSIX interface.
+ *
+ * @param addr start address of the range;
+ *
+ * @param len size of the range, in bytes.
+ *
+ * @return 0 on success;
+ * @return an error number if:
+ * - EINVAL, @a addr is NULL while @a len is non-zero.
+ */
+int pthread_prefault_np(void *addr, size_t len)
+{
+	if (addr == NULL && len > 0)
+		return EINVAL;
+
+	___cobalt_prefault(addr, len);
+
+	return 0;
+}
+
+/**
+ * Prefault the stack of the current thread.
+ *
+ * This service prefaults the whole stack of the calling thread, as
+ * pthread_prefault_np() does for a memory range. The stack of the
+ * main thread grows on demand, so only the default Cobalt stack size
+ * is prefaulted for it.
+ *
+ * This service is a non-portable extension of the POSIX interface.
+ *
+ * @return 0 on success;
+ * @return an error number if the stack attributes of the calling
+ * thread cannot be retrieved.
+ */
+int pthread_prefault_stack_np(void)
+{
+	pthread_attr_t attr;
+	void *stkaddr;
+	size_t stksz;
+	int ret;
+
+	/* The main thread stack grows on demand, go for the usual size. */
+	if (pthread_self() == __cobalt_main_tid) {
+		prefault_stack();
+		return 0;
+	}
+
+	ret = pthread_getattr_np(pthread_self(), &attr);
+	if (ret)
+		return ret;
+
+	ret = pthread_attr_getstack(&attr, &stkaddr, &stksz);
+	pthread_attr_destroy(&attr);
+	if (ret)
+		return ret;
+
+	___cobalt_prefault(stkaddr, stksz);
+
+	return 0;
+}
+
+/**
+ * Get the page fault count of the current thread.
+ *
+ * This service returns the number of page faults the calling thread
+ * took while running in primary mode, each of which caused a switch
+ * to secondary mode. Comparing two readings around a time-critical
+ * section tells whether some memory it uses needs prefaulting.
+ *
+ * This service is a non-portable extension of the POSIX interface.
+ *
+ * @return the page fault count, or zero if the caller is not a
+ * Cobalt thread.
+ */
+unsigned long pthread_pagefaults_np(void)
+{
+	struct xnthread_user_window *u_window;
+
+	u_window = cobalt_get_current_window();
+
+	return u_window ? u_window->pagefaults : 0;
+}
+
 int sched_setconfig_np(int cpu, int policy,
 		       const union sched_config *config, size_t len)
 {
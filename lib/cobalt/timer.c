@@ -17,20 +17,172 @@
  */
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
+#include <cobalt/ticks.h>
 #include <asm/xenomai/syscall.h>
+#include <asm/xenomai/tsc.h>
 #include "internal.h"
+#include <cobalt/uapi/timer.h>
+
+/*
+ * The core publishes the state of our timers into a table living in
+ * the private heap, so that reading it back does not require a
+ * syscall. Rearming a one-shot timer for a later date does not
+ * either: we post the new date, which the core picks up when the
+ * current one elapses.
+ */
+static struct cobalt_timer_table *timer_table;
+
+static pthread_once_t timer_atfork_once = PTHREAD_ONCE_INIT;
+
+static void timer_forget_table(void)
+{
+	/* The child gets a new private heap, and no timer. */
+	timer_table = NULL;
+}
+
+static void timer_init_atfork(void)
+{
+	pthread_atfork(NULL, NULL, timer_forget_table);
+}
+
+static struct cobalt_timer_data *timer_data(timer_t timerid)
+{
+	struct cobalt_timer_table *tab = timer_table;
+	unsigned int id = (unsigned int)(long)timerid;
+	unsigned long off;
+
+	if (tab == NULL || id >= tab->nr)
+		return NULL;
+
+	off = tab->chunks[id / COBALT_TIMER_CHUNK];
+	if (off == COBALT_TIMER_NOCHUNK)
+		return NULL;
+
+	return (struct cobalt_timer_data *)(cobalt_sem_heap[0] + off) +
+		id % COBALT_TIMER_CHUNK;
+}
+
+static long timer_read(struct cobalt_timer_data *data,
+		       struct cobalt_timer_data *snap)
+{
+	urwstate_t tmp;
+	long gen;
+
+	unsynced_read_block(&tmp, &data->lock) {
+		gen = atomic_long_read(&data->gen);
+		snap->flags = data->flags;
+		snap->overruns = data->overruns;
+		snap->date = data->date;
+		snap->interval = data->interval;
+		snap->defer = data->defer;
+	}
+
+	if ((gen & (COBALT_TIMER_DEFER|COBALT_TIMER_BUSY)) ==
+	    COBALT_TIMER_DEFER)
+		snap->date = snap->defer;
+
+	return gen;
+}
+
+static void timer_fill(const struct cobalt_timer_data *snap,
+		       unsigned long long now, struct itimerspec *value)
+{
+	unsigned long long date = snap->date, interval = snap->interval;
+	unsigned long rem;
+
+	if (date == 0) {
+		value->it_value.tv_sec = 0;
+		value->it_value.tv_nsec = 0;
+		value->it_interval.tv_sec = 0;
+		value->it_interval.tv_nsec = 0;
+		return;
+	}
+
+	/* The core only publishes the first shot of periodic timers. */
+	if (interval && date <= now)
+		date += ((now - date) / interval + 1) * interval;
+
+	/* Elapsed, but the core did not run the handler yet. */
+	date = date > now ? date - now : 1;
+
+	value->it_value.tv_sec = cobalt_divrem_billion(date, &rem);
+	value->it_value.tv_nsec = rem;
+	value->it_interval.tv_sec = cobalt_divrem_billion(interval, &rem);
+	value->it_interval.tv_nsec = rem;
+}
+
+static int timer_set_lazy(struct cobalt_timer_data *data, int flags,
+			  const struct itimerspec *__restrict__ value,
+			  struct itimerspec *__restrict__ ovalue)
+{
+	struct cobalt_timer_data snap;
+	unsigned long long now, date;
+	long gen;
+
+	/*
+	 * We may only push back the date of a running one-shot timer
+	 * based on a monotonic clock. Anything else, including arming
+	 * an earlier date, requires the core to reprogram the timer.
+	 */
+	if (value->it_interval.tv_sec || value->it_interval.tv_nsec ||
+	    (unsigned long)value->it_value.tv_nsec >= 1000000000 ||
+	    (value->it_value.tv_sec == 0 && value->it_value.tv_nsec == 0))
+		return 0;
+
+	gen = timer_read(data, &snap);
+	if ((snap.flags & (COBALT_TIMER_USED|COBALT_TIMER_DATED|
+			   COBALT_TIMER_MONO)) !=
+	    (COBALT_TIMER_USED|COBALT_TIMER_DATED|COBALT_TIMER_MONO) ||
+	    snap.date == 0 || snap.interval ||
+	    (gen & (COBALT_TIMER_DEFER|COBALT_TIMER_BUSY)))
+		return 0;
+
+	now = cobalt_ticks_to_ns(__xn_rdtsc());
+	/* Same rounding as the core applies. */
+	date = value->it_value.tv_sec * 1000000000ULL +
+		value->it_value.tv_nsec + 1;
+	if ((flags & TIMER_ABSTIME) == 0)
+		date += now;
+
+	if (snap.date <= now || date < snap.date)
+		return 0;
+
+	if (ovalue)
+		timer_fill(&snap, now, ovalue);
+
+	/*
+	 * Claim the deferral slot for the generation we read, post
+	 * the date, then publish it. If the core changed the timer
+	 * state meanwhile, let it handle the request.
+	 */
+	if (atomic_long_cmpxchg(&data->gen, gen,
+				gen | COBALT_TIMER_BUSY) != gen)
+		return 0;
+
+	data->defer = date;
+
+	return atomic_long_cmpxchg(&data->gen, gen | COBALT_TIMER_BUSY,
+				   gen | COBALT_TIMER_DEFER) ==
+		(gen | COBALT_TIMER_BUSY);
+}
 
 COBALT_IMPL(int, timer_create, (clockid_t clockid,
 				const struct sigevent *__restrict__ evp,
 				timer_t * __restrict__ timerid))
 {
+	unsigned long taboff;
 	int ret;
 
-	ret = -XENOMAI_SKINCALL3(__cobalt_muxid,
+	ret = -XENOMAI_SKINCALL4(__cobalt_muxid,
 				 sc_cobalt_timer_create,
-				 clockid, evp, timerid);
-	if (ret == 0)
+				 clockid, evp, timerid, &taboff);
+	if (ret == 0) {
+		pthread_once(&timer_atfork_once, timer_init_atfork);
+		timer_table = (struct cobalt_timer_table *)
+			(cobalt_sem_heap[0] + taboff);
 		return 0;
+	}
 
 	errno = ret;
 
@@ -57,8 +209,13 @@ COBALT_IMPL(int, timer_settime, (timer_t timerid,
 				 const struct itimerspec *__restrict__ value,
 				 struct itimerspec *__restrict__ ovalue))
 {
+	struct cobalt_timer_data *data;
 	int ret;
 
+	data = timer_data(timerid);
+	if (data && timer_set_lazy(data, flags, value, ovalue))
+		return 0;
+
 	ret = -XENOMAI_SKINCALL4(__cobalt_muxid,
 				 sc_cobalt_timer_settime,
 				 timerid, flags, value, ovalue);
@@ -72,8 +229,20 @@ COBALT_IMPL(int, timer_settime, (timer_t timerid,
 
 COBALT_IMPL(int, timer_gettime, (timer_t timerid, struct itimerspec *value))
 {
+	struct cobalt_timer_data *data, snap;
 	int ret;
 
+	data = timer_data(timerid);
+	if (data) {
+		timer_read(data, &snap);
+		if ((snap.flags & (COBALT_TIMER_USED|COBALT_TIMER_DATED)) ==
+		    (COBALT_TIMER_USED|COBALT_TIMER_DATED)) {
+			timer_fill(&snap, cobalt_ticks_to_ns(__xn_rdtsc()),
+				   value);
+			return 0;
+		}
+	}
+
 	ret = -XENOMAI_SKINCALL2(__cobalt_muxid,
 				 sc_cobalt_timer_gettime,
 				 timerid, value);
@@ -87,8 +256,16 @@ COBALT_IMPL(int, timer_gettime, (timer_t timerid, struct itimerspec *value))
 
 COBALT_IMPL(int, timer_getoverrun, (timer_t timerid))
 {
+	struct cobalt_timer_data *data, snap;
 	int overrun;
 
+	data = timer_data(timerid);
+	if (data) {
+		timer_read(data, &snap);
+		if (snap.flags & COBALT_TIMER_USED)
+			return snap.overruns;
+	}
+
 	overrun = XENOMAI_SKINCALL1(__cobalt_muxid,
 				    sc_cobalt_timer_getoverrun,
 				    timerid);
@@ -149,6 +149,20 @@ size_t pvheapobj_inquire(struct heapobj *hobj)
 	return ph->used;
 }
 
+size_t pvheapobj_inquire_free(struct heapobj *hobj,
+			      size_t *largest_r, size_t *nfrags_r)
+{
+	struct pool_header *ph = hobj->pool;
+	size_t free_size;
+
+	/* We don't see the process arena, assume no fragmentation. */
+	free_size = hobj->size - ph->used;
+	*largest_r = free_size;
+	*nfrags_r = free_size > 0;
+
+	return free_size;
+}
+
 size_t pvheapobj_validate(struct heapobj *hobj, void *ptr)
 {
 	struct block_header *bh;
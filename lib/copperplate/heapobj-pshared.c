@@ -28,6 +28,7 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
 #include <unistd.h>
@@ -206,6 +207,45 @@ static void init_main_heap(struct session_heap *m_heap, void *mem, size_t size)
 	__list_init(m_heap, &m_heap->sysgroup.heap_list);
 }
 
+/*
+ * Free blocks linked to a bucket record the extent they belong to
+ * right after the link, so that we don't have to look it up when
+ * allocating them. The smallest block can hold both values.
+ */
+static inline void set_block_extent(struct shared_heap *heap, caddr_t block,
+				    struct shared_extent *extent)
+{
+	((memoff_t *)block)[1] = __moff(heap, extent);
+}
+
+static inline struct shared_extent *
+get_block_extent(struct shared_heap *heap, caddr_t block)
+{
+	return __mref(heap, ((memoff_t *)block)[1]);
+}
+
+static struct shared_extent *find_extent(struct shared_heap *heap, void *block)
+{
+	struct shared_extent *extent;
+	memoff_t off = __moff(heap, block);
+
+	/*
+	 * Most heaps, including the main one, never grow beyond
+	 * their initial extent, look there first.
+	 */
+	extent = __list_first_entry(heap, &heap->extents,
+				    struct shared_extent, link);
+	if (off >= extent->membase && off < extent->memlim)
+		return extent;
+
+	__list_for_each_entry(heap, extent, &heap->extents, link) {
+		if (off >= extent->membase && off < extent->memlim)
+			return extent;
+	}
+
+	return NULL;
+}
+
 static caddr_t get_free_range(struct shared_heap *heap, size_t bsize, int log2size)
 {
 	caddr_t block, eblock, freepage, lastpage, headpage, freehead = NULL;
@@ -262,10 +302,13 @@ splitpage:
 		 */
 		for (block = headpage, eblock =
 		     headpage + HOBJ_PAGE_SIZE - bsize; block < eblock;
-		     block += bsize)
+		     block += bsize) {
 			*((memoff_t *)block) = __moff(heap, block) + bsize;
+			set_block_extent(heap, block, extent);
+		}
 
 		*((memoff_t *)eblock) = 0;
+		set_block_extent(heap, eblock, extent);
 	} else
 		*((memoff_t *)headpage) = 0;
 
@@ -305,13 +348,354 @@ align_alloc_size(size_t size)
 	return __align_to(size, HOBJ_MINALIGNSZ);
 }
 
-static void *alloc_block(struct shared_heap *heap, size_t size)
+static inline int __attribute__ ((always_inline))
+bucket_log2size(size_t size)
 {
+	int log2size;
+	size_t bsize;
+
+	/*
+	 * Find the first power of two greater or equal to the rounded
+	 * size, return its log2 value.
+	 */
+	for (bsize = (1 << HOBJ_MINLOG2), log2size = HOBJ_MINLOG2;
+	     bsize < size; bsize <<= 1, log2size++)
+		;	/* Loop */
+
+	return log2size;
+}
+
+/* Must be called with heap->lock held. */
+static caddr_t __alloc_bucket_block(struct shared_heap *heap, int log2size)
+{
+	int ilog = log2size - HOBJ_MINLOG2;
 	struct shared_extent *extent;
-	int log2size, ilog;
 	size_t pnum, bsize;
 	caddr_t block;
 
+	bsize = (1 << log2size);
+	block = __mref_check(heap, heap->buckets[ilog].freelist);
+	if (block == NULL) {
+		block = get_free_range(heap, bsize, log2size);
+		if (block == NULL)
+			return NULL;
+		if (bsize <= HOBJ_PAGE_SIZE)
+			heap->buckets[ilog].fcount += (HOBJ_PAGE_SIZE >> log2size) - 1;
+	} else {
+		if (bsize <= HOBJ_PAGE_SIZE)
+			--heap->buckets[ilog].fcount;
+
+		extent = get_block_extent(heap, block);
+		assert(__moff(heap, block) >= extent->membase &&
+		       __moff(heap, block) < extent->memlim);
+		pnum = (__moff(heap, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
+		++extent->pagemap[pnum].bcount;
+	}
+
+	heap->buckets[ilog].freelist = *((memoff_t *)block);
+	heap->ubytes += bsize;
+
+	return block;
+}
+
+static int __free_block(struct shared_heap *heap, void *block);
+
+/*
+ * Per-thread caches of small blocks from the main heap. A cached
+ * block is still accounted as busy by the heap, so that we may hand
+ * it out again or take it back without grabbing the heap lock. The
+ * caches are refilled and drained by batches, under a single lock
+ * hold. Nested heaps are not cached, since their users depend on
+ * exact accounting to detect memory shortage.
+ *
+ * Thread-specific data destructors do not run for the main thread or
+ * for the threads still alive at exit(), so all caches are also
+ * linked to a process-wide list, which is flushed at exit. Only
+ * that final flush may race with the owner, so a cache is not
+ * guarded by a lock but by a state word, which the owner flips with
+ * a single atomic swap on entry and exit. A flush finding the cache
+ * busy leaves the draining to the owner, which notices upon exit.
+ * Cached blocks escape the heap checks, so debug builds look for
+ * double frees in the cache itself.
+ */
+#define HOBJ_TLCACHE_DEPTH	16
+#define HOBJ_TLCACHE_BATCH	(HOBJ_TLCACHE_DEPTH / 2)
+#define HOBJ_TLCACHE_NBINS	(HOBJ_PAGE_SHIFT - HOBJ_MINLOG2)
+
+#define CACHE_IDLE	0
+#define CACHE_BUSY	1
+#define CACHE_FLUSH	2	/* Flush requested while busy. */
+#define CACHE_RETIRED	3
+
+struct block_cache {
+	int state;
+	struct pvholder next;
+	struct {
+		void *head;
+		int count;
+	} bins[HOBJ_TLCACHE_NBINS];
+};
+
+static pthread_key_t block_cache_key;
+
+static pthread_once_t block_cache_once = PTHREAD_ONCE_INIT;
+
+static int block_cache_live;
+
+static pthread_mutex_t block_cache_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static DEFINE_PRIVATE_LIST(block_cache_list);
+
+#ifdef HAVE_TLS
+
+static __thread __attribute__ ((tls_model (CONFIG_XENO_TLS_MODEL)))
+struct block_cache *block_cache_current;
+
+static inline struct block_cache *__get_block_cache(void)
+{
+	return block_cache_current;
+}
+
+static inline void set_block_cache(struct block_cache *cache)
+{
+	block_cache_current = cache;
+	pthread_setspecific(block_cache_key, cache);
+}
+
+#else /* !HAVE_TLS */
+
+static inline struct block_cache *__get_block_cache(void)
+{
+	return pthread_getspecific(block_cache_key);
+}
+
+static inline void set_block_cache(struct block_cache *cache)
+{
+	pthread_setspecific(block_cache_key, cache);
+}
+
+#endif /* !HAVE_TLS */
+
+static struct block_cache *get_block_cache(void)
+{
+	struct block_cache *cache;
+
+	cache = __get_block_cache();
+	if (cache || !block_cache_live)
+		goto out;
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+
+	__STD(pthread_mutex_lock(&block_cache_list_lock));
+	pvlist_append(&cache->next, &block_cache_list);
+	__STD(pthread_mutex_unlock(&block_cache_list_lock));
+
+	set_block_cache(cache);
+out:
+	/*
+	 * Grab the cache for the caller, unless it was flushed for
+	 * good at exit, in which case the heap must be used directly.
+	 */
+	if (cache &&
+	    atomic_cmp_swap(&cache->state, CACHE_IDLE, CACHE_BUSY) != CACHE_IDLE)
+		return NULL;
+
+	return cache;
+}
+
+/* Must be called with heap->lock held. */
+static void __drain_cache_bin(struct shared_heap *heap,
+			      struct block_cache *cache,
+			      int ilog, int count)
+{
+	void *block;
+
+	while (count-- > 0) {
+		block = cache->bins[ilog].head;
+		cache->bins[ilog].head = *((void **)block);
+		cache->bins[ilog].count--;
+		__free_block(heap, block);
+	}
+}
+
+static void flush_block_cache(struct block_cache *cache)
+{
+	struct shared_heap *heap = &main_heap.base;
+	int ilog;
+
+	write_lock_nocancel(&heap->lock);
+
+	for (ilog = 0; ilog < HOBJ_TLCACHE_NBINS; ilog++)
+		__drain_cache_bin(heap, cache, ilog, cache->bins[ilog].count);
+
+	write_unlock(&heap->lock);
+}
+
+static inline void put_block_cache(struct block_cache *cache)
+{
+	/* Drain the cache on behalf of a flush which found it busy. */
+	if (atomic_cmp_swap(&cache->state, CACHE_BUSY, CACHE_IDLE) != CACHE_BUSY) {
+		flush_block_cache(cache);
+		cache->state = CACHE_RETIRED;
+	}
+}
+
+static void release_block_cache(void *p)
+{
+	struct block_cache *cache = p;
+
+#ifdef HAVE_TLS
+	block_cache_current = NULL;
+#endif
+	__STD(pthread_mutex_lock(&block_cache_list_lock));
+	pvlist_remove(&cache->next);
+	__STD(pthread_mutex_unlock(&block_cache_list_lock));
+
+	/* The main heap may be gone already, drop the blocks then. */
+	if (block_cache_live && cache->state == CACHE_IDLE)
+		flush_block_cache(cache);
+
+	free(cache);
+}
+
+static void flush_all_block_caches(void)
+{
+	struct block_cache *cache;
+
+	__STD(pthread_mutex_lock(&block_cache_list_lock));
+
+	if (block_cache_live) {
+		pvlist_for_each_entry(cache, &block_cache_list, next) {
+			if (atomic_cmp_swap(&cache->state, CACHE_IDLE,
+					    CACHE_RETIRED) == CACHE_IDLE)
+				flush_block_cache(cache);
+			else
+				atomic_cmp_swap(&cache->state, CACHE_BUSY,
+						CACHE_FLUSH);
+		}
+		block_cache_live = 0;
+	}
+
+	__STD(pthread_mutex_unlock(&block_cache_list_lock));
+}
+
+static void forget_block_cache(void)
+{
+	/*
+	 * The child must neither reuse nor flush the blocks cached
+	 * by the parent threads, which still own them.
+	 */
+	set_block_cache(NULL);
+	__STD(pthread_mutex_init(&block_cache_list_lock, NULL));
+	pvlist_init(&block_cache_list);
+}
+
+static void init_block_cache_key(void)
+{
+	pthread_key_create(&block_cache_key, release_block_cache);
+	pthread_atfork(NULL, NULL, forget_block_cache);
+	atexit(flush_all_block_caches);
+}
+
+static void *cache_alloc_block(struct shared_heap *heap, int log2size)
+{
+	int ilog = log2size - HOBJ_MINLOG2, n;
+	struct block_cache *cache;
+	caddr_t block;
+
+	cache = get_block_cache();
+	if (cache == NULL)
+		return NULL;
+
+	if (cache->bins[ilog].head == NULL) {
+		write_lock_nocancel(&heap->lock);
+		for (n = 0; n < HOBJ_TLCACHE_BATCH; n++) {
+			block = __alloc_bucket_block(heap, log2size);
+			if (block == NULL)
+				break;
+			*((void **)block) = cache->bins[ilog].head;
+			cache->bins[ilog].head = block;
+			cache->bins[ilog].count++;
+		}
+		write_unlock(&heap->lock);
+		if (n == 0) {
+			put_block_cache(cache);
+			return NULL;
+		}
+	}
+
+	block = cache->bins[ilog].head;
+	cache->bins[ilog].head = *((void **)block);
+	cache->bins[ilog].count--;
+	put_block_cache(cache);
+
+	return block;
+}
+
+static int cache_free_block(struct shared_heap *heap, void *block)
+{
+	struct shared_extent *extent;
+	struct block_cache *cache;
+	size_t pnum, boffset;
+	int log2size, ilog;
+
+	/*
+	 * The extent list of the main heap never changes, and the
+	 * page map entry of a busy block is stable until the block is
+	 * released, so peeking at both locklessly is safe. Anything
+	 * but a valid small block start goes through the slow path.
+	 */
+	extent = find_extent(heap, block);
+	if (extent == NULL)
+		return 0;
+
+	pnum = (__moff(heap, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
+	log2size = extent->pagemap[pnum].type;
+	if (log2size < HOBJ_MINLOG2 || log2size >= HOBJ_PAGE_SHIFT)
+		return 0;
+
+	boffset = (__moff(heap, block) -
+		   (extent->membase + (pnum << HOBJ_PAGE_SHIFT)));
+	if ((boffset & ((1 << log2size) - 1)) != 0)
+		return 0;
+
+	cache = get_block_cache();
+	if (cache == NULL)
+		return 0;
+
+	ilog = log2size - HOBJ_MINLOG2;
+#ifdef __XENO_DEBUG__
+	{
+		void *p;
+		/* A block we already hold was freed twice. */
+		for (p = cache->bins[ilog].head; p; p = *((void **)p)) {
+			if (p == block) {
+				put_block_cache(cache);
+				return -EINVAL;
+			}
+		}
+	}
+#endif
+	if (cache->bins[ilog].count >= HOBJ_TLCACHE_DEPTH) {
+		write_lock_nocancel(&heap->lock);
+		__drain_cache_bin(heap, cache, ilog, HOBJ_TLCACHE_BATCH);
+		write_unlock(&heap->lock);
+	}
+
+	*((void **)block) = cache->bins[ilog].head;
+	cache->bins[ilog].head = block;
+	cache->bins[ilog].count++;
+	put_block_cache(cache);
+
+	return 1;
+}
+
+static void *alloc_block(struct shared_heap *heap, size_t size)
+{
+	caddr_t block;
+
 	if (size == 0)
 		return NULL;
 
@@ -323,44 +707,14 @@ static void *alloc_block(struct shared_heap *heap, size_t size)
 	 * blocks.
 	 */
 	if (size <= HOBJ_PAGE_SIZE * 2) {
-		/*
-		 * Find the first power of two greater or equal to the
-		 * rounded size. The log2 value of this size is also
-		 * computed.
-		 */
-		for (bsize = (1 << HOBJ_MINLOG2), log2size = HOBJ_MINLOG2;
-		     bsize < size; bsize <<= 1, log2size++)
-			;	/* Loop */
-
-		ilog = log2size - HOBJ_MINLOG2;
-
-		write_lock_nocancel(&heap->lock);
-
-		block = __mref_check(heap, heap->buckets[ilog].freelist);
-		if (block == NULL) {
-			block = get_free_range(heap, bsize, log2size);
-			if (block == NULL)
-				goto done;
-			if (bsize <= HOBJ_PAGE_SIZE)
-				heap->buckets[ilog].fcount += (HOBJ_PAGE_SIZE >> log2size) - 1;
-		} else {
-			if (bsize <= HOBJ_PAGE_SIZE)
-				--heap->buckets[ilog].fcount;
-
-			/* Search for the source extent of block. */
-			__list_for_each_entry(heap, extent, &heap->extents, link) {
-				if (__moff(heap, block) >= extent->membase &&
-				    __moff(heap, block) < extent->memlim)
-					goto found;
-			}
-			assert(0);
-		found:
-			pnum = (__moff(heap, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
-			++extent->pagemap[pnum].bcount;
+		/* Only sub-page buckets are cached. */
+		if (size <= HOBJ_PAGE_SIZE / 2 && heap == &main_heap.base) {
+			block = cache_alloc_block(heap, bucket_log2size(size));
+			if (block)
+				return block;
 		}
-
-		heap->buckets[ilog].freelist = *((memoff_t *)block);
-		heap->ubytes += bsize;
+		write_lock_nocancel(&heap->lock);
+		block = __alloc_bucket_block(heap, bucket_log2size(size));
 	} else {
 		if (size > heap->maxcont)
 			return NULL;
@@ -372,13 +726,14 @@ static void *alloc_block(struct shared_heap *heap, size_t size)
 		if (block)
 			heap->ubytes += size;
 	}
-done:
+
 	write_unlock(&heap->lock);
 
 	return block;
 }
 
-static int free_block(struct shared_heap *heap, void *block)
+/* Must be called with heap->lock held. */
+static int __free_block(struct shared_heap *heap, void *block)
 {
 	caddr_t freepage, lastpage, nextpage, tailpage, freeptr;
 	int log2size, ret = 0, nblocks, xpage, ilog;
@@ -386,21 +741,14 @@ static int free_block(struct shared_heap *heap, void *block)
 	struct shared_extent *extent;
 	memoff_t *tailptr;
 
-	write_lock_nocancel(&heap->lock);
-
 	/*
 	 * Find the extent from which the returned block is
 	 * originating from.
 	 */
-	__list_for_each_entry(heap, extent, &heap->extents, link) {
-		if (__moff(heap, block) >= extent->membase &&
-		    __moff(heap, block) < extent->memlim)
-			goto found;
-	}
+	extent = find_extent(heap, block);
+	if (extent == NULL)
+		return -EFAULT;
 
-	ret = -EFAULT;
-	goto out;
-found:
 	/* Compute the heading page number in the page map. */
 	pnum = (__moff(heap, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
 	boffset = (__moff(heap, block) -
@@ -464,6 +812,7 @@ found:
 		if (--extent->pagemap[pnum].bcount > 0) {
 			/* Return the block to the bucketed memory space. */
 			*((memoff_t *)block) = heap->buckets[ilog].freelist;
+			set_block_extent(heap, block, extent);
 			heap->buckets[ilog].freelist = __moff(heap, block);
 			++heap->buckets[ilog].fcount;
 			break;
@@ -526,6 +875,21 @@ found:
 
 	heap->ubytes -= bsize;
 out:
+	return ret;
+}
+
+static int free_block(struct shared_heap *heap, void *block)
+{
+	int ret;
+
+	if (heap == &main_heap.base) {
+		ret = cache_free_block(heap, block);
+		if (ret)
+			return ret < 0 ? __bt(ret) : 0;
+	}
+
+	write_lock_nocancel(&heap->lock);
+	ret = __free_block(heap, block);
 	write_unlock(&heap->lock);
 
 	return __bt(ret);
@@ -542,13 +906,10 @@ static size_t check_block(struct shared_heap *heap, void *block)
 	/*
 	 * Find the extent the checked block is originating from.
 	 */
-	__list_for_each_entry(heap, extent, &heap->extents, link) {
-		if (__moff(heap, block) >= extent->membase &&
-		    __moff(heap, block) < extent->memlim)
-			goto found;
-	}
-	goto out;
-found:
+	extent = find_extent(heap, block);
+	if (extent == NULL)
+		goto out;
+
 	/* Compute the heading page number in the page map. */
 	pnum = (__moff(heap, block) - extent->membase) >> HOBJ_PAGE_SHIFT;
 	ptype = extent->pagemap[pnum].type;
@@ -653,6 +1014,8 @@ done:
 	__STD(close(fd));
 	hobj->size = size;
 	__main_catalog = &m_heap->catalog;
+	pthread_once(&block_cache_once, init_block_cache_key);
+	block_cache_live = 1;
 
 	return 0;
 unlink_fail:
@@ -818,6 +1181,9 @@ void heapobj_destroy(struct heapobj *hobj)
 	struct shared_heap *heap = hobj->pool;
 	int cpid;
 
+	if (hobj == &main_pool)
+		flush_all_block_caches();
+
 	__RT(pthread_mutex_destroy(&heap->lock));
 
 	if (hobj != &main_pool) {
@@ -140,6 +140,9 @@ int semobj_init(struct semobj *smobj, int flags, int value,
 	if (flags & SEMOBJ_PRIO)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (flags & SEMOBJ_ADAPTIVE)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	/*
 	 * We need a trampoline for finalizing a semobj, to escalate
 	 * from a basic syncobj we receive to the semobj container.
@@ -163,19 +166,63 @@ int semobj_destroy(struct semobj *smobj)
 	return syncobj_destroy(&smobj->core.sobj, &syns);
 }
 
+/*
+ * The semaphore count is maintained atomically, so that posting to a
+ * semaphore nobody waits for, or grabbing an available unit, does
+ * not require to enter the monitor. A negative count denotes
+ * sleepers; since such value may only be reached and left with the
+ * monitor held, the fast paths bail out to the slow ones whenever
+ * they observe it.
+ */
+static int post_fast(struct semobj *smobj)
+{
+	int value, old;
+
+	value = ACCESS_ONCE(smobj->core.value);
+	while (value >= 0) {
+		if (smobj->core.flags & SEMOBJ_PULSE)
+			return 0;
+		old = value;
+		value = atomic_cmp_swap(&smobj->core.value, old, old + 1);
+		if (value == old)
+			return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static int wait_fast(struct semobj *smobj)
+{
+	int value, old;
+
+	value = ACCESS_ONCE(smobj->core.value);
+	while (value > 0) {
+		old = value;
+		value = atomic_cmp_swap(&smobj->core.value, old, old - 1);
+		if (value == old)
+			return 0;
+	}
+
+	return -EWOULDBLOCK;
+}
+
 int semobj_post(struct semobj *smobj)
 {
 	struct syncstate syns;
 	int ret;
 
+	if (post_fast(smobj) == 0)
+		return 0;
+
 	ret = syncobj_lock(&smobj->core.sobj, &syns);
 	if (ret)
 		return ret;
 
-	if (++smobj->core.value <= 0)
+	/* Sleepers may have timed out meanwhile. */
+	if (post_fast(smobj)) {
+		atomic_add_fetch(smobj->core.value, 1);
 		syncobj_grant_one(&smobj->core.sobj);
-	else if (smobj->core.flags & SEMOBJ_PULSE)
-		smobj->core.value = 0;
+	}
 
 	syncobj_unlock(&smobj->core.sobj, &syns);
 
@@ -187,6 +234,9 @@ int semobj_broadcast(struct semobj *smobj)
 	struct syncstate syns;
 	int ret;
 
+	if (ACCESS_ONCE(smobj->core.value) >= 0)
+		return 0;
+
 	ret = syncobj_lock(&smobj->core.sobj, &syns);
 	if (ret)
 		return ret;
@@ -206,25 +256,27 @@ int semobj_wait(struct semobj *smobj, const struct timespec *timeout)
 	struct syncstate syns;
 	int ret = 0;
 
+	if (wait_fast(smobj) == 0)
+		return 0;
+
 	ret = syncobj_lock(&smobj->core.sobj, &syns);
 	if (ret)
 		return ret;
 
-	if (--smobj->core.value >= 0)
-		goto done;
-
 	if (timeout &&
 	    timeout->tv_sec == 0 && timeout->tv_nsec == 0) {
-		smobj->core.value++;
-		ret = -EWOULDBLOCK;
+		ret = wait_fast(smobj);
 		goto done;
 	}
 
 	if (!threadobj_current_p()) {
-		ret = -EPERM;
+		ret = wait_fast(smobj) ? -EPERM : 0;
 		goto done;
 	}
 
+	if (atomic_sub_fetch(smobj->core.value, 1) >= 0)
+		goto done;
+
 	ret = syncobj_wait_grant(&smobj->core.sobj, timeout, &syns);
 	if (ret) {
 		/*
@@ -235,7 +287,8 @@ int semobj_wait(struct semobj *smobj, const struct timespec *timeout)
 		if (ret == -EIDRM)
 			return ret;
 
-		smobj->core.value++; /* Fix up semaphore count. */
+		/* Fix up semaphore count. */
+		atomic_add_fetch(smobj->core.value, 1);
 	}
 done:
 	syncobj_unlock(&smobj->core.sobj, &syns);
@@ -250,7 +303,7 @@ int semobj_getvalue(struct semobj *smobj, int *sval)
 	if (syncobj_lock(&smobj->core.sobj, &syns))
 		return -EINVAL;
 
-	*sval = smobj->core.value;
+	*sval = ACCESS_ONCE(smobj->core.value);
 
 	syncobj_unlock(&smobj->core.sobj, &syns);
 
@@ -18,9 +18,11 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <unistd.h>
 #include "boilerplate/lock.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/syncobj.h"
+#include "copperplate/clockobj.h"
 #include "copperplate/debug.h"
 #include "internal.h"
 
@@ -211,10 +213,81 @@ static inline void syncobj_cleanup_corespec(struct syncobj *sobj)
 
 #endif	/* CONFIG_XENO_MERCURY */
 
+/*
+ * Adaptive waits: a thread about to sleep on a syncobj created with
+ * SYNCOBJ_ADAPTIVE first leaves the monitor and polls for a grant
+ * for a short while. This saves a full sleep/wakeup round trip when
+ * the resource is released shortly after by a thread running on
+ * another CPU.
+ *
+ * The spin budget is twice a running average of the recent spin
+ * outcomes, up to SYNCOBJ_SPIN_MAX nanoseconds. A failed spin
+ * counts as a long wait, which stops further spinning once the
+ * average exceeds the bound. The average then decays each time we
+ * sleep, until we probe again. We never spin past the caller's
+ * timeout.
+ */
+#define SYNCOBJ_SPIN_MAX	20000	/* ns */
+
+static int spin_wait(struct syncobj *sobj, struct threadobj *current,
+		     const struct timespec *timeout)
+{
+	struct timespec ts, delta;
+	ticks_t start, now, end;
+	int budget, sample;
+
+	if (sobj->spin_avg > SYNCOBJ_SPIN_MAX) {
+		sobj->spin_avg -= sobj->spin_avg / 8;
+		return 0;
+	}
+
+	budget = sobj->spin_avg * 2;
+	if (budget > SYNCOBJ_SPIN_MAX)
+		budget = SYNCOBJ_SPIN_MAX;
+
+	if (timeout) {
+		__RT(clock_gettime(CLOCK_COPPERPLATE, &ts));
+		if (!timespec_before(&ts, timeout))
+			return 0;
+		timespec_sub(&delta, timeout, &ts);
+		if (timespec_scalar(&delta) < budget)
+			budget = timespec_scalar(&delta);
+	}
+
+	start = clockobj_get_tsc();
+	end = start + clockobj_ns_to_tsc(budget);
+
+	__syncobj_tag_unlocked(sobj);
+	monitor_exit(sobj);
+
+	do {
+		cpu_relax();
+		now = clockobj_get_tsc();
+	} while (ACCESS_ONCE(current->wait_sobj) && now < end);
+
+	/* Can't fail, waiters prevent the monitor from vanishing. */
+	monitor_enter(sobj);
+	__syncobj_tag_locked(sobj);
+
+	if (current->wait_sobj)
+		sample = SYNCOBJ_SPIN_MAX * 2;
+	else
+		sample = clockobj_tsc_to_ns(now - start);
+
+	sobj->spin_avg += (sample - sobj->spin_avg) / 8;
+
+	return current->wait_sobj == NULL;
+}
+
 void syncobj_init(struct syncobj *sobj, clockid_t clk_id, int flags,
 		  fnref_type(void (*)(struct syncobj *sobj)) finalizer)
 {
+	/* Spinning is pointless unless the granter may run in parallel. */
+	if ((flags & SYNCOBJ_ADAPTIVE) && sysconf(_SC_NPROCESSORS_ONLN) < 2)
+		flags &= ~SYNCOBJ_ADAPTIVE;
+
 	sobj->flags = flags;
+	sobj->spin_avg = SYNCOBJ_SPIN_MAX / 2;
 	list_init(&sobj->grant_list);
 	list_init(&sobj->drain_list);
 	sobj->grant_count = 0;
@@ -485,15 +558,18 @@ int syncobj_wait_grant(struct syncobj *sobj, const struct timespec *timeout,
 	 * cancelability disabled (in syncobj_lock); re-enable it
 	 * before pending on the condvar.
 	 */
+	if (sobj->flags & SYNCOBJ_ADAPTIVE)
+		spin_wait(sobj, current, timeout);
+
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
 	assert(state == PTHREAD_CANCEL_DISABLE);
 
-	do {
+	/* Check for spurious wake up. */
+	for (ret = 0; ret == 0 && current->wait_sobj;) {
 		__syncobj_tag_unlocked(sobj);
 		ret = monitor_wait_grant(sobj, current, timeout);
 		__syncobj_tag_locked(sobj);
-		/* Check for spurious wake up. */
-	} while (ret == 0 && current->wait_sobj);
+	}
 
 	pthread_setcancelstate(state, NULL);
 
@@ -518,6 +594,9 @@ int syncobj_wait_drain(struct syncobj *sobj, const struct timespec *timeout,
 	sobj->drain_count++;
 	sobj->wait_count++;
 
+	if (sobj->flags & SYNCOBJ_ADAPTIVE)
+		spin_wait(sobj, current, timeout);
+
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
 	assert(state == PTHREAD_CANCEL_DISABLE);
 
@@ -527,11 +606,11 @@ int syncobj_wait_drain(struct syncobj *sobj, const struct timespec *timeout,
 	 * threads. Therefore the caller must check that the drain
 	 * condition is still true before proceeding.
 	 */
-	do {
+	for (ret = 0; ret == 0 && current->wait_sobj;) {
 		__syncobj_tag_unlocked(sobj);
 		ret = monitor_wait_drain(sobj, current, timeout);
 		__syncobj_tag_locked(sobj);
-	} while (ret == 0 && current->wait_sobj);
+	}
 
 	pthread_setcancelstate(state, NULL);
 
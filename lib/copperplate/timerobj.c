@@ -19,6 +19,7 @@
  */
 
 #include <signal.h>
+#include <stdio.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -35,13 +36,41 @@
 #include "copperplate/debug.h"
 #include "internal.h"
 
-static pthread_mutex_t svlock;
-
-static pthread_t svthread;
-
-static pid_t svpid;
+/*
+ * Armed timers are indexed by a hashed timing wheel: each slot spans
+ * 2^TIMER_WHEEL_SHIFT nanoseconds, and links the timers expiring
+ * within any tick hashing to it, in no particular order. Starting or
+ * stopping a timer is O(1), periodic timers are simply moved to the
+ * slot of their next shot. On each notification, the server only
+ * visits the slots it went past since the previous scan, checking
+ * the exact expiry date of every timer found there.
+ */
+#define TIMER_WHEEL_SHIFT	20	/* ~1ms per slot */
+#define TIMER_WHEEL_SIZE	256	/* ~268ms per round */
+#define TIMER_WHEEL_MASK	(TIMER_WHEEL_SIZE - 1)
 
-static DEFINE_PRIVATE_LIST(svtimers);
+/*
+ * Handlers are run by a pool of server threads, each serializing
+ * the handlers of the timers it serves. A server is spawned on
+ * demand for every (CPU, priority) pair timers are created for, so
+ * that a slow handler only delays the timers sharing its server, and
+ * a high priority server always preempts the lower ones.
+ */
+struct timerserver {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	pid_t pid;
+	int cpu;		/* -1 if not pinned */
+	int prio;
+	struct pvlist wheel[TIMER_WHEEL_SIZE];
+	/* Tick of the earliest slot which may hold expired timers. */
+	sticks_t tick;
+	struct pvholder next;
+};
+
+static pthread_mutex_t svpool_lock;
+
+static DEFINE_PRIVATE_LIST(svpool);
 
 #ifdef CONFIG_XENO_COBALT
 
@@ -67,36 +96,72 @@ static inline void timersv_init_corespec(const char *name)
 
 #endif /* CONFIG_XENO_MERCURY */
 
-/*
- * XXX: at some point, we may consider using a timer wheel instead of
- * a simple linked list to index timers. The latter method is
- * efficient for up to ten outstanding timers or so, which should be
- * enough for most applications. However, there exist poorly designed
- * apps involving dozens of active timers, particularly in the legacy
- * embedded world.
- */
-static void timerobj_enqueue(struct timerobj *tmobj)
+static inline sticks_t timerobj_tick(const struct timespec *ts)
 {
-	struct timerobj *__tmobj;
+	return timespec_scalar(ts) >> TIMER_WHEEL_SHIFT;
+}
 
-	if (pvlist_empty(&svtimers)) {
-		pvlist_append(&tmobj->next, &svtimers);
-		return;
-	}
+static void timerobj_enqueue(struct timerserver *sv, struct timerobj *tmobj)
+{
+	sticks_t tick;
 
-	pvlist_for_each_entry_reverse(__tmobj, &svtimers, next) {
-		if (timespec_before_or_same(&__tmobj->itspec.it_value,
-					    &tmobj->itspec.it_value))
-			break;
+	/*
+	 * A timer which should have elapsed already goes to the
+	 * slot the server will look at first, otherwise it would
+	 * wait for the wheel to wrap.
+	 */
+	tick = timerobj_tick(&tmobj->itspec.it_value);
+	if (tick < sv->tick)
+		tick = sv->tick;
+
+	pvlist_append(&tmobj->next, &sv->wheel[tick & TIMER_WHEEL_MASK]);
+}
+
+/*
+ * Move all timers which have elapsed at @now to the @expired list,
+ * advancing the wheel up to the current tick.
+ */
+static void timerobj_collect(struct timerserver *sv,
+			     struct timespec *now, struct pvlist *expired)
+{
+	sticks_t tick, last = timerobj_tick(now);
+	struct timerobj *tmobj, *tmp;
+	struct pvlist *slot;
+	int n;
+
+	for (tick = sv->tick, n = 0;
+	     tick <= last && n < TIMER_WHEEL_SIZE; tick++, n++) {
+		slot = &sv->wheel[tick & TIMER_WHEEL_MASK];
+		pvlist_for_each_entry_safe(tmobj, tmp, slot, next) {
+			if (timespec_before_or_same(&tmobj->itspec.it_value,
+						    now)) {
+				pvlist_remove_init(&tmobj->next);
+				pvlist_append(&tmobj->next, expired);
+			}
+		}
 	}
 
-	atpvh(&__tmobj->next, &tmobj->next);
+	/* The current slot may still hold timers for later. */
+	sv->tick = last;
 }
 
 static int server_prologue(void *arg)
 {
-	svpid = copperplate_get_tid();
-	timersv_init_corespec("timer-internal");
+	struct timerserver *sv = arg;
+	char name[32];
+	cpu_set_t cpuset;
+
+	sv->pid = copperplate_get_tid();
+
+	if (sv->cpu >= 0) {
+		CPU_ZERO(&cpuset);
+		CPU_SET(sv->cpu, &cpuset);
+		pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+		snprintf(name, sizeof(name), "timer-internal/%d", sv->cpu);
+	} else
+		snprintf(name, sizeof(name), "timer-internal");
+
+	timersv_init_corespec(name);
 	threadobj_set_current(THREADOBJ_IRQCONTEXT);
 
 	return 0;
@@ -105,78 +170,183 @@ static int server_prologue(void *arg)
 static void *timerobj_server(void *arg)
 {
 	struct timespec now, value, interval;
-	struct timerobj *tmobj, *tmp;
+	struct timerserver *sv = arg;
+	struct timerobj *tmobj;
+	struct pvlist expired;
 	sigset_t set;
 	int sig, ret;
 
 	sigemptyset(&set);
 	sigaddset(&set, SIGALRM);
+	pvlist_init(&expired);
 
 	for (;;) {
 		ret = __RT(sigwait(&set, &sig));
 		if (ret && ret != -EINTR)
 			break;
 		/*
-		 * We have a single server thread for now, so handlers
-		 * are fully serialized.
+		 * Handlers of the timers attached to this server are
+		 * fully serialized.
 		 */
-		write_lock_nocancel(&svlock);
-
-		__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
+		write_lock_nocancel(&sv->lock);
 
-		pvlist_for_each_entry_safe(tmobj, tmp, &svtimers, next) {
-			value = tmobj->itspec.it_value;
-			if (timespec_after(&value, &now))
+		for (;;) {
+			__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
+			timerobj_collect(sv, &now, &expired);
+			if (pvlist_empty(&expired))
 				break;
-			pvlist_remove_init(&tmobj->next);
-			interval = tmobj->itspec.it_interval;
-			if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
-				timespec_add(&tmobj->itspec.it_value,
-					     &value, &interval);
-				timerobj_enqueue(tmobj);
+			/*
+			 * Handlers may stop or restart any timer while
+			 * the lock is dropped, including those still
+			 * pending on the expired list, so we pop them
+			 * one at a time. Then we go back checking for
+			 * timers which elapsed in the meantime.
+			 */
+			while (!pvlist_empty(&expired)) {
+				tmobj = pvlist_pop_entry(&expired,
+							 struct timerobj, next);
+				value = tmobj->itspec.it_value;
+				interval = tmobj->itspec.it_interval;
+				if (interval.tv_sec > 0 || interval.tv_nsec > 0) {
+					timespec_add(&tmobj->itspec.it_value,
+						     &value, &interval);
+					timerobj_enqueue(sv, tmobj);
+				}
+				write_unlock(&sv->lock);
+				tmobj->handler(tmobj);
+				write_lock_nocancel(&sv->lock);
 			}
-			write_unlock(&svlock);
-			tmobj->handler(tmobj);
-			write_lock_nocancel(&svlock);
 		}
 
-		write_unlock(&svlock);
+		write_unlock(&sv->lock);
 	}
 
 	return NULL;
 }
 
-static int timerobj_spawn_server(void)
+static int timerobj_spawn_server(struct timerserver *sv)
 {
 	struct corethread_attributes cta;
-	int ret = 0;
+	pthread_mutexattr_t mattr;
+	struct timespec now;
+	int ret, n;
 
-	push_cleanup_lock(&svlock);
-	write_lock(&svlock);
+	__RT(pthread_mutexattr_init(&mattr));
+	__RT(pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT));
+	__RT(pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE));
+	__RT(pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE));
+	ret = __RT(pthread_mutex_init(&sv->lock, &mattr));
+	__RT(pthread_mutexattr_destroy(&mattr));
+	if (ret)
+		return __bt(-ret);
 
-	if (svthread)
-		goto out;
+	for (n = 0; n < TIMER_WHEEL_SIZE; n++)
+		pvlist_init(sv->wheel + n);
 
-	cta.prio = threadobj_irq_prio;
+	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
+	sv->tick = timerobj_tick(&now);
+
+	cta.prio = sv->prio;
 	cta.prologue = server_prologue;
 	cta.run = timerobj_server;
-	cta.arg = NULL;
+	cta.arg = sv;
 	cta.stacksize = PTHREAD_STACK_MIN * 16;
 	cta.detachstate = PTHREAD_CREATE_DETACHED;
-	ret = __bt(copperplate_create_thread(&cta, &svthread));
+	ret = __bt(copperplate_create_thread(&cta, &sv->thread));
+	if (ret)
+		__RT(pthread_mutex_destroy(&sv->lock));
+
+	return ret;
+}
+
+static int timerobj_get_server(int cpu, int prio, struct timerserver **svp)
+{
+	struct timerserver *sv;
+	int ret = 0;
+
+	push_cleanup_lock(&svpool_lock);
+	write_lock(&svpool_lock);
+
+	pvlist_for_each_entry(sv, &svpool, next) {
+		if (sv->cpu == cpu && sv->prio == prio)
+			goto out;
+	}
+
+	sv = malloc(sizeof(*sv));
+	if (sv == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	sv->cpu = cpu;
+	sv->prio = prio;
+	ret = timerobj_spawn_server(sv);
+	if (ret) {
+		free(sv);
+		goto out;
+	}
+
+	pvlist_append(&sv->next, &svpool);
 out:
-	write_unlock(&svlock);
-	pop_cleanup_lock(&svlock);
+	write_unlock(&svpool_lock);
+	pop_cleanup_lock(&svpool_lock);
+
+	if (ret == 0)
+		*svp = sv;
 
 	return ret;
 }
 
+/*
+ * Timers created by a thread bound to a single CPU are served on
+ * that CPU, others share an unpinned server.
+ */
+static int timerobj_creator_cpu(void)
+{
+	cpu_set_t cpuset;
+	int cpu;
+
+	if (pthread_getaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+		return -1;
+
+	if (CPU_COUNT(&cpuset) != 1)
+		return -1;
+
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &cpuset))
+			return cpu;
+	}
+
+	return -1;
+}
+
 int timerobj_init(struct timerobj *tmobj)
+{
+	return __bt(timerobj_init_server(tmobj, TIMEROBJ_CPU_AUTO,
+					  TIMEROBJ_PRIO_DEFAULT));
+}
+
+int timerobj_init_server(struct timerobj *tmobj, int cpu, int prio)
 {
 	pthread_mutexattr_t mattr;
+	struct timerserver *sv;
 	struct sigevent sev;
 	int ret;
 
+	if (cpu == TIMEROBJ_CPU_AUTO)
+		cpu = timerobj_creator_cpu();
+	else if (cpu < 0 || cpu >= CPU_SETSIZE)
+		cpu = -1;
+
+	/*
+	 * The lowest thread priorities normalize to zero, which must
+	 * map to the lowest server, not to the default one.
+	 */
+	if (prio == TIMEROBJ_PRIO_DEFAULT || prio > threadobj_irq_prio)
+		prio = threadobj_irq_prio;
+	else if (prio < 1)
+		prio = 1;
+
 	/*
 	 * XXX: We need a threaded handler so that we may invoke core
 	 * async-unsafe services from there (e.g. syncobj post
@@ -188,17 +358,18 @@ int timerobj_init(struct timerobj *tmobj)
 	 * very least), and spawning a short-lived thread at each
 	 * timeout expiration to run the handler is just overkill.
 	 */
-	ret = timerobj_spawn_server();
+	ret = timerobj_get_server(cpu, prio, &sv);
 	if (ret)
 		return __bt(ret);
 
+	tmobj->server = sv;
 	tmobj->handler = NULL;
 	pvholder_init(&tmobj->next); /* so we may use pvholder_linked() */
 
 	memset(&sev, 0, sizeof(sev));
 	sev.sigev_notify = SIGEV_THREAD_ID;
 	sev.sigev_signo = SIGALRM;
-	sev.sigev_notify_thread_id = svpid;
+	sev.sigev_notify_thread_id = sv->pid;
 
 	ret = __RT(timer_create(CLOCK_COPPERPLATE, &sev, &tmobj->timer));
 	if (ret)
@@ -216,12 +387,12 @@ int timerobj_init(struct timerobj *tmobj)
 
 void timerobj_destroy(struct timerobj *tmobj) /* lock held, dropped */
 {
-	write_lock_nocancel(&svlock);
+	write_lock_nocancel(&tmobj->server->lock);
 
 	if (pvholder_linked(&tmobj->next))
 		pvlist_remove_init(&tmobj->next);
 
-	write_unlock(&svlock);
+	write_unlock(&tmobj->server->lock);
 
 	__RT(timer_delete(tmobj->timer));
 	__RT(pthread_mutex_unlock(&tmobj->lock));
@@ -244,13 +415,17 @@ int timerobj_start(struct timerobj *tmobj,
 	 * happens to check the return code then drop the timer
 	 * (again).
 	 */
-	write_lock_nocancel(&svlock);
+	write_lock_nocancel(&tmobj->server->lock);
 
 	if (__RT(timer_settime(tmobj->timer, TIMER_ABSTIME, it, NULL)))
 		return __bt(-errno);
 
-	timerobj_enqueue(tmobj);
-	write_unlock(&svlock);
+	/* The timer might be restarted without being stopped. */
+	if (pvholder_linked(&tmobj->next))
+		pvlist_remove_init(&tmobj->next);
+
+	timerobj_enqueue(tmobj->server, tmobj);
+	write_unlock(&tmobj->server->lock);
 	timerobj_unlock(tmobj);
 
 	return 0;
@@ -260,12 +435,12 @@ int timerobj_stop(struct timerobj *tmobj) /* lock held, dropped */
 {
 	static const struct itimerspec itimer_stop;
 
-	write_lock_nocancel(&svlock);
+	write_lock_nocancel(&tmobj->server->lock);
 
 	if (pvholder_linked(&tmobj->next))
 		pvlist_remove_init(&tmobj->next);
 
-	write_unlock(&svlock);
+	write_unlock(&tmobj->server->lock);
 
 	__RT(timer_settime(tmobj->timer, 0, &itimer_stop, NULL));
 	tmobj->handler = NULL;
@@ -281,9 +456,8 @@ int timerobj_pkg_init(void)
 
 	__RT(pthread_mutexattr_init(&mattr));
 	__RT(pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT));
-	__RT(pthread_mutexattr_settype(&mattr, PTHREAD_MUTEX_RECURSIVE));
 	__RT(pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE));
-	ret = __RT(pthread_mutex_init(&svlock, &mattr));
+	ret = __RT(pthread_mutex_init(&svpool_lock, &mattr));
 	__RT(pthread_mutexattr_destroy(&mattr));
 
 	return __bt(-ret);
@@ -19,10 +19,12 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <copperplate/init.h>
 #include <copperplate/cluster.h>
+#include <copperplate/registry.h>
 #include <boilerplate/lock.h>
 #include <psos/psos.h>
 #include "internal.h"
@@ -32,20 +34,40 @@
 
 #define pt_align_mask   (sizeof(void *)-1)
 
+#define pt_block_index(pt,buf) \
+(((caddr_t)(buf) - (pt)->data) >> (pt)->bshift)
+
 #define pt_bitmap_pos(pt,n) \
 pt->bitmap[((n) / (sizeof(u_long) * 8))]
 
 #define pt_block_pos(n) \
 (1L << ((n) % (sizeof(u_long) * 8)))
 
-#define pt_bitmap_setbit(pt,n) \
-(pt_bitmap_pos(pt,n) |= pt_block_pos(n))
+/*
+ * The bitmap is updated atomically, since cached blocks are handed
+ * out and taken back without holding the partition lock.
+ */
+static inline void pt_bitmap_setbit(struct psos_pt *pt, u_long n)
+{
+	u_long *word = &pt_bitmap_pos(pt, n), old;
 
-#define pt_bitmap_clrbit(pt,n) \
-(pt_bitmap_pos(pt,n) &= ~pt_block_pos(n))
+	do
+		old = ACCESS_ONCE(*word);
+	while (atomic_cmp_swap(word, old, old | pt_block_pos(n)) != old);
+}
+
+static inline int pt_bitmap_tst_clrbit(struct psos_pt *pt, u_long n)
+{
+	u_long *word = &pt_bitmap_pos(pt, n), old;
 
-#define pt_bitmap_tstbit(pt,n) \
-(pt_bitmap_pos(pt,n) & pt_block_pos(n))
+	do {
+		old = ACCESS_ONCE(*word);
+		if ((old & pt_block_pos(n)) == 0)
+			return 0;
+	} while (atomic_cmp_swap(word, old, old & ~pt_block_pos(n)) != old);
+
+	return 1;
+}
 
 struct pvcluster psos_pt_table;
 
@@ -63,6 +85,31 @@ static unsigned long anon_ptids;
  * from cancellation points. You have been warned.
  */
 
+static void init_pi_lock(pthread_mutex_t *lock)
+{
+	pthread_mutexattr_t mattr;
+
+	__RT(pthread_mutexattr_init(&mattr));
+	__RT(pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT));
+	__RT(pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE));
+	__RT(pthread_mutex_init(lock, &mattr));
+	__RT(pthread_mutexattr_destroy(&mattr));
+}
+
+static int lock_pt(struct psos_pt *pt)
+{
+	int ret;
+
+	ret = __RT(pthread_mutex_trylock(&pt->lock));
+	if (ret == EBUSY) {
+		ret = __RT(pthread_mutex_lock(&pt->lock));
+		if (ret == 0)
+			pt->contended++;
+	}
+
+	return ret;
+}
+
 static struct psos_pt *get_pt_from_id(u_long ptid, int *err_r)
 {
 	struct psos_pt *pt = (struct psos_pt *)ptid;
@@ -79,7 +126,7 @@ static struct psos_pt *get_pt_from_id(u_long ptid, int *err_r)
 		goto objid_error;
 
 	if (pt->magic == pt_magic) {
-		if (__RT(pthread_mutex_lock(&pt->lock)) == 0) {
+		if (lock_pt(pt) == 0) {
 			if (pt->magic == pt_magic)
 				return pt;
 			__RT(pthread_mutex_unlock(&pt->lock));
@@ -108,6 +155,336 @@ static inline void put_pt(struct psos_pt *pt)
 	__RT(pthread_mutex_unlock(&pt->lock));
 }
 
+/*
+ * Per-thread magazines of free blocks. A thread may cache up to
+ * PT_MAGAZINE_DEPTH blocks from each of the last PT_CACHE_SLOTS
+ * partitions it used, which pt_getbuf() and pt_retbuf() serve
+ * without grabbing the partition lock. Magazines are refilled and
+ * drained by batches, under a single lock hold. A cached block is
+ * free from the user's standpoint (its bitmap bit is clear), but is
+ * off the partition freelist; a thread running out of blocks steals
+ * back the contents of the other magazines bound to the partition.
+ *
+ * Locking order is pt_cache_lock -> magazine lock -> partition
+ * lock. Binding a magazine to a partition, unbinding it and deleting
+ * the partition serialize on pt_cache_lock, and update the list of
+ * bound magazines with the partition lock held, so that holding
+ * either lock is enough for walking that list.
+ */
+#define PT_MAGAZINE_DEPTH	16
+#define PT_MAGAZINE_BATCH	(PT_MAGAZINE_DEPTH / 2)
+#define PT_CACHE_SLOTS		4
+
+struct pt_magazine {
+	pthread_mutex_t lock;
+	struct psos_pt *pt;
+	int count;
+	unsigned long hits;
+	struct pvholder next;
+	void *blocks[PT_MAGAZINE_DEPTH];
+};
+
+struct pt_cache {
+	struct pt_magazine mags[PT_CACHE_SLOTS];
+	int victim;
+};
+
+static pthread_mutex_t pt_cache_lock;
+
+static pthread_key_t pt_cache_key;
+
+static pthread_once_t pt_cache_once = PTHREAD_ONCE_INIT;
+
+#ifdef HAVE_TLS
+
+static __thread __attribute__ ((tls_model (CONFIG_XENO_TLS_MODEL)))
+struct pt_cache *pt_cache_current;
+
+static inline struct pt_cache *__get_pt_cache(void)
+{
+	return pt_cache_current;
+}
+
+static inline void set_pt_cache(struct pt_cache *cache)
+{
+	pt_cache_current = cache;
+	pthread_setspecific(pt_cache_key, cache);
+}
+
+#else /* !HAVE_TLS */
+
+static inline struct pt_cache *__get_pt_cache(void)
+{
+	return pthread_getspecific(pt_cache_key);
+}
+
+static inline void set_pt_cache(struct pt_cache *cache)
+{
+	pthread_setspecific(pt_cache_key, cache);
+}
+
+#endif /* !HAVE_TLS */
+
+/*
+ * pt->lock and mag->lock held. Blocks are handed out from the
+ * magazine in freelist order.
+ */
+static void fill_magazine(struct psos_pt *pt,
+			  struct pt_magazine *mag, int count)
+{
+	void *buf;
+	int n;
+
+	if (count > pt->nblks - pt->ublks)
+		count = pt->nblks - pt->ublks;
+
+	for (n = mag->count + count - 1; n >= mag->count; n--) {
+		buf = pt->freelist;
+		pt->freelist = *((void **)buf);
+		mag->blocks[n] = buf;
+	}
+
+	mag->count += count;
+	pt->ublks += count;
+}
+
+/* pt->lock and mag->lock held. Drains the least recently cached blocks. */
+static void drain_magazine(struct psos_pt *pt,
+			   struct pt_magazine *mag, int count)
+{
+	void *buf;
+	int n;
+
+	for (n = 0; n < count; n++) {
+		buf = mag->blocks[n];
+		*((void **)buf) = pt->freelist;
+		pt->freelist = buf;
+		pt->ublks--;
+	}
+
+	mag->count -= count;
+	memmove(mag->blocks, mag->blocks + count,
+		mag->count * sizeof(mag->blocks[0]));
+}
+
+/* pt->lock held. Magazines busy with their owner are skipped. */
+static void steal_magazines(struct psos_pt *pt, struct pt_magazine *self)
+{
+	struct pt_magazine *mag;
+
+	pvlist_for_each_entry(mag, &pt->magazines, next) {
+		if (mag == self || __RT(pthread_mutex_trylock(&mag->lock)))
+			continue;
+		drain_magazine(pt, mag, mag->count);
+		__RT(pthread_mutex_unlock(&mag->lock));
+	}
+}
+
+/* pt_cache_lock and mag->lock held. */
+static void unbind_magazine(struct pt_magazine *mag)
+{
+	struct psos_pt *pt = mag->pt;
+
+	lock_pt(pt);
+	drain_magazine(pt, mag, mag->count);
+	pvlist_remove(&mag->next);
+	pt->cachehits += mag->hits;
+	put_pt(pt);
+	mag->hits = 0;
+	mag->pt = NULL;
+}
+
+static void release_pt_cache(void *p)
+{
+	struct pt_cache *cache = p;
+	struct pt_magazine *mag;
+	int n;
+
+#ifdef HAVE_TLS
+	pt_cache_current = NULL;
+#endif
+	__RT(pthread_mutex_lock(&pt_cache_lock));
+
+	for (n = 0; n < PT_CACHE_SLOTS; n++) {
+		mag = cache->mags + n;
+		__RT(pthread_mutex_lock(&mag->lock));
+		if (mag->pt)
+			unbind_magazine(mag);
+		__RT(pthread_mutex_unlock(&mag->lock));
+		__RT(pthread_mutex_destroy(&mag->lock));
+	}
+
+	__RT(pthread_mutex_unlock(&pt_cache_lock));
+
+	free(cache);
+}
+
+static void init_pt_cache(void)
+{
+	init_pi_lock(&pt_cache_lock);
+	pthread_key_create(&pt_cache_key, release_pt_cache);
+}
+
+static struct pt_cache *get_pt_cache(void)
+{
+	struct pt_cache *cache;
+	int n;
+
+	cache = __get_pt_cache();
+	if (cache)
+		return cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL)
+		return NULL;
+
+	for (n = 0; n < PT_CACHE_SLOTS; n++)
+		init_pi_lock(&cache->mags[n].lock);
+
+	set_pt_cache(cache);
+
+	return cache;
+}
+
+/*
+ * Return the caller's magazine bound to the partition, locked. The
+ * partition is guaranteed to exist as long as we hold the magazine
+ * lock, since pt_delete() has to grab it for unbinding.
+ */
+static struct pt_magazine *get_magazine(struct psos_pt *pt)
+{
+	struct pt_cache *cache = __get_pt_cache();
+	struct pt_magazine *mag;
+	int n;
+
+	if (cache == NULL || pt == NULL)
+		return NULL;
+
+	for (n = 0; n < PT_CACHE_SLOTS; n++) {
+		mag = cache->mags + n;
+		if (ACCESS_ONCE(mag->pt) != pt)
+			continue;
+		__RT(pthread_mutex_lock(&mag->lock));
+		/* pt_delete() might have unbound us meanwhile. */
+		if (mag->pt == pt)
+			return mag;
+		__RT(pthread_mutex_unlock(&mag->lock));
+		break;
+	}
+
+	return NULL;
+}
+
+static inline void put_magazine(struct pt_magazine *mag)
+{
+	__RT(pthread_mutex_unlock(&mag->lock));
+}
+
+/*
+ * Bind a magazine from the caller's cache to a partition, recycling
+ * the slots in round-robin order. Returns the magazine locked, or
+ * NULL if no cache is available to the caller.
+ */
+static struct pt_magazine *bind_magazine(u_long ptid)
+{
+	struct pt_magazine *mag;
+	struct pt_cache *cache;
+	struct psos_pt *pt;
+	int n, ret;
+
+	pthread_once(&pt_cache_once, init_pt_cache);
+
+	cache = get_pt_cache();
+	if (cache == NULL)
+		return NULL;
+
+	__RT(pthread_mutex_lock(&pt_cache_lock));
+
+	/*
+	 * Don't recycle any slot for a stale partition. Once
+	 * validated, the partition cannot go away until we drop
+	 * pt_cache_lock.
+	 */
+	pt = get_pt_from_id(ptid, &ret);
+	if (pt == NULL) {
+		mag = NULL;
+		goto out;
+	}
+
+	put_pt(pt);
+
+	for (n = 0; n < PT_CACHE_SLOTS; n++) {
+		mag = cache->mags + n;
+		if (mag->pt == NULL)
+			break;
+	}
+
+	if (n == PT_CACHE_SLOTS) {
+		mag = cache->mags + cache->victim;
+		cache->victim = (cache->victim + 1) % PT_CACHE_SLOTS;
+	}
+
+	__RT(pthread_mutex_lock(&mag->lock));
+
+	if (mag->pt)
+		unbind_magazine(mag);
+
+	lock_pt(pt);
+	mag->pt = pt;
+	pvlist_append(&mag->next, &pt->magazines);
+	put_pt(pt);
+out:
+	__RT(pthread_mutex_unlock(&pt_cache_lock));
+
+	return mag;
+}
+
+#ifdef CONFIG_XENO_REGISTRY
+
+static ssize_t pt_registry_read(struct fsobj *fsobj,
+				char *buf, size_t size, off_t offset,
+				void *priv)
+{
+	unsigned long hits, cached = 0;
+	struct pt_magazine *mag;
+	struct psos_pt *pt;
+	size_t len;
+
+	pt = container_of(fsobj, struct psos_pt, fsobj);
+
+	__RT(pthread_mutex_lock(&pt->lock));
+
+	/* Other threads' magazines are sampled locklessly. */
+	hits = pt->cachehits;
+	pvlist_for_each_entry(mag, &pt->magazines, next) {
+		hits += ACCESS_ONCE(mag->hits);
+		cached += ACCESS_ONCE(mag->count);
+	}
+
+	len =  sprintf(buf,       "name         = %s\n", pt->name);
+	len += sprintf(buf + len, "block_size   = %lu\n", pt->bsize);
+	len += sprintf(buf + len, "blocks       = %lu\n", pt->nblks);
+	len += sprintf(buf + len, "busy         = %lu\n", pt->ublks - cached);
+	len += sprintf(buf + len, "cached       = %lu\n", cached);
+	len += sprintf(buf + len, "cache_hits   = %lu\n", hits);
+	len += sprintf(buf + len, "cache_misses = %lu\n", pt->cachemisses);
+	len += sprintf(buf + len, "contended    = %lu\n", pt->contended);
+
+	__RT(pthread_mutex_unlock(&pt->lock));
+
+	return (ssize_t)len;
+}
+
+static struct registry_operations registry_ops = {
+	.read	= pt_registry_read
+};
+
+#else
+
+static struct registry_operations registry_ops;
+
+#endif /* CONFIG_XENO_REGISTRY */
+
 static inline size_t pt_overhead(size_t psize, size_t bsize)
 {
 	size_t m = (bsize * 8);
@@ -120,7 +497,6 @@ u_long pt_create(const char *name,
 		 u_long psize, u_long bsize, u_long flags,
 		 u_long *ptid_r, u_long *nbuf)
 {
-	pthread_mutexattr_t mattr;
 	char short_name[5];
 	struct service svc;
 	struct psos_pt *pt;
@@ -161,6 +537,7 @@ u_long pt_create(const char *name,
 
 	pt->flags = flags;
 	pt->bsize = (bsize + pt_align_mask) & ~pt_align_mask;
+	pt->bshift = __builtin_ffsl(pt->bsize) - 1;
 	overhead = pt_overhead(psize, pt->bsize);
 
 	pt->nblks = (psize - overhead) / pt->bsize;
@@ -173,6 +550,10 @@ u_long pt_create(const char *name,
 	pt->data = (caddr_t)pt + overhead;
 	pt->freelist = mp = pt->data;
 	pt->ublks = 0;
+	pt->cachehits = 0;
+	pt->cachemisses = 0;
+	pt->contended = 0;
+	pvlist_init(&pt->magazines);
 
 	for (n = pt->nblks; n > 1; n--) {
 		caddr_t nmp = mp + pt->bsize;
@@ -184,11 +565,13 @@ u_long pt_create(const char *name,
 	memset(pt->bitmap, 0, overhead - sizeof(*pt) + sizeof(pt->bitmap));
 	*nbuf = pt->nblks;
 
-	__RT(pthread_mutexattr_init(&mattr));
-	__RT(pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT));
-	__RT(pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE));
-	__RT(pthread_mutex_init(&pt->lock, &mattr));
-	__RT(pthread_mutexattr_destroy(&mattr));
+	init_pi_lock(&pt->lock);
+
+	registry_init_file(&pt->fsobj, &registry_ops, 0);
+	if (registry_add_file(&pt->fsobj, O_RDONLY,
+			      "/psos/partitions/%s", pt->name))
+		warning("failed to export partition %s to registry",
+			pt->name);
 
 	pt->magic = pt_magic;
 	*ptid_r = (u_long)pt;
@@ -200,87 +583,155 @@ out:
 
 u_long pt_delete(u_long ptid)
 {
+	struct pt_magazine *mag, *tmp;
 	struct psos_pt *pt;
 	struct service svc;
 	int ret;
 
+	pthread_once(&pt_cache_once, init_pt_cache);
+
+	__RT(pthread_mutex_lock(&pt_cache_lock));
+
 	pt = get_pt_from_id(ptid, &ret);
 	if (pt == NULL)
-		return ret;
+		goto out;
+
+	/*
+	 * Take back the blocks cached by all threads, this requires
+	 * to grab the magazine locks first.
+	 */
+	put_pt(pt);
+
+	pvlist_for_each_entry_safe(mag, tmp, &pt->magazines, next) {
+		__RT(pthread_mutex_lock(&mag->lock));
+		unbind_magazine(mag);
+		put_magazine(mag);
+	}
+
+	lock_pt(pt);
 
 	if ((pt->flags & PT_DEL) == 0 && pt->ublks > 0) {
 		put_pt(pt);
-		return ERR_BUFINUSE;
+		ret = ERR_BUFINUSE;
+		goto out;
 	}
 
 	CANCEL_DEFER(svc);
 	pvcluster_delobj(&psos_pt_table, &pt->cobj);
 	CANCEL_RESTORE(svc);
+	registry_destroy_file(&pt->fsobj);
 	pt->magic = ~pt_magic; /* Prevent further reference. */
 	put_pt(pt);
 	__RT(pthread_mutex_destroy(&pt->lock));
+	ret = SUCCESS;
+out:
+	__RT(pthread_mutex_unlock(&pt_cache_lock));
 
-	return SUCCESS;
+	return ret;
 }
 
 u_long pt_getbuf(u_long ptid, void **bufaddr)
 {
+	struct pt_magazine *mag;
 	struct psos_pt *pt;
-	u_long numblk;
 	void *buf;
 	int ret;
 
+	mag = get_magazine((struct psos_pt *)ptid);
+	if (mag == NULL)
+		mag = bind_magazine(ptid);
+
+	if (mag && mag->count > 0) {
+		pt = mag->pt;
+		buf = mag->blocks[--mag->count];
+		mag->hits++;
+		pt_bitmap_setbit(pt, pt_block_index(pt, buf));
+		put_magazine(mag);
+		*bufaddr = buf;
+		return SUCCESS;
+	}
+
 	pt = get_pt_from_id(ptid, &ret);
 	if (pt == NULL)
-		return ret;
+		goto out;
+
+	pt->cachemisses++;
+
+	if (pt->freelist == NULL)
+		steal_magazines(pt, mag);
 
 	buf = pt->freelist;
 	if (buf) {
 		pt->freelist = *((void **)buf);
 		pt->ublks++;
-		numblk = ((caddr_t)buf - pt->data) / pt->bsize;
-		pt_bitmap_setbit(pt, numblk);
+		pt_bitmap_setbit(pt, pt_block_index(pt, buf));
+		if (mag)
+			fill_magazine(pt, mag, PT_MAGAZINE_BATCH);
 	}
 
 	put_pt(pt);
 
 	*bufaddr = buf;
-	if (buf == NULL)
-		return ERR_NOBUF;
+	ret = buf ? SUCCESS : ERR_NOBUF;
+out:
+	if (mag)
+		put_magazine(mag);
+
+	return ret;
+}
+
+static int check_block(struct psos_pt *pt, void *buf)
+{
+	if ((caddr_t)buf < pt->data ||
+	    (caddr_t)buf >= pt->data + pt->psize ||
+	    (((caddr_t)buf - pt->data) & (pt->bsize - 1)) != 0)
+		return ERR_BUFADDR;
+
+	if (!pt_bitmap_tst_clrbit(pt, pt_block_index(pt, buf)))
+		return ERR_BUFFREE;
 
 	return SUCCESS;
 }
 
 u_long pt_retbuf(u_long ptid, void *buf)
 {
+	struct pt_magazine *mag;
 	struct psos_pt *pt;
-	u_long numblk;
 	int ret;
 
-	pt = get_pt_from_id(ptid, &ret);
-	if (pt == NULL)
+	mag = get_magazine((struct psos_pt *)ptid);
+	if (mag == NULL)
+		mag = bind_magazine(ptid);
+
+	if (mag) {
+		pt = mag->pt;
+		ret = check_block(pt, buf);
+		if (ret == SUCCESS) {
+			if (mag->count == PT_MAGAZINE_DEPTH) {
+				lock_pt(pt);
+				pt->cachemisses++;
+				drain_magazine(pt, mag, PT_MAGAZINE_BATCH);
+				put_pt(pt);
+			} else
+				mag->hits++;
+			mag->blocks[mag->count++] = buf;
+		}
+		put_magazine(mag);
 		return ret;
-
-	if ((caddr_t)buf < pt->data ||
-	    (caddr_t)buf >= pt->data + pt->psize ||
-	    (((caddr_t)buf - pt->data) % pt->bsize) != 0) {
-		ret = ERR_BUFADDR;
-		goto done;
 	}
 
-	numblk = ((caddr_t)buf - pt->data) / pt->bsize;
+	pt = get_pt_from_id(ptid, &ret);
+	if (pt == NULL)
+		return ret;
 
-	if (!pt_bitmap_tstbit(pt, numblk)) {
-		ret = ERR_BUFFREE;
-		goto done;
+	pt->cachemisses++;
+	ret = check_block(pt, buf);
+	if (ret == SUCCESS) {
+		*((void **)buf) = pt->freelist;
+		pt->freelist = buf;
+		pt->ublks--;
 	}
 
-	pt_bitmap_clrbit(pt, numblk);
-	*((void **)buf) = pt->freelist;
-	pt->freelist = buf;
-	pt->ublks--;
-	ret = SUCCESS;
-done:
 	put_pt(pt);
 
 	return ret;
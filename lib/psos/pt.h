@@ -22,7 +22,9 @@
 #include <sys/types.h>
 #include <pthread.h>
 #include <boilerplate/hash.h>
+#include <boilerplate/list.h>
 #include <copperplate/cluster.h>
+#include <copperplate/registry.h>
 
 struct psos_pt {
 	unsigned int magic;		/* Must be first. */
@@ -35,6 +37,13 @@ struct psos_pt {
 	unsigned long psize;
 	unsigned long nblks;
 	unsigned long ublks;
+	unsigned int bshift;
+
+	struct pvlist magazines;	/* Bound per-thread caches. */
+	unsigned long cachehits;	/* From unbound magazines. */
+	unsigned long cachemisses;
+	unsigned long contended;
+	struct fsobj fsobj;
 
 	void *freelist;
 	caddr_t data;
@@ -113,6 +113,9 @@ static u_long __q_create(const char *name, u_long count,
 	if (flags & Q_PRIOR)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (flags & Q_SPIN)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	q->flags = flags;
 	q->maxmsg = (flags & Q_LIMIT) ? count : 0;
 	q->maxlen = maxlen;
@@ -19,11 +19,13 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <memory.h>
 #include <copperplate/init.h>
 #include <copperplate/threadobj.h>
 #include <copperplate/clockobj.h>
+#include <copperplate/registry.h>
 #include <psos/psos.h>
 #include "internal.h"
 #include "tm.h"
@@ -61,6 +63,65 @@ objid_error:
 	return NULL;
 }
 
+#ifdef CONFIG_XENO_REGISTRY
+
+static ssize_t rn_registry_read(struct fsobj *fsobj,
+				char *buf, size_t size, off_t offset,
+				void *priv)
+{
+	size_t free_size, largest, nfrags;
+	struct syncstate syns;
+	struct psos_rn *rn;
+	size_t len;
+
+	rn = container_of(fsobj, struct psos_rn, fsobj);
+
+	if (syncobj_lock(&rn->sobj, &syns))
+		return -EIO;
+
+	free_size = pvheapobj_inquire_free(&rn->hobj, &largest, &nfrags);
+
+	len =  sprintf(buf,       "name          = %s\n", rn->name);
+	len += sprintf(buf + len, "length        = %lu\n", rn->length);
+	len += sprintf(buf + len, "used          = %lu\n", rn->usedmem);
+	len += sprintf(buf + len, "peak          = %lu\n", rn->peakmem);
+	len += sprintf(buf + len, "segments      = %lu\n", rn->busynr);
+	len += sprintf(buf + len, "free          = %zu\n", free_size);
+	len += sprintf(buf + len, "largest_free  = %zu\n", largest);
+	len += sprintf(buf + len, "free_chunks   = %zu\n", nfrags);
+	len += sprintf(buf + len, "fragmentation = %zu%%\n",
+		       free_size ? 100 - largest * 100 / free_size : 0);
+
+	syncobj_unlock(&rn->sobj, &syns);
+
+	return (ssize_t)len;
+}
+
+static struct registry_operations registry_ops = {
+	.read	= rn_registry_read
+};
+
+#else
+
+static struct registry_operations registry_ops;
+
+#endif /* CONFIG_XENO_REGISTRY */
+
+static inline void *alloc_seg(struct psos_rn *rn, u_long size)
+{
+	void *seg;
+
+	seg = pvheapobj_alloc(&rn->hobj, size);
+	if (seg) {
+		rn->busynr++;
+		rn->usedmem += pvheapobj_validate(&rn->hobj, seg);
+		if (rn->usedmem > rn->peakmem)
+			rn->peakmem = rn->usedmem;
+	}
+
+	return seg;
+}
+
 u_long rn_create(const char *name, void *saddr, u_long length,
 		 u_long usize, u_long flags, u_long *rnid_r,
 		 u_long *asize_r)
@@ -126,8 +187,15 @@ u_long rn_create(const char *name, void *saddr, u_long length,
 		goto out;
 	}
 
-	ret = __heapobj_init(&rn->hobj, name, length, saddr);
+	/*
+	 * Segments are carved from the user-provided area by a
+	 * private TLSF pool, in both private and shared modes, which
+	 * gives us O(1) good-fit allocations whatever the
+	 * fragmentation. We serialize on the region lock.
+	 */
+	ret = __heapobj_init_private(&rn->hobj, rn->name, length, saddr);
 	if (ret) {
+		pvcluster_delobj(&psos_rn_table, &rn->cobj);
 		ret = ERR_TINYRN;
 		xnfree(rn);
 		goto out;
@@ -136,12 +204,21 @@ u_long rn_create(const char *name, void *saddr, u_long length,
 	if (flags & RN_PRIOR)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	rn->area = saddr;
 	rn->length = length;
 	rn->usize = usize;	/* Not actually used, just checked. */
 	rn->flags = flags;
 	rn->busynr = 0;
 	rn->usedmem = 0;
+	rn->peakmem = 0;
 	syncobj_init(&rn->sobj, CLOCK_COPPERPLATE, sobj_flags, fnref_null);
+
+	registry_init_file(&rn->fsobj, &registry_ops, 0);
+	if (registry_add_file(&rn->fsobj, O_RDONLY,
+			      "/psos/regions/%s", rn->name))
+		warning("failed to export region %s to registry",
+			rn->name);
+
 	rn->magic = rn_magic;
 	*asize_r = rn->hobj.size;
 	*rnid_r = mainheap_ref(rn, u_long);
@@ -176,7 +253,9 @@ u_long rn_delete(u_long rnid)
 	}
 
 	pvcluster_delobj(&psos_rn_table, &rn->cobj);
+	registry_destroy_file(&rn->fsobj);
 	rn->magic = ~rn_magic; /* Prevent further reference. */
+	pvheapobj_destroy(&rn->hobj);
 	ret = syncobj_destroy(&rn->sobj, &syns);
 	if (ret)
 		ret = ERR_TATRNDEL;
@@ -230,18 +309,13 @@ u_long rn_getseg(u_long rnid, u_long size, u_long flags,
 		goto out;
 	}
 
-	/*
-	 * The heap manager does not enforce any allocation limit; so
-	 * we have to do it by ourselves.
-	 */
+	/* Don't bother asking the allocator for obviously too much. */
 	if (rn->usedmem + size > rn->length)
 		goto starve;
 
-	seg = heapobj_alloc(&rn->hobj, size);
+	seg = alloc_seg(rn, size);
 	if (seg) {
 		*segaddr = seg;
-		rn->busynr++;
-		rn->usedmem += heapobj_validate(&rn->hobj, seg);
 		goto done;
 	}
 
@@ -307,8 +381,25 @@ u_long rn_retseg(u_long rnid, void *segaddr)
 		goto out;
 	}
 
-	rn->usedmem -= heapobj_validate(&rn->hobj, segaddr);
-	heapobj_free(&rn->hobj, segaddr);
+	/*
+	 * The heap reads the block header right before segaddr to
+	 * validate it, so make sure we don't pass it a stray pointer.
+	 */
+	if ((caddr_t)segaddr < rn->area ||
+	    (caddr_t)segaddr >= rn->area + rn->length ||
+	    ((uintptr_t)segaddr & (sizeof(uintptr_t) - 1)) != 0) {
+		ret = ERR_SEGADDR;
+		goto done;
+	}
+
+	size = pvheapobj_validate(&rn->hobj, segaddr);
+	if (size == 0) {
+		ret = ERR_SEGADDR;
+		goto done;
+	}
+
+	rn->usedmem -= size;
+	pvheapobj_free(&rn->hobj, segaddr);
 	rn->busynr--;
 
 	if (!syncobj_grant_wait_p(&rn->sobj))
@@ -319,10 +410,8 @@ u_long rn_retseg(u_long rnid, void *segaddr)
 		size = wait->size;
 		if (rn->usedmem + size > rn->length)
 			continue;
-		seg = heapobj_alloc(&rn->hobj, size);
+		seg = alloc_seg(rn, size);
 		if (seg) {
-			rn->busynr++;
-			rn->usedmem += heapobj_validate(&rn->hobj, seg);
 			wait->ptr = seg;
 			syncobj_grant_to(&rn->sobj, thobj);
 		}
@@ -23,20 +23,24 @@
 #include <copperplate/syncobj.h>
 #include <copperplate/heapobj.h>
 #include <copperplate/cluster.h>
+#include <copperplate/registry.h>
 
 struct psos_rn {
 	unsigned int magic;		/* Must be first. */
 	char name[32];
 
 	u_long flags;
+	caddr_t area;
 	u_long length;
 	u_long usize;
 	u_long busynr;
 	u_long usedmem;
+	u_long peakmem;
 
 	struct syncobj sobj;
 	struct heapobj hobj;
 	struct pvclusterobj cobj;
+	struct fsobj fsobj;
 };
 
 struct psos_rn_wait {
@@ -107,6 +107,9 @@ u_long sm_create(const char *name,
 	if (flags & SM_PRIOR)
 		smobj_flags |= SEMOBJ_PRIO;
 
+	if (flags & SM_SPIN)
+		smobj_flags |= SEMOBJ_ADAPTIVE;
+
 	sem->magic = sem_magic;
 	ret = semobj_init(&sem->smobj, smobj_flags, count,
 			  fnref_put(libpsos, sem_finalize));
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <copperplate/traceobj.h>
+#include <psos/psos.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5, 6
+};
+
+#define BSIZE      16
+#define NR_ROUNDS  10000
+#define NR_HELD    5
+
+static char pt_mem[4096];
+
+static void *bufs[sizeof(pt_mem) / BSIZE];
+
+static u_long tidA, tidB, sem_id, ptid, nbufs;
+
+static void churn(int seed)
+{
+	void *held[NR_HELD];
+	int ret, n, m;
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		for (m = 0; m < NR_HELD; m++) {
+			ret = pt_getbuf(ptid, &held[m]);
+			traceobj_assert(&trobj, ret == SUCCESS);
+			memset(held[m], seed + m, BSIZE);
+		}
+		for (m = NR_HELD - 1; m >= 0; m--) {
+			traceobj_assert(&trobj,
+					*(unsigned char *)held[m] == seed + m);
+			ret = pt_retbuf(ptid, held[m]);
+			traceobj_assert(&trobj, ret == SUCCESS);
+		}
+	}
+}
+
+static void task_A(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	u_long n;
+	int ret;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 3);
+
+	churn(0x10);
+
+	/* Every block must be available, including the ones TSKB caches. */
+	for (n = 0; n < nbufs; n++) {
+		ret = pt_getbuf(ptid, &bufs[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	ret = pt_getbuf(ptid, &bufs[n]);
+	traceobj_assert(&trobj, ret == ERR_NOBUF);
+
+	for (n = 0; n < nbufs; n++) {
+		ret = pt_retbuf(ptid, bufs[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	/* Cached blocks must still be seen as free. */
+	ret = pt_retbuf(ptid, bufs[0]);
+	traceobj_assert(&trobj, ret == ERR_BUFFREE);
+
+	ret = pt_retbuf(ptid, (caddr_t)bufs[0] + 1);
+	traceobj_assert(&trobj, ret == ERR_BUFADDR);
+
+	ret = pt_delete(ptid);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_mark(&trobj, 4);
+
+	ret = sm_v(sem_id);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_exit(&trobj);
+}
+
+static void task_B(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	u_long args[] = { 1, 2, 3, 4 };
+	void *buf;
+	int ret;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 1);
+
+	churn(0x20);
+
+	traceobj_mark(&trobj, 2);
+
+	ret = t_start(tidA, 0, task_A, args);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	/* Keep our cache alive while TSKA drains the partition. */
+	ret = sm_p(sem_id, SM_WAIT, 0);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_mark(&trobj, 5);
+
+	ret = pt_getbuf(ptid, &buf);
+	traceobj_assert(&trobj, ret == ERR_OBJDEL);
+
+	traceobj_mark(&trobj, 6);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	u_long args[] = { 1, 2, 3, 4 };
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = pt_create("PART", pt_mem, NULL, sizeof(pt_mem), BSIZE,
+			PT_NODEL, &ptid, &nbufs);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = sm_create("SEMA", 0, SM_PRIOR, &sem_id);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_create("TSKA", 20, 0, 0, 0, &tidA);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_create("TSKB", 21, 0, 0, 0, &tidB);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_start(tidB, 0, task_B, args);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	exit(0);
+}
@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <copperplate/traceobj.h>
+#include <psos/psos.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4, 5
+};
+
+#define NR_SEGS   256
+#define SEG_SIZE  512
+
+static char rn_mem[65536];
+
+static void *segs[NR_SEGS];
+
+static u_long tidA, tidB, rnid;
+
+static int nsegs;
+
+static void task_A(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	void *seg;
+	int ret;
+
+	traceobj_enter(&trobj);
+
+	traceobj_mark(&trobj, 2);
+
+	/* Every other segment is free, yet none fits. */
+	ret = rn_getseg(rnid, SEG_SIZE * 2, RN_WAIT, 0, &seg);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_mark(&trobj, 4);
+
+	ret = rn_retseg(rnid, seg);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_exit(&trobj);
+}
+
+static void task_B(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	u_long args[] = { 1, 2, 3, 4 };
+	int ret, n;
+	void *seg;
+
+	traceobj_enter(&trobj);
+
+	for (nsegs = 0; nsegs < NR_SEGS; nsegs++) {
+		ret = rn_getseg(rnid, SEG_SIZE, RN_NOWAIT, 0, &segs[nsegs]);
+		if (ret) {
+			traceobj_assert(&trobj, ret == ERR_NOSEG);
+			break;
+		}
+		memset(segs[nsegs], nsegs, SEG_SIZE);
+	}
+
+	/* Make sure the region is exhausted. */
+	traceobj_assert(&trobj, nsegs > 3 && nsegs < NR_SEGS);
+
+	/* Keep the last segment, which may border the unused tail. */
+	for (n = 0; n < nsegs - 1; n += 2) {
+		ret = rn_retseg(rnid, segs[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	ret = rn_retseg(rnid, segs[0]);
+	traceobj_assert(&trobj, ret == ERR_SEGADDR);
+
+	/* Pointers outside of the region must be rejected too. */
+	ret = rn_retseg(rnid, &seg);
+	traceobj_assert(&trobj, ret == ERR_SEGADDR);
+
+	ret = rn_getseg(rnid, SEG_SIZE * 2, RN_NOWAIT, 0, &seg);
+	traceobj_assert(&trobj, ret == ERR_NOSEG);
+
+	ret = rn_getseg(rnid, SEG_SIZE, RN_NOWAIT, 0, &segs[0]);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_mark(&trobj, 1);
+
+	ret = t_start(tidA, 0, task_A, args);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = tm_wkafter(10);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_mark(&trobj, 3);
+
+	/* Releasing two adjacent segments must satisfy the waiter. */
+	for (n = 1; n < nsegs - 1; n += 2) {
+		traceobj_assert(&trobj, *(unsigned char *)segs[n] == n);
+		ret = rn_retseg(rnid, segs[n]);
+		traceobj_assert(&trobj, ret == SUCCESS);
+	}
+
+	traceobj_mark(&trobj, 5);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	u_long args[] = { 1, 2, 3, 4 }, asize;
+	int ret;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	ret = rn_create("REGION", rn_mem, sizeof(rn_mem),
+			32, RN_FIFO|RN_DEL, &rnid, &asize);
+	traceobj_assert(&trobj, ret == SUCCESS);
+	traceobj_assert(&trobj, asize < sizeof(rn_mem));
+
+	ret = t_create("TSKA", 21, 0, 0, 0, &tidA);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_create("TSKB", 20, 0, 0, 0, &tidB);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	ret = t_start(tidB, 0, task_B, args);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	ret = rn_delete(rnid);
+	traceobj_assert(&trobj, ret == SUCCESS);
+
+	exit(0);
+}
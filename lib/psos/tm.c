@@ -127,7 +127,13 @@ static u_long start_evtimer(u_long events,
 	tm->tid = mainheap_ref(current, u_long);
 	pvlist_append(&tm->link, &current->timer_list);
 
-	ret = timerobj_init(&tm->tmobj);
+	/*
+	 * Event timers only post to their creator, so we serve them
+	 * at the creator's priority: the timers of a low priority
+	 * task can't delay those of more urgent tasks this way.
+	 */
+	ret = timerobj_init_server(&tm->tmobj, TIMEROBJ_CPU_AUTO,
+				   threadobj_get_priority(&current->thobj));
 	/*
 	 * Make sure to queue fully built timers only, by holding the
 	 * task lock until we are back from timerobj_init(), so that
@@ -74,7 +74,7 @@ MSG_Q_ID msgQCreate(int maxMsgs, int maxMsgLength, int options)
 		return (MSG_Q_ID)0;
 	}
 
-	if ((options & ~MSG_Q_PRIORITY) || maxMsgs <= 0) {
+	if ((options & ~(MSG_Q_PRIORITY|MSG_Q_SPIN)) || maxMsgs <= 0) {
 		errno = S_msgQLib_INVALID_QUEUE_TYPE;
 		return (MSG_Q_ID)0;
 	}
@@ -108,6 +108,9 @@ MSG_Q_ID msgQCreate(int maxMsgs, int maxMsgLength, int options)
 	if (options & MSG_Q_PRIORITY)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (options & MSG_Q_SPIN)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	syncobj_init(&mq->sobj, CLOCK_COPPERPLATE, sobj_flags,
 		     fnref_put(libvxworks, mq_finalize));
 	mq->options = options;
@@ -17,6 +17,7 @@
 */
 
 #include <stdlib.h>
+#include <string.h>
 #include <boilerplate/lock.h>
 #include <copperplate/heapobj.h>
 #include <vxworks/errnoLib.h>
@@ -91,48 +92,89 @@ void rngFlush(RING_ID rid)
 	}
 }
 
+/*
+ * A ring has bufSize + 1 slots, one of them is always left free so
+ * that readPos == writePos means empty. The reader only updates
+ * readPos, the writer only updates writePos, so that a single reader
+ * and a single writer may run concurrently without locking, as
+ * VxWorks allows.
+ */
 int rngBufGet(RING_ID rid, char *buffer, int maxbytes)
 {
 	struct wind_ring *ring = find_ring_from_id(rid);
-	unsigned int savedWritePos;
-	int j, bytesRead = 0;
+	unsigned int size, rpos, wpos, len, n;
 
 	if (ring == NULL)
 		return ERROR;
 
-	savedWritePos = ring->writePos;
+	if (maxbytes <= 0)
+		return 0;
+
+	size = ring->bufSize + 1;
+	rpos = ring->readPos;
+	wpos = ACCESS_ONCE(ring->writePos);
+	/* Read the writer's position before its data. */
+	smp_rmb();
 
-	for (j = 0; j < maxbytes; j++) {
-		if ((ring->readPos) % (ring->bufSize + 1) == savedWritePos)
-			break;
-		buffer[j] = ring->buffer[ring->readPos];
-		++bytesRead;
-		ring->readPos = (ring->readPos + 1) % (ring->bufSize + 1);
-	}
+	len = wpos >= rpos ? wpos - rpos : size - rpos + wpos;
+	if (len > (unsigned int)maxbytes)
+		len = maxbytes;
+
+	n = size - rpos;
+	if (n > len)
+		n = len;
+
+	memcpy(buffer, ring->buffer + rpos, n);
+	if (len > n)
+		memcpy(buffer + n, ring->buffer, len - n);
+
+	/* Done with the data before the writer may reuse its room. */
+	smp_mb();
+	rpos += len;
+	if (rpos >= size)
+		rpos -= size;
+	ACCESS_ONCE(ring->readPos) = rpos;
 
-	return bytesRead;
+	return len;
 }
 
 int rngBufPut(RING_ID rid, char *buffer, int nbytes)
 {
 	struct wind_ring *ring = find_ring_from_id(rid);
-	unsigned int savedReadPos;
-	int j, bytesWritten = 0;
+	unsigned int size, rpos, wpos, len, n;
 
 	if (ring == NULL)
 		return ERROR;
 
-	savedReadPos = ring->readPos;
+	if (nbytes <= 0)
+		return 0;
 
-	for (j = 0; j < nbytes; j++) {
-		if ((ring->writePos + 1) % (ring->bufSize + 1) == savedReadPos)
-			break;
-		ring->buffer[ring->writePos] = buffer[j];
-		++bytesWritten;
-		ring->writePos = (ring->writePos + 1) % (ring->bufSize + 1);
-	}
+	size = ring->bufSize + 1;
+	wpos = ring->writePos;
+	rpos = ACCESS_ONCE(ring->readPos);
+	/* The reader must be done with the room we are about to fill. */
+	smp_mb();
+
+	len = rpos > wpos ? rpos - wpos - 1 : size - wpos + rpos - 1;
+	if (len > (unsigned int)nbytes)
+		len = nbytes;
+
+	n = size - wpos;
+	if (n > len)
+		n = len;
+
+	memcpy(ring->buffer + wpos, buffer, n);
+	if (len > n)
+		memcpy(ring->buffer, buffer + n, len - n);
+
+	/* Publish the data before the new position. */
+	smp_wmb();
+	wpos += len;
+	if (wpos >= size)
+		wpos -= size;
+	ACCESS_ONCE(ring->writePos) = wpos;
 
-	return bytesWritten;
+	return len;
 }
 
 BOOL rngIsEmpty(RING_ID rid)
@@ -163,7 +205,8 @@ int rngFreeBytes(RING_ID rid)
 		return ERROR;
 
 	return ((ring->bufSize -
-		 (ring->writePos - ring->readPos)) % (ring->bufSize + 1));
+		 (ACCESS_ONCE(ring->writePos) - ACCESS_ONCE(ring->readPos)))
+		% (ring->bufSize + 1));
 }
 
 int rngNBytes(RING_ID rid)
@@ -192,7 +235,9 @@ void rngMoveAhead(RING_ID rid, int n)
 	struct wind_ring *ring = find_ring_from_id(rid);
 
 	if (ring) {
-		ring->writePos += n;
-		ring->writePos %= (ring->bufSize + 1);
+		/* Publish the bytes stored by rngPutAhead() first. */
+		smp_wmb();
+		ACCESS_ONCE(ring->writePos) =
+			(ring->writePos + n) % (ring->bufSize + 1);
 	}
 }
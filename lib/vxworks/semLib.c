@@ -54,6 +54,51 @@ static struct wind_sem *alloc_sem(int options, const struct wind_sem_ops *ops)
 	return sem;
 }
 
+/*
+ * The count of binary and counting semaphores is updated atomically,
+ * so that taking an available semaphore, or giving one nobody waits
+ * for, does not enter the monitor. A negative count denotes
+ * sleepers; since such value is only reached and left with the
+ * monitor held, the fast paths leave it to the slow ones.
+ */
+static int xsem_take_fast(struct wind_sem *sem)
+{
+	int value, old;
+
+	value = ACCESS_ONCE(sem->u.xsem.value);
+	while (value > 0) {
+		old = value;
+		value = atomic_cmp_swap(&sem->u.xsem.value, old, old - 1);
+		if (value == old)
+			return 1;
+	}
+
+	return 0;
+}
+
+static int xsem_give_fast(struct wind_sem *sem, STATUS *ret)
+{
+	int value, old;
+
+	value = ACCESS_ONCE(sem->u.xsem.value);
+	while (value >= 0) {
+		if (value >= sem->u.xsem.maxvalue) {
+			/* No wrap around. */
+			*ret = sem->u.xsem.maxvalue == INT_MAX ?
+				S_semLib_INVALID_OPERATION : OK;
+			return 1;
+		}
+		old = value;
+		value = atomic_cmp_swap(&sem->u.xsem.value, old, old + 1);
+		if (value == old) {
+			*ret = OK;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 static STATUS xsem_take(struct wind_sem *sem, int timeout)
 {
 	struct timespec ts, *timespec;
@@ -64,6 +109,9 @@ static STATUS xsem_take(struct wind_sem *sem, int timeout)
 	if (threadobj_irq_p())
 		return S_intLib_NOT_ISR_CALLABLE;
 
+	if (xsem_take_fast(sem))
+		return OK;
+
 	CANCEL_DEFER(svc);
 
 	if (syncobj_lock(&sem->u.xsem.sobj, &syns)) {
@@ -71,15 +119,15 @@ static STATUS xsem_take(struct wind_sem *sem, int timeout)
 		goto out;
 	}
 
-	if (--sem->u.xsem.value >= 0)
-		goto done;
-
 	if (timeout == NO_WAIT) {
-		sem->u.xsem.value++;
-		ret = S_objLib_OBJ_UNAVAILABLE;
+		if (!xsem_take_fast(sem))
+			ret = S_objLib_OBJ_UNAVAILABLE;
 		goto done;
 	}
 
+	if (atomic_sub_fetch(sem->u.xsem.value, 1) >= 0)
+		goto done;
+
 	if (timeout != WAIT_FOREVER) {
 		timespec = &ts;
 		clockobj_ticks_to_timeout(&wind_clock, timeout, timespec);
@@ -92,7 +140,7 @@ static STATUS xsem_take(struct wind_sem *sem, int timeout)
 		goto out;
 	}
 	if (ret) {
-		sem->u.xsem.value++;
+		atomic_add_fetch(sem->u.xsem.value, 1);
 		if (ret == -ETIMEDOUT)
 			ret = S_objLib_OBJ_TIMEOUT;
 		else if (ret == -EINTR)
@@ -112,6 +160,9 @@ static STATUS xsem_give(struct wind_sem *sem)
 	struct service svc;
 	STATUS ret = OK;
 
+	if (xsem_give_fast(sem, &ret))
+		return ret;
+
 	CANCEL_DEFER(svc);
 
 	if (syncobj_lock(&sem->u.xsem.sobj, &syns)) {
@@ -119,12 +170,11 @@ static STATUS xsem_give(struct wind_sem *sem)
 		goto out;
 	}
 
-	if (sem->u.xsem.value >= sem->u.xsem.maxvalue) {
-		if (sem->u.xsem.maxvalue == INT_MAX)
-			/* No wrap around. */
-			ret = S_semLib_INVALID_OPERATION;
-	} else if (++sem->u.xsem.value <= 0)
+	/* Sleepers may have timed out meanwhile. */
+	if (!xsem_give_fast(sem, &ret)) {
+		atomic_add_fetch(sem->u.xsem.value, 1);
 		syncobj_grant_one(&sem->u.xsem.sobj);
+	}
 
 	syncobj_unlock(&sem->u.xsem.sobj, &syns);
 out:
@@ -198,7 +248,7 @@ static SEM_ID alloc_xsem(int options, int initval, int maxval)
 	struct wind_sem *sem;
 	int sobj_flags = 0;
 
-	if (options & ~SEM_Q_PRIORITY) {
+	if (options & ~(SEM_Q_PRIORITY|SEM_SPIN)) {
 		errno = S_semLib_INVALID_OPTION;
 		return (SEM_ID)0;
 	}
@@ -212,6 +262,9 @@ static SEM_ID alloc_xsem(int options, int initval, int maxval)
 	if (options & SEM_Q_PRIORITY)
 		sobj_flags = SYNCOBJ_PRIO;
 
+	if (options & SEM_SPIN)
+		sobj_flags |= SYNCOBJ_ADAPTIVE;
+
 	sem->u.xsem.value = initval;
 	sem->u.xsem.maxvalue = maxval;
 	syncobj_init(&sem->u.xsem.sobj, CLOCK_COPPERPLATE, sobj_flags,
@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <copperplate/traceobj.h>
+#include <vxworks/errnoLib.h>
+#include <vxworks/taskLib.h>
+#include <vxworks/rngLib.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3
+};
+
+#define RING_SIZE   997
+#define TOTAL_BYTES (1024 * 1024)
+
+static RING_ID rng;
+
+static void readerTask(long a0, long a1, long a2, long a3, long a4,
+		       long a5, long a6, long a7, long a8, long a9)
+{
+	unsigned char buffer[RING_SIZE * 2];
+	int n, got, total = 0, chunk = 1;
+
+	traceobj_enter(&trobj);
+
+	/*
+	 * Pull odd-sized chunks concurrently with the writer, without
+	 * any locking, and make sure the byte stream is intact.
+	 */
+	while (total < TOTAL_BYTES) {
+		got = rngBufGet(rng, (char *)buffer, chunk);
+		traceobj_assert(&trobj, got >= 0 && got <= chunk);
+		for (n = 0; n < got; n++)
+			traceobj_assert(&trobj, buffer[n] ==
+					(unsigned char)(total + n));
+		total += got;
+		if (got == 0)
+			taskDelay(0);
+		chunk = chunk * 7 % (int)sizeof(buffer) + 1;
+	}
+
+	traceobj_assert(&trobj, rngIsEmpty(rng));
+
+	traceobj_exit(&trobj);
+}
+
+static void rootTask(long a0, long a1, long a2, long a3, long a4,
+		     long a5, long a6, long a7, long a8, long a9)
+{
+	unsigned char buffer[RING_SIZE * 2];
+	int n, put, total = 0, chunk = 1;
+	TASK_ID tid;
+
+	traceobj_enter(&trobj);
+
+	rng = rngCreate(RING_SIZE);
+	traceobj_assert(&trobj, rng != 0);
+
+	traceobj_mark(&trobj, 1);
+
+	tid = taskSpawn("readerTask", 50, 0, 0, readerTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_mark(&trobj, 2);
+
+	while (total < TOTAL_BYTES) {
+		if (chunk > TOTAL_BYTES - total)
+			chunk = TOTAL_BYTES - total;
+		for (n = 0; n < chunk; n++)
+			buffer[n] = (unsigned char)(total + n);
+		put = rngBufPut(rng, (char *)buffer, chunk);
+		traceobj_assert(&trobj, put >= 0 && put <= chunk);
+		total += put;
+		if (put == 0)
+			taskDelay(0);
+		chunk = chunk * 5 % (int)sizeof(buffer) + 1;
+	}
+
+	traceobj_mark(&trobj, 3);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	TASK_ID tid;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	tid = taskSpawn("rootTask", 50, 0, 0, rootTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	rngDelete(rng);
+
+	exit(0);
+}
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <vxworks/errnoLib.h>
+#include <vxworks/taskLib.h>
+#include <vxworks/semLib.h>
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4
+};
+
+#define NR_GIVES  100000
+
+static SEM_ID csem_id, bsem_id;
+
+static int nr_takes;
+
+static void consumerTask(long a0, long a1, long a2, long a3, long a4,
+			 long a5, long a6, long a7, long a8, long a9)
+{
+	int ret;
+
+	traceobj_enter(&trobj);
+
+	/* Poll the count first, sleep on it when exhausted. */
+	while (nr_takes < NR_GIVES) {
+		ret = semTake(csem_id, NO_WAIT);
+		if (ret) {
+			traceobj_assert(&trobj,
+					errno == S_objLib_OBJ_UNAVAILABLE);
+			ret = semTake(csem_id, WAIT_FOREVER);
+			traceobj_assert(&trobj, ret == OK);
+		}
+		nr_takes++;
+	}
+
+	traceobj_mark(&trobj, 3);
+
+	ret = semGive(bsem_id);
+	traceobj_assert(&trobj, ret == OK);
+
+	traceobj_exit(&trobj);
+}
+
+static void rootTask(long a0, long a1, long a2, long a3, long a4,
+		     long a5, long a6, long a7, long a8, long a9)
+{
+	TASK_ID tid;
+	int ret, n;
+
+	traceobj_enter(&trobj);
+
+	csem_id = semCCreate(SEM_Q_FIFO, 0);
+	traceobj_assert(&trobj, csem_id != 0);
+
+	bsem_id = semBCreate(SEM_Q_FIFO, SEM_FULL);
+	traceobj_assert(&trobj, bsem_id != 0);
+
+	/* Giving a full binary semaphore is a no-op. */
+	ret = semGive(bsem_id);
+	traceobj_assert(&trobj, ret == OK);
+	ret = semTake(bsem_id, NO_WAIT);
+	traceobj_assert(&trobj, ret == OK);
+	ret = semTake(bsem_id, NO_WAIT);
+	traceobj_assert(&trobj, ret == ERROR &&
+			errno == S_objLib_OBJ_UNAVAILABLE);
+
+	traceobj_mark(&trobj, 1);
+
+	tid = taskSpawn("consumerTask", 50, 0, 0, consumerTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_mark(&trobj, 2);
+
+	for (n = 0; n < NR_GIVES; n++) {
+		ret = semGive(csem_id);
+		traceobj_assert(&trobj, ret == OK);
+		if ((n % 100) == 0)
+			taskDelay(0);
+	}
+
+	ret = semTake(bsem_id, WAIT_FOREVER);
+	traceobj_assert(&trobj, ret == OK);
+
+	traceobj_mark(&trobj, 4);
+
+	/* Every give must have been consumed exactly once. */
+	traceobj_assert(&trobj, nr_takes == NR_GIVES);
+	ret = semTake(csem_id, NO_WAIT);
+	traceobj_assert(&trobj, ret == ERROR &&
+			errno == S_objLib_OBJ_UNAVAILABLE);
+
+	ret = semDelete(csem_id);
+	traceobj_assert(&trobj, ret == OK);
+
+	ret = semDelete(bsem_id);
+	traceobj_assert(&trobj, ret == OK);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	TASK_ID tid;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	tid = taskSpawn("rootTask", 50, 0, 0, rootTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	exit(0);
+}
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <copperplate/traceobj.h>
+#include <vxworks/errnoLib.h>
+#include <vxworks/taskLib.h>
+#include <vxworks/tickLib.h>
+#include <vxworks/wdLib.h>
+
+#define NR_WDOGS  256
+
+static struct traceobj trobj;
+
+static int tseq[] = {
+	1, 2, 3, 4
+};
+
+static TASK_ID tid;
+
+static WDOG_ID wdog_ids[NR_WDOGS];
+
+static ULONG wdog_due[NR_WDOGS];
+
+static int wdog_hits[NR_WDOGS];
+
+static void watchdogHandler(long arg)
+{
+	static int fired;
+	int ret;
+
+	traceobj_assert(&trobj, arg >= 0 && arg < NR_WDOGS);
+	traceobj_assert(&trobj, tickGet() >= wdog_due[arg]);
+
+	wdog_hits[arg]++;
+
+	if (++fired == NR_WDOGS / 2) {
+		ret = taskResume(tid);
+		traceobj_assert(&trobj, ret == OK);
+	}
+}
+
+static void rootTask(long a0, long a1, long a2, long a3, long a4,
+		     long a5, long a6, long a7, long a8, long a9)
+{
+	int ret, n, delay;
+
+	traceobj_enter(&trobj);
+
+	tid = taskIdSelf();
+
+	for (n = 0; n < NR_WDOGS; n++) {
+		wdog_ids[n] = wdCreate();
+		traceobj_assert(&trobj, wdog_ids[n] != 0);
+	}
+
+	traceobj_mark(&trobj, 1);
+
+	/*
+	 * Spread the shots over several rounds of the timer wheel,
+	 * then cancel every other watchdog before it elapses.
+	 */
+	for (n = 0; n < NR_WDOGS; n++) {
+		delay = 20 + (n * 7) % 600;
+		wdog_due[n] = tickGet() + delay;
+		ret = wdStart(wdog_ids[n], delay, watchdogHandler, n);
+		traceobj_assert(&trobj, ret == OK);
+	}
+
+	for (n = 1; n < NR_WDOGS; n += 2) {
+		ret = wdCancel(wdog_ids[n]);
+		traceobj_assert(&trobj, ret == OK);
+	}
+
+	traceobj_mark(&trobj, 2);
+
+	ret = taskSuspend(tid);
+	traceobj_assert(&trobj, ret == OK);
+
+	traceobj_mark(&trobj, 3);
+
+	/* Make sure no cancelled watchdog fires late. */
+	ret = taskDelay(100);
+	traceobj_assert(&trobj, ret == OK);
+
+	for (n = 0; n < NR_WDOGS; n++) {
+		traceobj_assert(&trobj, wdog_hits[n] == ((n & 1) == 0));
+		ret = wdDelete(wdog_ids[n]);
+		traceobj_assert(&trobj, ret == OK);
+	}
+
+	traceobj_mark(&trobj, 4);
+
+	traceobj_exit(&trobj);
+}
+
+int main(int argc, char *const argv[])
+{
+	TASK_ID tid;
+
+	traceobj_init(&trobj, argv[0], sizeof(tseq) / sizeof(int));
+
+	tid = taskSpawn("rootTask", 50, 0, 0, rootTask,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	traceobj_assert(&trobj, tid != ERROR);
+
+	traceobj_join(&trobj);
+
+	traceobj_verify(&trobj, tseq, sizeof(tseq) / sizeof(int));
+
+	exit(0);
+}
@@ -59,7 +59,7 @@ static void watchdog_handler(struct timerobj *tmobj)
 	wd->handler(wd->arg);
 }
 
-WDOG_ID wdCreate(void)
+static WDOG_ID create_wd(int prio)
 {
 	struct wind_wd *wd;
 	struct service svc;
@@ -71,7 +71,7 @@ WDOG_ID wdCreate(void)
 	if (wd == NULL)
 		goto fail;
 
-	ret = timerobj_init(&wd->tmobj);
+	ret = timerobj_init_server(&wd->tmobj, TIMEROBJ_CPU_AUTO, prio);
 	if (ret) {
 		pvfree(wd);
 	fail:
@@ -87,6 +87,26 @@ out:
 	return (WDOG_ID)wd;
 }
 
+WDOG_ID wdCreate(void)
+{
+	return create_wd(TIMEROBJ_PRIO_DEFAULT);
+}
+
+/*
+ * Non-standard call: the watchdog handler runs at the given task
+ * priority level, instead of above all tasks, so that lengthy
+ * handlers may not delay the watchdogs of more urgent ones.
+ */
+WDOG_ID wdCreatePrio(int prio)
+{
+	if (prio < 0 || prio > 255) {
+		errno = S_taskLib_ILLEGAL_PRIORITY;
+		return (WDOG_ID)0;
+	}
+
+	return create_wd(wind_task_normalize_priority(prio));
+}
+
 STATUS wdDelete(WDOG_ID wdog_id)
 {
 	struct wind_wd *wd;
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the per-thread page fault counter, and that prefaulting a
+ * range spares the faults to the caller.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "check.h"
+
+#define NR_PAGES	16
+
+static long pagesz;
+
+static void check_true(int cond, const char *what)
+{
+	if (!cond) {
+		fprintf(stderr, "FAILURE: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Have the range start afresh, leaving the caller in secondary mode. */
+static void drop_pages(char *mem, size_t len)
+{
+	check_unix(munlock(mem, len));
+	check_unix(madvise(mem, len, MADV_DONTNEED));
+}
+
+/* Touch each page from primary mode, return the faults taken. */
+static unsigned long touch_pages(char *mem, size_t len)
+{
+	unsigned long faults;
+	size_t off;
+
+	check_pthread(pthread_set_mode_np(0, PTHREAD_CONFORMING, NULL));
+	faults = pthread_pagefaults_np();
+
+	for (off = 0; off < len; off += pagesz)
+		mem[off] = 1;
+
+	return pthread_pagefaults_np() - faults;
+}
+
+int main(void)
+{
+	struct sched_param param = { .sched_priority = 50 };
+	size_t len;
+	char *mem;
+
+	check_pthread(pthread_setschedparam(pthread_self(),
+					    SCHED_FIFO, &param));
+
+	pagesz = sysconf(_SC_PAGESIZE);
+	len = NR_PAGES * pagesz;
+	mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	check_true(mem != MAP_FAILED, "mmap");
+
+	drop_pages(mem, len);
+	check_true(touch_pages(mem, len) > 0,
+		   "touching fresh pages did not count any fault");
+
+	drop_pages(mem, len);
+	check_pthread(pthread_prefault_np(mem, len));
+	check_true(touch_pages(mem, len) == 0,
+		   "touching prefaulted pages counted some fault");
+
+	check_pthread(pthread_prefault_np(NULL, 0));
+	check_true(pthread_prefault_np(NULL, 1) == EINVAL,
+		   "prefaulting NULL did not fail");
+	check_pthread(pthread_prefault_stack_np());
+
+	check_unix(munmap(mem, len));
+
+	return EXIT_SUCCESS;
+}
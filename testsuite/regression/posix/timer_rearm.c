@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the lazy rearming of one-shot timers: pushing back the date
+ * of a running timer is posted to the core through the shared timer
+ * table, which picks the new date when the current one elapses.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "check.h"
+
+#define MS	1000000LL
+#define US	1000LL
+
+#define NR_RACES	200
+#define NR_TIMERS	40
+
+static sigset_t alrm_set;
+
+static long long now(void)
+{
+	struct timespec ts;
+
+	check_unix(clock_gettime(CLOCK_MONOTONIC, &ts));
+
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static long long ts2ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000LL + ts->tv_nsec;
+}
+
+static void ns2its(struct itimerspec *its, long long ns)
+{
+	its->it_value.tv_sec = ns / 1000000000LL;
+	its->it_value.tv_nsec = ns % 1000000000LL;
+	its->it_interval.tv_sec = 0;
+	its->it_interval.tv_nsec = 0;
+}
+
+static void check_true(int cond, const char *what)
+{
+	if (!cond) {
+		fprintf(stderr, "FAILURE: %s\n", what);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static timer_t create_timer(void)
+{
+	struct sigevent sev;
+	timer_t tm;
+
+	memset(&sev, 0, sizeof(sev));
+	sev.sigev_notify = SIGEV_SIGNAL;
+	sev.sigev_signo = SIGALRM;
+	check_unix(timer_create(CLOCK_MONOTONIC, &sev, &tm));
+
+	return tm;
+}
+
+static void arm_timer(timer_t tm, long long ns, struct itimerspec *ovalue)
+{
+	struct itimerspec its;
+
+	ns2its(&its, ns);
+	check_unix(timer_settime(tm, 0, &its, ovalue));
+}
+
+/* Returns the date of the next shot, or zero on timeout. */
+static long long wait_shot(long long timeout)
+{
+	struct timespec ts;
+	siginfo_t si;
+	int ret;
+
+	ts.tv_sec = timeout / 1000000000LL;
+	ts.tv_nsec = timeout % 1000000000LL;
+	ret = sigtimedwait(&alrm_set, &si, &ts);
+	if (ret < 0 && errno == EAGAIN)
+		return 0;
+
+	check_unix(ret);
+
+	return now();
+}
+
+static void check_rearm(void)
+{
+	struct itimerspec ovalue, value;
+	long long start, date;
+	timer_t tm;
+
+	fprintf(stderr, "Checking timer rearm\n");
+
+	tm = create_timer();
+
+	arm_timer(tm, 50 * MS, NULL);
+	usleep(10000);
+
+	start = now();
+	arm_timer(tm, 100 * MS, &ovalue);
+	check_true(ts2ns(&ovalue.it_value) > 0 &&
+		   ts2ns(&ovalue.it_value) <= 40 * MS,
+		   "old value of the rearmed timer");
+
+	check_unix(timer_gettime(tm, &value));
+	check_true(ts2ns(&value.it_value) > 50 * MS &&
+		   ts2ns(&value.it_value) <= 100 * MS,
+		   "value of the rearmed timer");
+
+	date = wait_shot(200 * MS);
+	check_true(date != 0, "rearmed timer did not fire");
+	check_true(date - start >= 100 * MS, "rearmed timer fired early");
+	check_true(wait_shot(50 * MS) == 0, "rearmed timer fired twice");
+
+	check_unix(timer_delete(tm));
+}
+
+static void check_rearm_race(void)
+{
+	struct itimerspec ovalue;
+	long long start, date;
+	int n, lost = 0;
+	timer_t tm;
+
+	fprintf(stderr, "Checking timer rearm racing with expiry\n");
+
+	tm = create_timer();
+
+	for (n = 0; n < NR_RACES; n++) {
+		start = now();
+		arm_timer(tm, 1 * MS, NULL);
+		/* Sweep the window right before the expiry date. */
+		while (now() < start + 1 * MS - (n % 50) * US)
+			;
+		start = now();
+		arm_timer(tm, 500 * US, &ovalue);
+		if (ts2ns(&ovalue.it_value) == 0) {
+			/* The first shot won, the timer was armed anew. */
+			check_true(wait_shot(10 * MS) != 0,
+				   "rearmed timer lost its shot");
+			while (wait_shot(2 * MS))
+				;
+			lost++;
+			continue;
+		}
+		/*
+		 * The timer was still running when we rearmed it:
+		 * exactly one shot must occur, not before the new
+		 * date.
+		 */
+		date = wait_shot(10 * MS);
+		check_true(date != 0, "rearmed timer did not fire");
+		check_true(date - start >= 500 * US,
+			   "rearmed timer fired early");
+		check_true(wait_shot(2 * MS) == 0,
+			   "rearmed timer fired twice");
+	}
+
+	fprintf(stderr, "%d/%d rearms raced with the expiry\n",
+		lost, NR_RACES);
+
+	check_unix(timer_delete(tm));
+}
+
+static void check_delete_deferred(void)
+{
+	struct itimerspec ovalue, value;
+	long long start, date;
+	timer_t tm;
+
+	fprintf(stderr, "Checking timer deletion with a deferred rearm\n");
+
+	tm = create_timer();
+
+	arm_timer(tm, 20 * MS, NULL);
+	arm_timer(tm, 100 * MS, &ovalue);
+	check_true(ts2ns(&ovalue.it_value) > 0, "timer was not running");
+	check_unix(timer_delete(tm));
+
+	check_true(wait_shot(150 * MS) == 0, "deleted timer fired");
+
+	/* The recycled slot must not carry the deferred date over. */
+	tm = create_timer();
+	check_unix(timer_gettime(tm, &value));
+	check_true(ts2ns(&value.it_value) == 0, "new timer is armed");
+
+	start = now();
+	arm_timer(tm, 10 * MS, NULL);
+	date = wait_shot(200 * MS);
+	check_true(date != 0, "new timer did not fire");
+	check_true(date - start >= 10 * MS && date - start < 50 * MS,
+		   "new timer fired at the wrong date");
+
+	check_unix(timer_delete(tm));
+}
+
+/*
+ * The timer state table grows by chunks of slots as timers are
+ * created, the rearming protocol must work past the first chunk.
+ */
+static void check_many_timers(void)
+{
+	struct itimerspec ovalue, value;
+	timer_t tms[NR_TIMERS];
+	long long start, date;
+	int n;
+
+	fprintf(stderr, "Checking lazy rearming on many timers\n");
+
+	for (n = 0; n < NR_TIMERS; n++)
+		tms[n] = create_timer();
+
+	start = now();
+	arm_timer(tms[NR_TIMERS - 1], 50 * MS, NULL);
+	arm_timer(tms[NR_TIMERS - 1], 100 * MS, &ovalue);
+	check_true(ts2ns(&ovalue.it_value) > 0, "last timer was not running");
+	check_unix(timer_gettime(tms[NR_TIMERS - 1], &value));
+	check_true(ts2ns(&value.it_value) > 50 * MS,
+		   "last timer did not report its new date");
+
+	date = wait_shot(300 * MS);
+	check_true(date - start >= 100 * MS, "last timer fired early");
+	check_true(wait_shot(100 * MS) == 0, "last timer fired twice");
+
+	for (n = 0; n < NR_TIMERS; n++)
+		check_unix(timer_delete(tms[n]));
+}
+
+int main(void)
+{
+	struct sched_param param = { .sched_priority = 50 };
+
+	sigemptyset(&alrm_set);
+	sigaddset(&alrm_set, SIGALRM);
+	check_pthread(pthread_sigmask(SIG_BLOCK, &alrm_set, NULL));
+	check_pthread(pthread_setschedparam(pthread_self(),
+					    SCHED_FIFO, &param));
+
+	check_rearm();
+	check_rearm_race();
+	check_delete_deferred();
+	check_many_timers();
+
+	fprintf(stderr, "timer rearm: success\n");
+
+	return EXIT_SUCCESS;
+}
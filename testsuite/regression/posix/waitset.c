@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks the persistent wait sets of libcobalt: members are
+ * registered once, then reported when ready, until removed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <cobalt/uapi/event.h>
+#include <cobalt/uapi/waitset.h>
+
+#include "check.h"
+
+/* libcobalt internals, see lib/cobalt/internal.h. */
+int cobalt_event_init(cobalt_event_t *event, unsigned long value,
+		      int flags);
+
+int cobalt_event_post(cobalt_event_t *event, unsigned long bits);
+
+int cobalt_event_destroy(cobalt_event_t *event);
+
+int cobalt_waitset_init(cobalt_waitset_t *ws, int nmax);
+
+int cobalt_waitset_add(cobalt_waitset_t *ws, int type,
+		       unsigned long obj, unsigned long mask);
+
+int cobalt_waitset_remove(cobalt_waitset_t *ws, int index);
+
+int cobalt_waitset_modify(cobalt_waitset_t *ws, int index,
+			  unsigned long mask);
+
+int cobalt_waitset_wait(cobalt_waitset_t *ws,
+			int *ready, int nready,
+			const struct timespec *timeout);
+
+int cobalt_waitset_destroy(cobalt_waitset_t *ws);
+
+#define NMAX		4
+#define NR_ROUNDS	1000
+
+#define check_cobalt(expr)						\
+	({								\
+		int rc = (expr);					\
+		if (rc < 0) {						\
+			fprintf(stderr, "%s:%d: "#expr ": %s\n",	\
+				__FILE__, __LINE__, strerror(-rc));	\
+			exit(EXIT_FAILURE);				\
+		}							\
+		rc;							\
+	})
+
+#define check_value(expr, expected)					\
+	({								\
+		int rc = (expr);					\
+		if (rc != (expected)) {					\
+			fprintf(stderr, "%s:%d: "#expr ": %d, expected %d\n", \
+				__FILE__, __LINE__, rc, (expected));	\
+			exit(EXIT_FAILURE);				\
+		}							\
+		rc;							\
+	})
+
+static const struct timespec nonblock = { .tv_sec = 0, .tv_nsec = 0 };
+
+static cobalt_waitset_t race_ws;
+
+static volatile int race_done;
+
+static int add_sem(cobalt_waitset_t *ws, sem_t *sem)
+{
+	return cobalt_waitset_add(ws, COBALT_WAITSET_SEM,
+				  (unsigned long)sem, 0);
+}
+
+static int add_event(cobalt_waitset_t *ws, cobalt_event_t *event,
+		     unsigned long mask)
+{
+	return cobalt_waitset_add(ws, COBALT_WAITSET_EVENT,
+				  (unsigned long)event, mask);
+}
+
+/* Expects exactly one member to be ready. */
+static void check_ready(cobalt_waitset_t *ws, int index)
+{
+	int ready[NMAX];
+
+	check_value(cobalt_waitset_wait(ws, ready, NMAX, &nonblock), 1);
+	check_value(ready[0], index);
+}
+
+static void check_idle(cobalt_waitset_t *ws)
+{
+	int ready[NMAX];
+
+	check_value(cobalt_waitset_wait(ws, ready, NMAX, &nonblock),
+		    -EWOULDBLOCK);
+}
+
+static void check_members(void)
+{
+	int i_sem0, i_sem1, i_sem2, i_ev, i;
+	sem_t sem0, sem1, sem2;
+	cobalt_waitset_t ws;
+	cobalt_event_t ev;
+
+	check_unix(sem_init(&sem0, 0, 0));
+	check_unix(sem_init(&sem1, 0, 0));
+	check_unix(sem_init(&sem2, 0, 0));
+	check_cobalt(cobalt_event_init(&ev, 0, COBALT_EVENT_PRIO));
+	check_cobalt(cobalt_waitset_init(&ws, NMAX));
+
+	i_sem0 = check_cobalt(add_sem(&ws, &sem0));
+	i_sem1 = check_cobalt(add_sem(&ws, &sem1));
+	i_ev = check_cobalt(add_event(&ws, &ev, 0x1));
+	check_idle(&ws);
+
+	/* Ready members are reported, stale indications are not. */
+	check_unix(sem_post(&sem1));
+	check_ready(&ws, i_sem1);
+	check_unix(sem_wait(&sem1));
+	check_idle(&ws);
+
+	/* A removed member is not reported anymore. */
+	check_cobalt(cobalt_waitset_remove(&ws, i_sem1));
+	check_value(cobalt_waitset_remove(&ws, i_sem1), -EINVAL);
+	check_unix(sem_post(&sem1));
+	check_idle(&ws);
+
+	/* Its slot is recycled, the set may be refilled to capacity. */
+	i = check_cobalt(add_sem(&ws, &sem1));
+	check_value(i, i_sem1);
+	check_ready(&ws, i_sem1);
+	check_unix(sem_wait(&sem1));
+	i_sem2 = check_cobalt(add_sem(&ws, &sem2));
+	check_value(add_sem(&ws, &sem2), -ENOSPC);
+	check_cobalt(cobalt_waitset_remove(&ws, i_sem2));
+	check_value(add_sem(&ws, &sem2), i_sem2);
+
+	/* Event members follow the mask of interest. */
+	check_cobalt(cobalt_event_post(&ev, 0x2));
+	check_idle(&ws);
+	check_value(cobalt_waitset_modify(&ws, i_sem0, 0x2), -EINVAL);
+	check_cobalt(cobalt_waitset_modify(&ws, i_ev, 0x2));
+	check_ready(&ws, i_ev);
+
+	/*
+	 * A deleted member is reported once, then has to be removed
+	 * before its slot may serve again. Modifying it is refused
+	 * even before any wait reported it.
+	 */
+	check_cobalt(cobalt_event_destroy(&ev));
+	check_value(cobalt_waitset_modify(&ws, i_ev, 0x1), -EIDRM);
+	check_ready(&ws, i_ev);
+	check_idle(&ws);
+	check_value(cobalt_waitset_modify(&ws, i_ev, 0x1), -EIDRM);
+	check_value(add_sem(&ws, &sem2), -ENOSPC);
+	check_cobalt(cobalt_waitset_remove(&ws, i_ev));
+	check_cobalt(cobalt_event_init(&ev, 0x1, COBALT_EVENT_PRIO));
+	check_value(add_event(&ws, &ev, 0x1), i_ev);
+	check_ready(&ws, i_ev);
+
+	check_cobalt(cobalt_waitset_destroy(&ws));
+	check_value(cobalt_waitset_destroy(&ws), -EINVAL);
+	check_cobalt(cobalt_event_destroy(&ev));
+	check_unix(sem_destroy(&sem2));
+	check_unix(sem_destroy(&sem1));
+	check_unix(sem_destroy(&sem0));
+}
+
+static void *adder(void *arg)
+{
+	sem_t *sem = arg;
+	int ret;
+
+	while (!race_done) {
+		ret = add_sem(&race_ws, sem);
+		if (ret < 0 && ret != -EIDRM &&
+		    ret != -EINVAL && ret != -ENOSPC) {
+			fprintf(stderr, "add_sem: %s\n", strerror(-ret));
+			exit(EXIT_FAILURE);
+		}
+		if (ret >= 0)
+			cobalt_waitset_remove(&race_ws, ret);
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+/*
+ * Destroying a set while members are being added to it must not
+ * pull the set from under the adders.
+ */
+static void check_add_destroy_race(void)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	pthread_t tid;
+	sem_t sem;
+	int n;
+
+	check_unix(sem_init(&sem, 0, 1));
+	check_cobalt(cobalt_waitset_init(&race_ws, NMAX));
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = 50;
+	pthread_attr_setschedparam(&attr, &param);
+	check_pthread(pthread_create(&tid, &attr, adder, &sem));
+	pthread_attr_destroy(&attr);
+
+	for (n = 0; n < NR_ROUNDS; n++) {
+		sched_yield();
+		check_cobalt(cobalt_waitset_destroy(&race_ws));
+		check_cobalt(cobalt_waitset_init(&race_ws, NMAX));
+	}
+
+	race_done = 1;
+	check_pthread(pthread_join(tid, NULL));
+	check_cobalt(cobalt_waitset_destroy(&race_ws));
+	check_unix(sem_destroy(&sem));
+}
+
+int main(void)
+{
+	struct sched_param param = { .sched_priority = 50 };
+
+	check_pthread(pthread_setschedparam(pthread_self(),
+					    SCHED_FIFO, &param));
+	check_members();
+	check_add_destroy_race();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,642 @@
+/**
+ * @file
+ * Analogy for Linux, acquisition data path benchmark
+ *
+ * This program runs asynchronous input commands (typically on the
+ * fake driver, kernel/drivers/analogy/testing/fake.c) and measures
+ * the cost of the data path through the read(), mmap and converted
+ * (read() + a4l_rawtod_scan()) interfaces.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <stdint.h>
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+#include <time.h>
+
+#include <alchemy/task.h>
+
+#include <analogy/analogy.h>
+
+/* The fake driver's first subdevice is an analog input one */
+#define ID_SUBD 0
+#define MAX_NB_CHAN 32
+/* Default scan period: 10 kHz */
+#define SCAN_PERIOD 100000
+#define NB_SCAN 100000
+/* The fake driver rejects faster scan clocks */
+#define MIN_SCAN_PERIOD 1000
+
+#define FILENAME "analogy0"
+
+#define BUF_SIZE 65536
+
+#define MODE_READ 0x1
+#define MODE_MMAP 0x2
+#define MODE_CONVERT 0x4
+
+struct bench_result {
+	unsigned long long bytes;
+	unsigned long long elapsed_ns;
+	unsigned long long cpu_ns;
+	unsigned long wakes;
+	long long lat_min;
+	long long lat_max;
+	long long lat_sum;
+	int err;
+};
+
+static unsigned char buf[BUF_SIZE];
+static double values[BUF_SIZE / sizeof(uint16_t)];
+static char *filename = FILENAME;
+static char *str_chans = "0,1,2,3";
+static unsigned int chans[MAX_NB_CHAN];
+static a4l_chinfo_t *chinfos[MAX_NB_CHAN];
+static a4l_rnginfo_t *rnginfos[MAX_NB_CHAN];
+static unsigned int scan_size;
+static int verbose = 0;
+static int real_time = 0;
+static int sweep_wake = 0;
+static int find_overrun = 0;
+static int modes = MODE_READ | MODE_MMAP | MODE_CONVERT;
+static unsigned long wake_count = 0;
+static unsigned long buf_size = 0;
+
+static RT_TASK rt_task_desc;
+
+static a4l_cmd_t cmd = {
+	.idx_subd = ID_SUBD,
+	.flags = 0,
+	.start_src = TRIG_NOW,
+	.start_arg = 0,
+	.scan_begin_src = TRIG_TIMER,
+	.scan_begin_arg = SCAN_PERIOD,	/* in ns */
+	.convert_src = TRIG_NOW,
+	.convert_arg = 0,
+	.scan_end_src = TRIG_COUNT,
+	.scan_end_arg = 0,
+	.stop_src = TRIG_COUNT,
+	.stop_arg = NB_SCAN,
+	.nb_chan = 0,
+	.chan_descs = chans,
+};
+
+struct option cmd_bench_opts[] = {
+	{"verbose", no_argument, NULL, 'v'},
+	{"real-time", no_argument, NULL, 'r'},
+	{"device", required_argument, NULL, 'd'},
+	{"subdevice", required_argument, NULL, 's'},
+	{"scan-count", required_argument, NULL, 'S'},
+	{"scan-period", required_argument, NULL, 'p'},
+	{"channels", required_argument, NULL, 'c'},
+	{"mode", required_argument, NULL, 'm'},
+	{"wake-count", required_argument, NULL, 'k'},
+	{"wake-sweep", no_argument, NULL, 'K'},
+	{"buffer-size", required_argument, NULL, 'b'},
+	{"overrun", no_argument, NULL, 'o'},
+	{"help", no_argument, NULL, 'h'},
+	{0},
+};
+
+static void do_print_usage(void)
+{
+	fprintf(stdout, "usage:\tcmd_bench [OPTS]\n");
+	fprintf(stdout, "\tOPTS:\t -v, --verbose: verbose output\n");
+	fprintf(stdout,
+		"\t\t -r, --real-time: enable real-time acquisition mode\n");
+	fprintf(stdout,
+		"\t\t -d, --device: device filename (analogy0, analogy1, ...)\n");
+	fprintf(stdout, "\t\t -s, --subdevice: subdevice index\n");
+	fprintf(stdout, "\t\t -S, --scan-count: count of scan to perform\n");
+	fprintf(stdout, "\t\t -p, --scan-period: scan period (ns)\n");
+	fprintf(stdout, "\t\t -c, --channels: channels to use (ex.: -c 0,1)\n");
+	fprintf(stdout,
+		"\t\t -m, --mode: data path(s) to measure "
+		"(read,mmap,convert)\n");
+	fprintf(stdout,
+		"\t\t -k, --wake-count: "
+		"space available before waking up the process\n");
+	fprintf(stdout,
+		"\t\t -K, --wake-sweep: "
+		"measure with increasing wake counts\n");
+	fprintf(stdout, "\t\t -b, --buffer-size: asynchronous buffer size\n");
+	fprintf(stdout,
+		"\t\t -o, --overrun: "
+		"shorten the scan period until the buffer overruns\n");
+	fprintf(stdout, "\t\t -h, --help: print this help\n");
+}
+
+static inline unsigned long long get_time_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned long long get_cpu_ns(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+		(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+/* The wake-up latency is estimated against the scan clock: the last
+   scan received at wake-up time should have been produced
+   (count / scan_size) periods after the command was started. */
+static void account_wakeup(struct bench_result *res,
+			   unsigned long long start, unsigned long long count)
+{
+	unsigned long long due, now = get_time_ns();
+	long long lat;
+
+	due = start + (count / scan_size) * cmd.scan_begin_arg;
+	lat = (long long)(now - due);
+
+	if (res->wakes == 0 || lat < res->lat_min)
+		res->lat_min = lat;
+	if (res->wakes == 0 || lat > res->lat_max)
+		res->lat_max = lat;
+	res->lat_sum += lat;
+	res->wakes++;
+}
+
+static int run_read(a4l_desc_t *dsc, struct bench_result *res,
+		    unsigned long long start, int convert)
+{
+	unsigned int pending = 0, nbytes;
+	int ret;
+
+	/* Only entire scans can be converted */
+	nbytes = (BUF_SIZE / scan_size) * scan_size;
+
+	do {
+		ret = a4l_async_read(dsc, buf + pending,
+				     nbytes - pending, A4L_INFINITE);
+		if (ret <= 0)
+			break;
+
+		res->bytes += ret;
+		account_wakeup(res, start, res->bytes);
+
+		if (convert) {
+			unsigned int nb_scan;
+
+			pending += ret;
+			nb_scan = pending / scan_size;
+			ret = a4l_rawtod_scan(chinfos, rnginfos, cmd.nb_chan,
+					      values, buf, nb_scan);
+			if (ret < 0)
+				break;
+
+			pending -= nb_scan * scan_size;
+			memmove(buf, buf + nb_scan * scan_size, pending);
+		}
+
+	} while (1);
+
+	return ret;
+}
+
+static int run_mmap(a4l_desc_t *dsc, struct bench_result *res,
+		    unsigned long long start, void *map, a4l_bufstat_t *st)
+{
+	volatile unsigned char *data = map;
+	unsigned long ofs, i;
+	unsigned char sum = 0;
+	long avail;
+
+	do {
+		avail = a4l_bufstat_wait(dsc, cmd.idx_subd, st, A4L_INFINITE);
+		if (avail < 0)
+			break;
+
+		if (avail == 0)
+			continue;
+
+		/* Touch the data in place, as a consumer would */
+		ofs = st->cns_count % st->size;
+		for (i = 0; i < avail; i += sizeof(uint16_t))
+			sum += data[(ofs + i) % st->size];
+
+		a4l_bufstat_consume(st, avail);
+		res->bytes += avail;
+		account_wakeup(res, start, res->bytes);
+
+	} while (1);
+
+	(void)sum;
+
+	return avail == -ENOENT ? 0 : (int)avail;
+}
+
+static int run_bench(a4l_desc_t *dsc, int mode,
+		     unsigned long wake, struct bench_result *res)
+{
+	unsigned long long start, cpu;
+	a4l_bufstat_t *st = NULL;
+	void *map = NULL;
+	int ret;
+
+	memset(res, 0, sizeof(*res));
+
+	/* Cancel any former command which might be in progress */
+	a4l_snd_cancel(dsc, cmd.idx_subd);
+
+	if (mode == MODE_MMAP) {
+		ret = a4l_mmap(dsc, cmd.idx_subd, buf_size, &map);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: a4l_mmap() failed (ret=%d)\n", ret);
+			return ret;
+		}
+
+		ret = a4l_mmap_status(dsc, cmd.idx_subd, &st);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: a4l_mmap_status() failed (ret=%d)\n",
+				ret);
+			goto out;
+		}
+	}
+
+	ret = a4l_set_wakesize(dsc, wake);
+	if (ret < 0) {
+		fprintf(stderr,
+			"cmd_bench: a4l_set_wakesize failed (ret=%d)\n", ret);
+		goto out;
+	}
+
+	cpu = get_cpu_ns();
+	start = get_time_ns();
+
+	ret = a4l_snd_command(dsc, &cmd);
+	if (ret < 0) {
+		fprintf(stderr,
+			"cmd_bench: a4l_snd_command failed (ret=%d)\n", ret);
+		goto out;
+	}
+
+	if (mode == MODE_MMAP)
+		ret = run_mmap(dsc, res, start, map, st);
+	else
+		ret = run_read(dsc, res, start, mode == MODE_CONVERT);
+
+	res->elapsed_ns = get_time_ns() - start;
+	res->cpu_ns = get_cpu_ns() - cpu;
+	res->err = ret;
+
+	if (ret == -EPIPE)
+		/* An overrun is a result, not a failure */
+		ret = 0;
+	else if (ret < 0)
+		fprintf(stderr,
+			"cmd_bench: acquisition failed (ret=%d)\n", ret);
+out:
+	a4l_snd_cancel(dsc, cmd.idx_subd);
+
+	if (st != NULL)
+		munmap(st, getpagesize());
+
+	if (map != NULL)
+		munmap(map, buf_size);
+
+	return ret;
+}
+
+static const char *mode_name(int mode)
+{
+	switch (mode) {
+	case MODE_READ:
+		return "read";
+	case MODE_MMAP:
+		return "mmap";
+	default:
+		return "convert";
+	}
+}
+
+static void print_header(void)
+{
+	printf("%-8s %10s %10s %12s %8s %10s %10s %10s %10s\n",
+	       "mode", "period", "wake", "MB/s", "wakes",
+	       "lat_min", "lat_avg", "lat_max", "ns/sample");
+}
+
+static void print_result(int mode, unsigned long wake,
+			 struct bench_result *res)
+{
+	unsigned long long samples;
+	double mbps;
+
+	samples = res->bytes / scan_size * cmd.nb_chan;
+	mbps = res->elapsed_ns ?
+		(double)res->bytes * 1000.0 / res->elapsed_ns : 0.0;
+
+	printf("%-8s %10u %10lu %12.3f %8lu %10.1f %10.1f %10.1f %10.1f%s\n",
+	       mode_name(mode), cmd.scan_begin_arg, wake, mbps, res->wakes,
+	       res->lat_min / 1000.0,
+	       res->wakes ? res->lat_sum / 1000.0 / res->wakes : 0.0,
+	       res->lat_max / 1000.0,
+	       samples ? (double)res->cpu_ns / samples : 0.0,
+	       res->err == -EPIPE ? " (overrun)" : "");
+}
+
+/* Shorten the scan period until the acquisition overruns; the
+   shortest period sustained is the overrun threshold of the data
+   path with the current buffer and wake sizes. */
+static int search_overrun(a4l_desc_t *dsc, int mode)
+{
+	unsigned int period = cmd.scan_begin_arg, best = 0;
+	struct bench_result res;
+	int ret = 0;
+
+	while (period >= MIN_SCAN_PERIOD) {
+		cmd.scan_begin_arg = period;
+		ret = run_bench(dsc, mode, wake_count, &res);
+		if (ret < 0)
+			break;
+
+		if (verbose != 0)
+			print_result(mode, wake_count, &res);
+
+		if (res.err == -EPIPE)
+			break;
+
+		best = period;
+		period = period * 3 / 4;
+	}
+
+	if (best == 0)
+		printf("%-8s overruns at the initial scan period\n",
+		       mode_name(mode));
+	else
+		printf("%-8s shortest scan period sustained: %u ns "
+		       "(%.3f MB/s)\n", mode_name(mode), best,
+		       (double)scan_size * 1000.0 / best);
+
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long wake, wake_max;
+	unsigned int i, period;
+	int ret = 0, len, ofs, mode;
+	a4l_desc_t dsc = { .sbdata = NULL };
+	struct bench_result res;
+	char *str_modes;
+
+	/* Compute arguments */
+	while ((ret = getopt_long(argc,
+				  argv,
+				  "vrd:s:S:p:c:m:k:Kb:oh",
+				  cmd_bench_opts, NULL)) >= 0) {
+		switch (ret) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 'r':
+			real_time = 1;
+			break;
+		case 'd':
+			filename = optarg;
+			break;
+		case 's':
+			cmd.idx_subd = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			cmd.stop_arg = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			cmd.scan_begin_arg = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			str_chans = optarg;
+			break;
+		case 'm':
+			str_modes = optarg;
+			modes = 0;
+			if (strstr(str_modes, "read"))
+				modes |= MODE_READ;
+			if (strstr(str_modes, "mmap"))
+				modes |= MODE_MMAP;
+			if (strstr(str_modes, "convert"))
+				modes |= MODE_CONVERT;
+			if (modes == 0) {
+				fprintf(stderr, "cmd_bench: bad mode argument\n");
+				return -EINVAL;
+			}
+			break;
+		case 'k':
+			wake_count = strtoul(optarg, NULL, 0);
+			break;
+		case 'K':
+			sweep_wake = 1;
+			break;
+		case 'b':
+			buf_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			find_overrun = 1;
+			break;
+		case 'h':
+		default:
+			do_print_usage();
+			return 0;
+		}
+	}
+
+	if (cmd.stop_arg == 0) {
+		fprintf(stderr, "cmd_bench: a finite scan count is required\n");
+		return -EINVAL;
+	}
+
+	/* Recover the channels to compute */
+	do {
+		cmd.nb_chan++;
+		len = strlen(str_chans);
+		ofs = strcspn(str_chans, ",");
+		if (cmd.nb_chan > MAX_NB_CHAN ||
+		    sscanf(str_chans, "%u", &chans[cmd.nb_chan - 1]) == 0) {
+			fprintf(stderr, "cmd_bench: bad channel argument\n");
+			return -EINVAL;
+		}
+		str_chans += ofs + 1;
+	} while (len != ofs);
+
+	cmd.scan_end_arg = cmd.nb_chan;
+
+	if (real_time != 0) {
+
+		if (verbose != 0)
+			printf("cmd_bench: switching to real-time mode\n");
+
+		/* Prevent any memory-swapping for this program */
+		ret = mlockall(MCL_CURRENT | MCL_FUTURE);
+		if (ret < 0) {
+			ret = errno;
+			fprintf(stderr, "cmd_bench: mlockall failed (ret=%d)\n",
+				ret);
+			return ret;
+		}
+
+		/* Turn the current process into an RT task */
+		ret = rt_task_shadow(&rt_task_desc, NULL, 1, 0);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: rt_task_shadow failed (ret=%d)\n",
+				ret);
+			return ret;
+		}
+	}
+
+	/* Open the device */
+	ret = a4l_open(&dsc, filename);
+	if (ret < 0) {
+		fprintf(stderr, "cmd_bench: a4l_open %s failed (ret=%d)\n",
+			filename, ret);
+		return ret;
+	}
+
+	dsc.sbdata = malloc(dsc.sbsize);
+	if (dsc.sbdata == NULL) {
+		fprintf(stderr, "cmd_bench: malloc failed \n");
+		ret = -ENOMEM;
+		goto out_main;
+	}
+
+	ret = a4l_fill_desc(&dsc);
+	if (ret < 0) {
+		fprintf(stderr,
+			"cmd_bench: a4l_fill_desc failed (ret=%d)\n", ret);
+		goto out_main;
+	}
+
+	/* Get the size of a scan and the conversion descriptors */
+	for (i = 0; i < cmd.nb_chan; i++) {
+		ret = a4l_get_chinfo(&dsc,
+				     cmd.idx_subd, chans[i], &chinfos[i]);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: a4l_get_chinfo failed (ret=%d)\n",
+				ret);
+			goto out_main;
+		}
+
+		ret = a4l_get_rnginfo(&dsc,
+				      cmd.idx_subd, chans[i], 0, &rnginfos[i]);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: a4l_get_rnginfo failed (ret=%d)\n",
+				ret);
+			goto out_main;
+		}
+
+		scan_size += a4l_sizeof_chan(chinfos[i]);
+	}
+
+	/* The conversion output buffer holds two-byte samples at most */
+	if (scan_size < cmd.nb_chan * sizeof(uint16_t)) {
+		fprintf(stderr, "cmd_bench: samples too narrow to convert\n");
+		modes &= ~MODE_CONVERT;
+	}
+
+	a4l_snd_cancel(&dsc, cmd.idx_subd);
+
+	if (buf_size != 0) {
+		ret = a4l_set_bufsize(&dsc, cmd.idx_subd, buf_size);
+		if (ret < 0) {
+			fprintf(stderr,
+				"cmd_bench: a4l_set_bufsize failed (ret=%d)\n",
+				ret);
+			goto out_main;
+		}
+	}
+
+	ret = a4l_get_bufsize(&dsc, cmd.idx_subd, &buf_size);
+	if (ret < 0) {
+		fprintf(stderr,
+			"cmd_bench: a4l_get_bufsize failed (ret=%d)\n", ret);
+		goto out_main;
+	}
+
+	if (verbose != 0) {
+		printf("cmd_bench: device %s, subdevice %u, %u channels\n",
+		       filename, cmd.idx_subd, cmd.nb_chan);
+		printf("cmd_bench: scan size = %u bytes, "
+		       "buffer size = %lu bytes\n", scan_size, buf_size);
+	}
+
+	period = cmd.scan_begin_arg;
+
+	if (find_overrun == 0)
+		print_header();
+
+	for (mode = MODE_READ; mode <= MODE_CONVERT; mode <<= 1) {
+
+		if ((modes & mode) == 0)
+			continue;
+
+		cmd.scan_begin_arg = period;
+
+		if (find_overrun != 0) {
+			ret = search_overrun(&dsc, mode);
+			if (ret < 0)
+				goto out_main;
+			continue;
+		}
+
+		if (sweep_wake == 0) {
+			ret = run_bench(&dsc, mode, wake_count, &res);
+			if (ret < 0)
+				goto out_main;
+			print_result(mode, wake_count, &res);
+			continue;
+		}
+
+		/* From one scan up to half the buffer */
+		wake_max = buf_size / 2;
+		for (wake = scan_size; wake <= wake_max; wake <<= 2) {
+			ret = run_bench(&dsc, mode, wake, &res);
+			if (ret < 0)
+				goto out_main;
+			print_result(mode, wake, &res);
+		}
+	}
+
+	ret = 0;
+
+out_main:
+
+	if (dsc.sbdata != NULL)
+		free(dsc.sbdata);
+
+	a4l_close(&dsc);
+
+	return ret;
+}
@@ -0,0 +1,243 @@
+/**
+ * @note Copyright (C) 2013 The Xenomai project <http://www.xenomai.org>.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <error.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#define PROC_SYSCALLS  "/proc/xenomai/syscalls"
+#define PROC_PID  "/proc/%d/comm"
+
+#define SC_FMT   "%d %31s %d %63s %lu %Lu %lu %Lu"
+#define SC_NFMT  8
+
+struct sc_record {
+	int pid;
+	char personality[32];
+	int muxop;
+	char name[64];
+	unsigned long calls[2];
+	unsigned long long exectime[2];
+};
+
+struct sc_sample {
+	struct sc_record *records;
+	int nr, max;
+};
+
+static int sc_compare_key(const void *lhs, const void *rhs)
+{
+	const struct sc_record *l = lhs, *r = rhs;
+	int ret;
+
+	if (l->pid != r->pid)
+		return l->pid < r->pid ? -1 : 1;
+
+	ret = strcmp(l->personality, r->personality);
+	if (ret)
+		return ret;
+
+	return l->muxop - r->muxop;
+}
+
+static int sc_compare_time(const void *lhs, const void *rhs)
+{
+	const struct sc_record *l = lhs, *r = rhs;
+	unsigned long long tl, tr;
+
+	tl = l->exectime[0] + l->exectime[1];
+	tr = r->exectime[0] + r->exectime[1];
+	if (tl != tr)
+		return tl > tr ? -1 : 1;
+
+	return sc_compare_key(lhs, rhs);
+}
+
+static void read_sample(struct sc_sample *s)
+{
+	char buf[BUFSIZ];
+	struct sc_record *r;
+	FILE *fp;
+
+	fp = fopen(PROC_SYSCALLS, "r");
+	if (fp == NULL)
+		error(1, errno, "cannot open %s", PROC_SYSCALLS);
+
+	s->nr = 0;
+
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (s->nr >= s->max) {
+			s->max = s->max ? s->max * 2 : 64;
+			s->records = realloc(s->records,
+					     s->max * sizeof(*r));
+			if (s->records == NULL)
+				error(1, ENOMEM, "cannot sample syscalls");
+		}
+		r = s->records + s->nr;
+		if (sscanf(buf, SC_FMT, &r->pid, r->personality,
+			   &r->muxop, r->name,
+			   &r->calls[0], &r->exectime[0],
+			   &r->calls[1], &r->exectime[1]) != SC_NFMT)
+			break;
+		s->nr++;
+	}
+
+	fclose(fp);
+
+	qsort(s->records, s->nr, sizeof(*r), sc_compare_key);
+}
+
+/*
+ * Turn the current sample into per-interval deltas, using the
+ * previous one as the reference. Services which were not called
+ * during the interval are dropped.
+ */
+static int diff_sample(struct sc_sample *curr, const struct sc_sample *prev,
+		       struct sc_record *out)
+{
+	const struct sc_record *old;
+	struct sc_record *r, *d;
+	int n, nr = 0;
+
+	for (n = 0; n < curr->nr; n++) {
+		r = curr->records + n;
+		d = out + nr;
+		*d = *r;
+		old = bsearch(r, prev->records, prev->nr, sizeof(*r),
+			      sc_compare_key);
+		if (old) {
+			d->calls[0] -= old->calls[0];
+			d->calls[1] -= old->calls[1];
+			d->exectime[0] -= old->exectime[0];
+			d->exectime[1] -= old->exectime[1];
+		}
+		if (d->calls[0] + d->calls[1] > 0)
+			nr++;
+	}
+
+	return nr;
+}
+
+static const char *get_comm(int pid, char *buf, size_t len)
+{
+	char path[sizeof(PROC_PID) + 32];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), PROC_PID, pid);
+	fp = fopen(path, "r");
+	if (fp == NULL || fgets(buf, len, fp) == NULL)
+		strcpy(buf, "-");
+	else
+		buf[strcspn(buf, "\n")] = '\0';
+
+	if (fp)
+		fclose(fp);
+
+	return buf;
+}
+
+static void display(const struct sc_record *records, int nr,
+		    int lines, int delay)
+{
+	unsigned long long total = 0;
+	char comm[64];
+	int n;
+
+	for (n = 0; n < nr; n++)
+		total += records[n].exectime[0] + records[n].exectime[1];
+
+	printf("\033[H\033[2J");
+	printf("Cobalt syscalls - %d services active, %Lu.%.3Lu ms "
+	       "spent over %d s\n\n",
+	       nr, total / 1000000, (total / 1000) % 1000, delay);
+	printf("%-6s %-16s %-10s %-32s %10s %12s %10s %12s\n",
+	       "PID", "CMD", "PERS", "SYSCALL",
+	       "PRI-CALLS", "PRI-TIME(us)", "SEC-CALLS", "SEC-TIME(us)");
+
+	for (n = 0; n < nr && n < lines; n++)
+		printf("%-6d %-16.16s %-10.10s %-32.32s "
+		       "%10lu %12Lu %10lu %12Lu\n",
+		       records[n].pid,
+		       get_comm(records[n].pid, comm, sizeof(comm)),
+		       records[n].personality, records[n].name,
+		       records[n].calls[0], records[n].exectime[0] / 1000,
+		       records[n].calls[1], records[n].exectime[1] / 1000);
+
+	fflush(stdout);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: rtsctop [options]:\n");
+	fprintf(stderr, "-d <secs>   refresh delay (default: 1)\n");
+	fprintf(stderr, "-n <count>  number of refreshes before exiting\n");
+	fprintf(stderr, "-l <lines>  number of services to display (default: 20)\n");
+}
+
+int main(int argc, char *argv[])
+{
+	struct sc_sample samples[2] = { { NULL, 0, 0 }, { NULL, 0, 0 } };
+	int c, delay = 1, count = -1, lines = 20, nr, cur = 0;
+	struct sc_record *delta = NULL;
+	int maxdelta = 0;
+
+	while ((c = getopt(argc, argv, "d:n:l:h")) != EOF) {
+		switch (c) {
+		case 'd':
+			delay = atoi(optarg);
+			if (delay <= 0)
+				delay = 1;
+			break;
+		case 'n':
+			count = atoi(optarg);
+			break;
+		case 'l':
+			lines = atoi(optarg);
+			break;
+		case 'h':
+			usage();
+			exit(0);
+		default:
+			usage();
+			exit(1);
+		}
+	}
+
+	read_sample(&samples[cur]);
+
+	while (count < 0 || count-- > 0) {
+		sleep(delay);
+		cur ^= 1;
+		read_sample(&samples[cur]);
+		if (samples[cur].nr > maxdelta) {
+			maxdelta = samples[cur].max;
+			delta = realloc(delta, maxdelta * sizeof(*delta));
+			if (delta == NULL)
+				error(1, ENOMEM, "cannot sample syscalls");
+		}
+		nr = diff_sample(&samples[cur], &samples[cur ^ 1], delta);
+		qsort(delta, nr, sizeof(*delta), sc_compare_time);
+		display(delta, nr, lines, delay);
+	}
+
+	exit(0);
+}